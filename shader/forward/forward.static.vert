@@ -7,6 +7,13 @@ layout(location = 3) in vec2 attribute_texcoord;
 layout(location = 4) in uvec4 attribute_joints;
 layout(location = 5) in vec4 attribute_weights;
 
+// Positions and texture coordinates arrive as unsigned normalized shorts
+// spread over the range of their primitive
+uniform vec3 u_position_offset;
+uniform vec3 u_position_scale;
+uniform vec2 u_texcoord_offset;
+uniform vec2 u_texcoord_scale;
+
 uniform mat4 u_mvp;
 uniform mat3 u_normal;
 
@@ -27,6 +34,11 @@ out vs_out
     vec3 tangent_normal;
 };
 
+vec3 get_position()
+{
+    return u_position_offset + u_position_scale * attribute_position;
+}
+
 mat3 get_tbn_matrix(mat3 normal_matrix)
 {
     vec3 tbn_t = normalize(normal_matrix * attribute_tangent.xyz);
@@ -42,7 +54,7 @@ void vs_finish(vec3 position, mat3 normal_matrix)
     mat3 tbn = get_tbn_matrix(normal_matrix);
 
     model_fragpos = (u_model * vec4(position, 1.0)).xyz;
-    texcoord = attribute_texcoord;
+    texcoord = u_texcoord_offset + u_texcoord_scale * attribute_texcoord;
     tangent_lightpos = tbn * u_world_lightpos;
     tangent_viewpos = tbn * u_world_viewpos;
     tangent_fragpos = tbn * model_fragpos;
@@ -53,5 +65,5 @@ void vs_finish(vec3 position, mat3 normal_matrix)
 
 void main()
 {
-    vs_finish(attribute_position, u_normal);
+    vs_finish(get_position(), u_normal);
 }
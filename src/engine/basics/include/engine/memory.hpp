@@ -1,3 +1,6 @@
+#include <memory_resource>
+#include <new>
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 #pragma once
@@ -35,7 +38,163 @@ class const_view
     {
         return end - begin;
     }
+    const uint8_t *data() const
+    {
+        return &begin[0];
+    }
     bool contains(const const_view &other) const;
 };
+
+// Bump allocator for objects that are all freed together, such as the
+// document tree of a file being loaded. Deallocating is a no-op and memory
+// goes back to upstream in one go through release() or the destructor.
+class arena : public std::pmr::memory_resource
+{
+    struct chunk
+    {
+        chunk *next;
+        size_t size;
+    };
+
+    std::pmr::memory_resource *upstream;
+    chunk *chunks = nullptr;
+    uint8_t *point = nullptr;
+    uint8_t *limit = nullptr;
+    size_t chunk_size;
+    size_t allocation_count = 0;
+    size_t allocated_bytes = 0;
+
+  protected:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+  public:
+    static constexpr size_t default_chunk_size = 64 * 1024;
+
+    arena(size_t first_chunk_size = default_chunk_size,
+          std::pmr::memory_resource *upstream =
+              std::pmr::new_delete_resource());
+    ~arena();
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+
+    // Frees every chunk
+    void release();
+    // Frees every chunk but the largest, which is reused from the start
+    void reset();
+
+    // Allocations and bytes handed out since the last release() or reset()
+    size_t allocations() const
+    {
+        return allocation_count;
+    }
+    size_t bytes() const
+    {
+        return allocated_bytes;
+    }
+    // Bytes currently held from upstream
+    size_t capacity() const;
+};
+
+// Passes allocations through to upstream and counts them, so code that is
+// meant not to allocate in steady state can check that it doesn't
+class counter : public std::pmr::memory_resource
+{
+    std::pmr::memory_resource *upstream;
+    size_t allocation_count = 0;
+    size_t live_bytes = 0;
+
+  protected:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+  public:
+    counter(std::pmr::memory_resource *upstream =
+                std::pmr::new_delete_resource())
+        : upstream(upstream)
+    {
+    }
+
+    // Allocations made since construction
+    size_t allocations() const
+    {
+        return allocation_count;
+    }
+    // Bytes allocated and not yet deallocated
+    size_t bytes() const
+    {
+        return live_bytes;
+    }
+};
+
+// Fixed-size blocks of objects that are handed out in order and recycled
+// wholesale by reset(). Objects are constructed once and never moved, so
+// they keep whatever they allocated internally from one use to the next.
+template <typename T, size_t block_size = 32> class pool
+{
+    struct block
+    {
+        T objects[block_size];
+    };
+
+    std::pmr::memory_resource *upstream;
+    std::pmr::vector<block *> blocks;
+    size_t used = 0;
+
+  public:
+    pool(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+        : upstream(upstream), blocks(upstream)
+    {
+    }
+    ~pool()
+    {
+        for (block *it : blocks)
+        {
+            it->~block();
+            upstream->deallocate(it, sizeof(block), alignof(block));
+        }
+    }
+    pool(const pool &) = delete;
+    pool &operator=(const pool &) = delete;
+
+    T &next()
+    {
+        if (used == blocks.size() * block_size)
+        {
+            blocks.reserve(blocks.size() + 1);
+            void *memory = upstream->allocate(sizeof(block), alignof(block));
+            blocks.push_back(new (memory) block());
+        }
+
+        T &result = blocks[used / block_size]->objects[used % block_size];
+        used++;
+        return result;
+    }
+
+    // Objects handed out since the last reset()
+    size_t size() const
+    {
+        return used;
+    }
+    T &operator[](size_t index)
+    {
+        return blocks[index / block_size]->objects[index % block_size];
+    }
+
+    void reset()
+    {
+        used = 0;
+    }
+};
 }; // namespace memory
 }; // namespace engine
\ No newline at end of file
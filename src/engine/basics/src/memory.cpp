@@ -9,4 +9,114 @@ bool engine::memory::const_view::contains(const const_view &other) const
     if (other.end < other.begin)
         return false;
     return (other.begin >= begin) && (other.end <= end);
-}
\ No newline at end of file
+}
+
+engine::memory::arena::arena(size_t first_chunk_size,
+                             std::pmr::memory_resource *_upstream)
+    : upstream(_upstream), chunk_size(first_chunk_size)
+{
+}
+
+engine::memory::arena::~arena()
+{
+    release();
+}
+
+void *engine::memory::arena::do_allocate(size_t bytes, size_t alignment)
+{
+    uintptr_t aligned = ((uintptr_t)point + alignment - 1) & ~(alignment - 1);
+
+    if (!point || aligned + bytes > (uintptr_t)limit)
+    {
+        // Chunks double in size so large documents need few of them
+        size_t size = sizeof(chunk) + bytes + alignment;
+        if (size < chunk_size)
+            size = chunk_size;
+        chunk_size = size * 2;
+
+        chunk *added = (chunk *)upstream->allocate(size, alignof(chunk));
+        added->next = chunks;
+        added->size = size;
+        chunks = added;
+
+        point = (uint8_t *)(added + 1);
+        limit = (uint8_t *)added + size;
+        aligned = ((uintptr_t)point + alignment - 1) & ~(alignment - 1);
+    }
+
+    point = (uint8_t *)aligned + bytes;
+    allocation_count++;
+    allocated_bytes += bytes;
+
+    return (void *)aligned;
+}
+
+void engine::memory::arena::release()
+{
+    while (chunks)
+    {
+        chunk *next = chunks->next;
+        upstream->deallocate(chunks, chunks->size, alignof(chunk));
+        chunks = next;
+    }
+
+    point = nullptr;
+    limit = nullptr;
+    allocation_count = 0;
+    allocated_bytes = 0;
+}
+
+void engine::memory::arena::reset()
+{
+    chunk *largest = chunks;
+
+    for (chunk *it = chunks; it; it = it->next)
+        if (it->size > largest->size)
+            largest = it;
+
+    while (chunks)
+    {
+        chunk *next = chunks->next;
+        if (chunks != largest)
+            upstream->deallocate(chunks, chunks->size, alignof(chunk));
+        chunks = next;
+    }
+
+    chunks = largest;
+    point = nullptr;
+    limit = nullptr;
+
+    if (largest)
+    {
+        largest->next = nullptr;
+        point = (uint8_t *)(largest + 1);
+        limit = (uint8_t *)largest + largest->size;
+    }
+
+    allocation_count = 0;
+    allocated_bytes = 0;
+}
+
+size_t engine::memory::arena::capacity() const
+{
+    size_t result = 0;
+    for (chunk *it = chunks; it; it = it->next)
+        result += it->size;
+    return result;
+}
+
+void *engine::memory::counter::do_allocate(size_t bytes, size_t alignment)
+{
+    void *result = upstream->allocate(bytes, alignment);
+    allocation_count++;
+    live_bytes += bytes;
+    return result;
+}
+
+void engine::memory::counter::do_deallocate(void *pointer,
+                                            size_t bytes,
+                                            size_t alignment)
+{
+    upstream->deallocate(pointer, bytes, alignment);
+    live_bytes -= bytes;
+}
@@ -0,0 +1,90 @@
+#include <assert.h>
+#include <engine/memory.hpp>
+#include <iostream>
+#include <memory_resource>
+#include <vector>
+
+// Checks that counter counts what passes through it and that pool reuses
+// its objects, and what they allocated, after reset() without going back
+// to upstream.
+
+static void test_counter()
+{
+    engine::memory::counter counter;
+    assert(counter.allocations() == 0);
+    assert(counter.bytes() == 0);
+
+    void *first = counter.allocate(24, 8);
+    void *second = counter.allocate(100, 16);
+    assert(counter.allocations() == 2);
+    assert(counter.bytes() == 124);
+
+    counter.deallocate(first, 24, 8);
+    assert(counter.allocations() == 2);
+    assert(counter.bytes() == 100);
+    counter.deallocate(second, 100, 16);
+    assert(counter.bytes() == 0);
+
+    // Containers count through it like any other resource
+    {
+        std::pmr::vector<int> values(&counter);
+        values.reserve(16);
+        assert(counter.allocations() == 3);
+        assert(counter.bytes() == 16 * sizeof(int));
+    }
+    assert(counter.bytes() == 0);
+}
+
+static void test_pool()
+{
+    engine::memory::counter counter;
+    std::vector<std::vector<int> *> objects;
+
+    {
+        engine::memory::pool<std::vector<int>, 4> pool(&counter);
+        assert(pool.size() == 0);
+
+        for (int i = 0; i < 6; i++)
+        {
+            std::vector<int> &object = pool.next();
+            assert(object.empty());
+            object.assign(8, i);
+            objects.push_back(&object);
+        }
+        assert(pool.size() == 6);
+        for (int i = 0; i < 6; i++)
+            assert(&pool[i] == objects[i] && pool[i][0] == i);
+
+        // Two blocks and the list of them
+        const size_t allocations = counter.allocations();
+        assert(allocations >= 3);
+
+        pool.reset();
+        assert(pool.size() == 0);
+
+        for (int i = 0; i < 6; i++)
+        {
+            std::vector<int> &object = pool.next();
+            assert(&object == objects[i]);
+            assert(object.size() == 8 && object[0] == i);
+            object.clear();
+        }
+        assert(counter.allocations() == allocations);
+
+        // Past the blocks there are, a new one is allocated
+        for (int i = 6; i < 9; i++)
+            pool.next();
+        assert(pool.size() == 9);
+        assert(counter.allocations() > allocations);
+    }
+    assert(counter.bytes() == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    test_counter();
+    test_pool();
+
+    std::cout << "Success for " << argv[0] << "\n";
+    return 0;
+}
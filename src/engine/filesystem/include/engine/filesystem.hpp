@@ -1,13 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <engine/exception.hpp>
 #include <engine/filesystem.hpp>
 #include <engine/memory.hpp>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <stdint.h>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace engine::filesystem::exception
 {
@@ -40,20 +52,275 @@ class allocation : public engine::memory::allocation
     allocation(const std::string &path);
 };
 
+class whitelist;
+
+// Read-only view of a whole file backed by mmap. Pages are only read from
+// disk when touched, so opening a large asset costs roughly the same as
+// opening a small one. Files that cannot be mapped (pipes, character devices)
+// are read into memory instead.
+//
+// A mapped file shares its pages with the file on disk. Writing the file in
+// place changes bytes a mapping still refers to, and truncating it makes
+// reading them raise SIGBUS. Files that may change while they are mapped
+// must be replaced by renaming a new file over them, or opened as copied.
+class mapping
+{
+    std::shared_ptr<const uint8_t> region;
+    size_t length = 0;
+
+  public:
+    enum class source
+    {
+        mapped,
+        // Read into memory of its own, so later writes to the file do not
+        // reach it
+        copied,
+    };
+
+    mapping(const std::string &path, enum source source = source::mapped);
+    // Opens a whitelisted file, which may be stored in a mounted pack. Packs
+    // are only ever replaced by rename, so their entries are always mapped.
+    mapping(const std::string &path_rel,
+            const class whitelist &wl,
+            enum source source = source::mapped);
+    // View of part of source that keeps all of source alive
+    mapping(const mapping &source, size_t offset, size_t length);
+    // Memory owned elsewhere, such as a decompressed pack entry
+    mapping(std::shared_ptr<const uint8_t> region, size_t length);
+
+    const uint8_t *data() const
+    {
+        return region.get();
+    }
+    size_t size() const
+    {
+        return length;
+    }
+    const uint8_t *begin() const
+    {
+        return data();
+    }
+    const uint8_t *end() const
+    {
+        return data() + length;
+    }
+    operator engine::memory::const_view() const
+    {
+        return engine::memory::const_view(data(), length);
+    }
+};
+
+// Single-file archive of a content tree: a header, the contents of every
+// file aligned to pack::alignment, then an index of entries and their names.
+// The pack is mapped once. Stored entries are views into that mapping and
+// compressed entries are inflated into memory of their own when opened.
+// Packs are little-endian and written to a temporary file that is renamed
+// into place, so a pack that is being rebuilt never changes under a running
+// process.
+class pack
+{
+  public:
+    static constexpr char magic[8] = {'M', 'B', 'P', 'A', 'C', 'K', 0, 0};
+    static constexpr uint32_t version = 1;
+    static constexpr size_t alignment = 64;
+
+    enum class codec : uint32_t
+    {
+        stored = 0,
+        // zlib stream, only available when built with zlib
+        deflate = 1,
+    };
+    static constexpr size_t codec_count = 2;
+
+    // Totals of every entry opened with a codec, across all packs
+    struct statistics
+    {
+        uint64_t entries = 0;
+        uint64_t stored_bytes = 0;
+        uint64_t bytes = 0;
+        uint64_t nanoseconds = 0;
+    };
+
+    struct header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint64_t index_offset;
+        uint64_t names_offset;
+    };
+
+    struct entry
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t stored_size;
+        uint32_t name_offset;
+        uint32_t name_length;
+        enum codec codec;
+        uint32_t reserved;
+    };
+
+    using index = std::unordered_map<std::string_view, const entry *>;
+
+  private:
+    mapping contents;
+    index entries;
+
+  public:
+    const std::string path;
+    const std::filesystem::file_time_type last_modified;
+
+    pack(const std::string &path);
+
+    const entry *find(const std::string &name) const;
+    mapping open(const std::string &name) const;
+
+    index::const_iterator begin() const
+    {
+        return entries.begin();
+    }
+    index::const_iterator end() const
+    {
+        return entries.end();
+    }
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    // Packs every regular file in wl into a new pack at output. Entries are
+    // compressed with codec unless that saves less than 1/16 of their size.
+    static void write(const std::string &output,
+                      const class whitelist &wl,
+                      enum codec codec = codec::stored);
+
+    static statistics stats(enum codec codec);
+};
+
 class whitelist : std::unordered_map<std::string, std::string>
 {
     using base = std::unordered_map<std::string, std::string>;
 
+    // A mounted pack, reopened when the file is replaced
+    struct mount
+    {
+        std::string path;
+        std::mutex mutex;
+        std::shared_ptr<const pack> current;
+    };
+    std::unordered_map<std::string, std::shared_ptr<mount>> packed;
+
   public:
     whitelist() {}
+    // root is either a directory to add recursively or a pack to mount
     whitelist(const std::string &root);
     void add(const std::string &name, const std::string &absolute);
     void add_recursive(const std::string &root);
+    // Whitelists every file in a pack. The absolute path of each is the pack.
+    void mount(const std::string &pack_path);
+    mapping open(const std::string &name,
+                 enum mapping::source source = mapping::source::mapped) const;
     using base::begin;
     using base::end;
     using base::find;
 };
 
+// Fixed set of worker threads that run queued tasks in order. Tasks still
+// queued when the pool is destroyed are run before the workers exit.
+class pool
+{
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+
+    void work();
+
+  public:
+    pool(size_t threads = std::thread::hardware_concurrency());
+    ~pool();
+    pool(const pool &) = delete;
+    pool &operator=(const pool &) = delete;
+
+    void push(std::function<void()> task);
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    static pool &shared();
+
+    // Runs a task for each index in [0, count) on the workers. Indices are
+    // handed to whichever thread asks first, and wait() runs what is left
+    // on the calling thread, so a worker can wait on a batch of its own
+    // without tying up the pool.
+    class batch
+    {
+        struct state
+        {
+            std::function<void(size_t)> task;
+            size_t count;
+            std::atomic<size_t> next = 0;
+            size_t finished = 0;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable done;
+
+            void run();
+        };
+
+        std::shared_ptr<state> shared;
+        bool waited = false;
+
+      public:
+        batch(class pool &pool,
+              size_t count,
+              std::function<void(size_t)> task);
+        // Waits for the tasks, but drops their exceptions
+        ~batch();
+        batch(const batch &) = delete;
+        batch &operator=(const batch &) = delete;
+
+        // Returns once every task has finished, rethrowing the first
+        // exception one of them threw
+        void wait();
+    };
+};
+
+// Watches the directories of every whitelisted file with inotify and tells
+// subscribers the whitelist name of each file that was written or replaced.
+// Files written in place are reported once closed, but may have been read
+// half written before then, so anything they were loaded into must not
+// still share the file's pages.
+// Callbacks run on the watcher's own thread. The watcher must be destroyed
+// before anything it calls back into.
+class watcher
+{
+  public:
+    using callback = std::function<void(const std::string &path_rel)>;
+
+  private:
+    int inotify = -1;
+    int shutdown = -1;
+    std::unordered_map<int, std::string> directories;
+    std::unordered_multimap<std::string, std::string> names;
+    std::vector<callback> subscribers;
+    std::mutex mutex;
+    std::thread thread;
+
+    void run();
+
+  public:
+    watcher(const class whitelist &wl);
+    ~watcher();
+    watcher(const watcher &) = delete;
+    watcher &operator=(const watcher &) = delete;
+
+    void subscribe(callback callback);
+};
+
 template <typename T, typename... L> class cache
 {
   public:
@@ -77,12 +344,84 @@ template <typename T, typename... L> class cache
     };
 
     using reference = std::shared_ptr<file>;
-    using map = std::unordered_map<std::string, reference>;
+    using handle = std::shared_future<reference>;
+
+    struct statistics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t resident_bytes = 0;
+    };
 
   protected:
+    // One load of one path. Whoever claims it first (a pool worker or a
+    // caller of operator[]) runs it; everyone else waits on result.
+    class job
+    {
+        std::atomic<bool> claimed = false;
+
+      public:
+        const std::string path_rel;
+        const std::string path_abs;
+        const mtime last_modified;
+        std::promise<reference> promise;
+        const handle result;
+        // Set once value holds the loaded file
+        std::atomic<bool> ready = false;
+        // Set by refresh() when the file on disk is newer than this load
+        std::atomic<bool> stale = false;
+        reference value;
+        size_t size = 0;
+        // Value of the cache's clock when last looked up
+        std::atomic<uint64_t> used = 0;
+
+        job(const std::string &rel, const std::string &abs, mtime mtime)
+            : path_rel(rel), path_abs(abs), last_modified(mtime),
+              result(promise.get_future().share())
+        {
+        }
+        bool claim()
+        {
+            return !claimed.load(std::memory_order_relaxed) &&
+                   !claimed.exchange(true);
+        }
+    };
+
+    using map = std::unordered_map<std::string, std::shared_ptr<job>>;
+
+    // Entries are spread over several independently locked maps so lookups
+    // of different paths do not contend on one lock.
+    struct shard
+    {
+        std::shared_mutex mutex;
+        map contents;
+    };
+    static constexpr size_t shard_count = 16;
+    // Hits are counted on a line of each thread's own, so hot keys looked
+    // up from several threads do not bounce one counter between them
+    struct alignas(64) counter
+    {
+        std::atomic<uint64_t> value = 0;
+    };
+    static constexpr size_t counter_count = 64;
+    // References to a loaded file held by its entry and its future
+    static constexpr long held = 2;
+
     const class whitelist &whitelist;
-    map contents;
+    class pool &pool;
+    std::array<shard, shard_count> shards;
+    std::array<counter, counter_count> hits;
     std::mutex mutex;
+    std::condition_variable idle;
+    size_t queued = 0;
+    std::atomic<size_t> budget = SIZE_MAX;
+    // Advanced by every load, so entries looked up since the last load all
+    // count as equally recent without every hit writing a shared counter
+    std::atomic<uint64_t> clock = 0;
+    std::atomic<uint64_t> misses = 0;
+    std::atomic<uint64_t> evictions = 0;
 
     virtual std::filesystem::file_time_type
     get_mtime(const std::string &path) = 0;
@@ -90,39 +429,403 @@ template <typename T, typename... L> class cache
                            const std::string &path_abs,
                            std::filesystem::file_time_type) = 0;
 
-  public:
-    cache(const class whitelist &wl) : whitelist(wl) {}
+    shard &shard_for(const std::string &path)
+    {
+        return shards[std::hash<std::string>()(path) % shard_count];
+    }
+
+    // Bytes of memory a loaded file is charged against the budget
+    virtual size_t measure(const T &contents)
+    {
+        return sizeof(T);
+    }
+
+    void hit()
+    {
+        static std::atomic<size_t> threads = 0;
+        thread_local const size_t thread = threads++ % counter_count;
+        hits[thread].value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void touch(job &job)
+    {
+        uint64_t now = clock.load(std::memory_order_relaxed);
+        if (job.used.load(std::memory_order_relaxed) != now)
+            job.used.store(now, std::memory_order_relaxed);
+    }
 
-    reference operator[](const std::string &_path)
+    // Evicts the least recently used entries nobody outside the cache holds
+    // until the loaded files fit the budget again.
+    void trim()
+    {
+        const size_t limit = budget.load(std::memory_order_relaxed);
+        if (limit == SIZE_MAX)
+            return;
+
+        std::vector<std::shared_ptr<job>> unused;
+        size_t total = 0;
+
+        for (shard &shard : shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto &entry : shard.contents)
+            {
+                if (!entry.second->ready.load(std::memory_order_acquire))
+                    continue;
+                total += entry.second->size;
+                if (entry.second->value.use_count() == held)
+                    unused.push_back(entry.second);
+            }
+        }
+
+        if (total <= limit)
+            return;
+
+        std::sort(unused.begin(),
+                  unused.end(),
+                  [](const std::shared_ptr<job> &a,
+                     const std::shared_ptr<job> &b)
+                  { return a->used < b->used; });
+
+        for (const std::shared_ptr<job> &job : unused)
+        {
+            if (total <= limit)
+                break;
+
+            shard &shard = shard_for(job->path_rel);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            typename map::iterator it = shard.contents.find(job->path_rel);
+            if (it == shard.contents.end() || it->second != job ||
+                job->value.use_count() != held)
+                continue;
+
+            shard.contents.erase(it);
+            total -= job->size;
+            evictions++;
+        }
+    }
+
+    // Whether changed files are reloaded on the watcher thread. Caches whose
+    // loads must run on a particular thread only mark the entry stale.
+    virtual bool background_reload()
+    {
+        return true;
+    }
+
+    // Called when the cache starts watching, before any change is reported
+    virtual void watched()
+    {
+    }
+
+    void changed(const std::string &path)
+    {
+        std::shared_ptr<job> current;
+        {
+            shard &shard = shard_for(path);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            typename map::const_iterator it = shard.contents.find(path);
+            if (it == shard.contents.end())
+                return;
+            current = it->second;
+        }
+
+        if (!background_reload())
+        {
+            current->stale = true;
+            return;
+        }
+
+        mtime mtime;
+        try
+        {
+            mtime = get_mtime(current->path_abs);
+        }
+        catch (const std::filesystem::filesystem_error &)
+        {
+            return;
+        }
+
+        // Lookups keep getting the current entry until the new one is loaded
+        std::shared_ptr<job> next =
+            std::make_shared<job>(current->path_rel, current->path_abs, mtime);
+        run(next);
+        if (!next->ready)
+            return;
+
+        {
+            shard &shard = shard_for(path);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            std::shared_ptr<job> &entry = shard.contents[path];
+            if (!entry || entry->last_modified <= mtime)
+                entry = next;
+        }
+        trim();
+    }
+
+    std::shared_ptr<job> find(const std::string &path)
+    {
+        shard &shard = shard_for(path);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        typename map::const_iterator it = shard.contents.find(path);
+        if (it == shard.contents.end() || it->second->stale)
+            return nullptr;
+        hit();
+        touch(*it->second);
+        return it->second;
+    }
+
+    std::shared_ptr<job> insert(const std::string &_path, bool &created)
     {
-        std::lock_guard<std::mutex> lock(mutex);
         const auto path = whitelist.find(_path);
         if (path == whitelist.end())
             throw filesystem::exception::not_found("Path not in whitelist: " +
                                                    _path);
 
         mtime mtime = get_mtime(path->second);
-        typename map::iterator it = contents.find(_path);
 
-        if (it == contents.end() || it->second->last_modified < mtime)
-            return contents[_path] = load(path->first, path->second, mtime);
-        return it->second;
+        shard &shard = shard_for(_path);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        std::shared_ptr<job> &entry = shard.contents[_path];
+        created = !entry || entry->stale || entry->last_modified < mtime;
+        if (created)
+        {
+            entry = std::make_shared<job>(path->first, path->second, mtime);
+            misses++;
+        }
+        return entry;
+    }
+
+    void run(const std::shared_ptr<job> &job)
+    {
+        if (!job->claim())
+            return;
+
+        try
+        {
+            job->value = load(job->path_rel, job->path_abs, job->last_modified);
+            job->size = measure(*job->value);
+            job->used = ++clock;
+            job->ready.store(true, std::memory_order_release);
+            job->promise.set_value(job->value);
+        }
+        catch (...)
+        {
+            // Forget failed loads so the next request tries again
+            {
+                shard &shard = shard_for(job->path_rel);
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                typename map::iterator it = shard.contents.find(job->path_rel);
+                if (it != shard.contents.end() && it->second == job)
+                    shard.contents.erase(it);
+            }
+            job->promise.set_exception(std::current_exception());
+            return;
+        }
+
+        trim();
+    }
+
+    // Cancels loads still queued and waits for the ones already running.
+    // Workers call load() and get_mtime() through this object, so this runs
+    // in the destructor of drained, before any cache's members are gone.
+    void shutdown()
+    {
+        for (shard &shard : shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto &entry : shard.contents)
+                if (entry.second->claim())
+                    entry.second->promise.set_exception(
+                        std::make_exception_ptr(filesystem::exception::base(
+                            "Load cancelled: " + entry.first)));
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return queued == 0; });
+    }
+
+    // Implemented by drained alone, so a cache can only be made through it
+    virtual void drain() = 0;
+
+  public:
+    cache(const class whitelist &wl,
+          class pool &p = filesystem::pool::shared())
+        : whitelist(wl), pool(p)
+    {
+    }
+
+    virtual ~cache() = default;
+
+    // Starts loading path on the pool and returns immediately. Requests for
+    // a path that is already loaded or loading share the same result.
+    handle request(const std::string &path)
+    {
+        std::shared_ptr<job> job = find(path);
+        bool created = false;
+
+        if (!job)
+            job = insert(path, created);
+
+        if (created)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued++;
+            }
+            pool.push(
+                [this, job]
+                {
+                    run(job);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queued--;
+                    idle.notify_all();
+                });
+        }
+
+        return job->result;
+    }
+
+    // Synchronous load. If the load has not been picked up by a worker yet
+    // it is run on the calling thread instead of waiting in the queue.
+    // Loaded entries are returned without touching the disk; call refresh()
+    // to pick up files modified since they were loaded.
+    reference operator[](const std::string &path)
+    {
+        {
+            shard &shard = shard_for(path);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            typename map::const_iterator it = shard.contents.find(path);
+            if (it != shard.contents.end() &&
+                it->second->ready.load(std::memory_order_acquire) &&
+                !it->second->stale)
+            {
+                hit();
+                touch(*it->second);
+                return it->second->value;
+            }
+        }
+
+        std::shared_ptr<job> job = find(path);
+        bool created;
+
+        if (!job)
+            job = insert(path, created);
+
+        run(job);
+        return job->result.get();
     };
 
+    // Keeps loaded entries up to date with the files on disk. Modified files
+    // are reloaded in the background and replace the loaded entry once
+    // ready. Without a watcher, entries only change through refresh().
+    void watch(filesystem::watcher &watcher)
+    {
+        watched();
+        watcher.subscribe([this](const std::string &path) { changed(path); });
+    }
+
+    // Checks every loaded entry against the file on disk and marks the
+    // modified ones to be reloaded by their next lookup. Files that have
+    // been removed keep serving their last loaded contents.
+    void refresh()
+    {
+        for (shard &shard : shards)
+        {
+            std::vector<std::shared_ptr<job>> jobs;
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                for (const auto &entry : shard.contents)
+                    jobs.push_back(entry.second);
+            }
+
+            for (const std::shared_ptr<job> &job : jobs)
+            {
+                try
+                {
+                    if (get_mtime(job->path_abs) > job->last_modified)
+                        job->stale = true;
+                }
+                catch (const std::filesystem::filesystem_error &)
+                {
+                }
+            }
+        }
+    }
+
+    // Limits the bytes of loaded files kept around once nothing else holds
+    // them. Files in use are never evicted, so the cache may go over budget.
+    void set_budget(size_t bytes)
+    {
+        budget = bytes;
+        trim();
+    }
+
+    statistics stats()
+    {
+        statistics result;
+        result.misses = misses;
+        result.evictions = evictions;
+        for (const counter &counter : hits)
+            result.hits += counter.value.load(std::memory_order_relaxed);
+
+        for (shard &shard : shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto &entry : shard.contents)
+                if (entry.second->ready.load(std::memory_order_acquire))
+                {
+                    result.entries++;
+                    result.resident_bytes += entry.second->size;
+                }
+        }
+
+        return result;
+    }
+
     bool contains(const std::string &path)
     {
         return whitelist.find(path) != whitelist.end();
     }
 };
 
-class cache_binary : public cache<filesystem::allocation>
+// The form every cache is made in. Its destructor runs before that of the
+// cache it wraps, so loads still running finish while all of it is alive.
+template <typename C> class drained final : public C
 {
+    void drain() override
+    {
+        this->shutdown();
+    }
+
+  public:
+    using C::C;
+    ~drained()
+    {
+        drain();
+    }
+};
+
+// Loose files are mapped until the cache is watched, and copied from then
+// on, since a watched file may be rewritten in place while its last version
+// is still in use. Watch before loading, as files loaded earlier stay mapped.
+class cache_binary_base : public cache<filesystem::mapping,
+                                       const whitelist &,
+                                       enum mapping::source>
+{
+    std::atomic<enum mapping::source> source = mapping::source::mapped;
+
   protected:
     reference load(const std::string &path_rel,
                    const std::string &path_abs,
                    std::filesystem::file_time_type mtime) override
     {
-        return std::make_shared<cache_binary::file>(path_abs, mtime);
+        return std::make_shared<file>(
+            path_rel, mtime, whitelist, source.load());
+    }
+
+    void watched() override
+    {
+        source = mapping::source::copied;
     }
 
     std::filesystem::file_time_type get_mtime(const std::string &path) override
@@ -130,10 +833,20 @@ class cache_binary : public cache<filesystem::allocation>
         return std::filesystem::last_write_time(path);
     }
 
+    size_t measure(const filesystem::mapping &contents) override
+    {
+        return contents.size();
+    }
+
   public:
-    cache_binary(const class whitelist &wl) : cache<filesystem::allocation>(wl)
+    cache_binary_base(const class whitelist &wl,
+                      class pool &p = filesystem::pool::shared())
+        : cache<filesystem::mapping,
+                const class whitelist &,
+                enum mapping::source>(wl, p)
     {
     }
 };
+using cache_binary = drained<cache_binary_base>;
 
 }; // namespace engine::filesystem
\ No newline at end of file
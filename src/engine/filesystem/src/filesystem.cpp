@@ -1,5 +1,22 @@
+#include <algorithm>
+#include <chrono>
 #include <engine/filesystem.hpp>
+#include <errno.h>
+#include <fcntl.h>
 #include <fstream>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
 
 namespace engine::filesystem
 {
@@ -25,15 +42,653 @@ filesystem::allocation::allocation(const std::string &file_path)
 {
 }
 
+filesystem::mapping::mapping(const std::string &path, enum source source)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        throw filesystem::exception::not_found("Could not open " + path +
+                                               ": " + strerror(errno));
+
+    struct stat info;
+
+    if (fstat(fd, &info) < 0)
+    {
+        int error = errno;
+        close(fd);
+        throw filesystem::exception::base("Could not stat " + path + ": " +
+                                          strerror(error));
+    }
+
+    if (!S_ISREG(info.st_mode) || source == source::copied)
+    {
+        close(fd);
+        std::shared_ptr<engine::memory::allocation> contents =
+            std::make_shared<engine::memory::allocation>(from_file(path));
+        length = contents->size();
+        region = std::shared_ptr<const uint8_t>(contents, contents->data());
+        return;
+    }
+
+    length = info.st_size;
+
+    if (length == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+
+    if (address == MAP_FAILED)
+        throw filesystem::exception::base("Could not map " + path + ": " +
+                                          strerror(error));
+
+    const size_t mapped_length = length;
+    region = std::shared_ptr<const uint8_t>(
+        (const uint8_t *)address,
+        [mapped_length](const uint8_t *address)
+        { munmap((void *)address, mapped_length); });
+}
+
+filesystem::mapping::mapping(const std::string &path_rel,
+                             const class whitelist &wl,
+                             enum source source)
+    : mapping(wl.open(path_rel, source))
+{
+}
+
+filesystem::mapping::mapping(const mapping &source,
+                             size_t offset,
+                             size_t length)
+    : region(source.region, source.data() + offset), length(length)
+{
+    assert(offset + length <= source.size());
+}
+
+filesystem::mapping::mapping(std::shared_ptr<const uint8_t> _region,
+                             size_t _length)
+    : region(_region), length(_length)
+{
+}
+
+namespace
+{
+struct codec_counters
+{
+    std::atomic<uint64_t> entries = 0;
+    std::atomic<uint64_t> stored_bytes = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<uint64_t> nanoseconds = 0;
+} counters[filesystem::pack::codec_count];
+
+void count(filesystem::pack::codec codec,
+           const filesystem::pack::entry &entry,
+           std::chrono::steady_clock::time_point start)
+{
+    codec_counters &counter = counters[(size_t)codec];
+    counter.entries++;
+    counter.stored_bytes += entry.stored_size;
+    counter.bytes += entry.size;
+    counter.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+}
+
+#ifdef USE_ZLIB
+// Input and output are handed to zlib in pieces so pages of the pack are
+// read as they are needed and sizes past 4GiB fit in zlib's counters
+constexpr uint64_t inflate_chunk = 1 << 20;
+
+filesystem::mapping inflate_entry(const filesystem::mapping &contents,
+                                  const filesystem::pack::entry &entry,
+                                  const std::string &name)
+{
+    std::shared_ptr<uint8_t> output(new uint8_t[entry.size],
+                                    std::default_delete<uint8_t[]>());
+    const uint8_t *in = contents.data() + entry.offset;
+    uint8_t *out = output.get();
+    uint64_t in_left = entry.stored_size;
+    uint64_t out_left = entry.size;
+    z_stream stream = {};
+
+    if (inflateInit(&stream) != Z_OK)
+        throw filesystem::exception::base("Could not start inflating " +
+                                          name);
+
+    int status;
+    do
+    {
+        if (stream.avail_in == 0)
+        {
+            uInt length = std::min(in_left, inflate_chunk);
+            stream.next_in = (Bytef *)in;
+            stream.avail_in = length;
+            in += length;
+            in_left -= length;
+        }
+        if (stream.avail_out == 0)
+        {
+            uInt length = std::min(out_left, inflate_chunk);
+            stream.next_out = out;
+            stream.avail_out = length;
+            out += length;
+            out_left -= length;
+        }
+        status = inflate(&stream, Z_NO_FLUSH);
+    } while (status == Z_OK);
+
+    inflateEnd(&stream);
+
+    if (status != Z_STREAM_END || stream.total_out != entry.size)
+        throw filesystem::exception::base("Corrupt compressed entry " + name);
+
+    return filesystem::mapping(output, entry.size);
+}
+
+bool deflate_entry(const filesystem::mapping &file, std::string &output)
+{
+    uLongf length = compressBound(file.size());
+    output.resize(length);
+
+    if (compress2((Bytef *)output.data(),
+                  &length,
+                  file.data(),
+                  file.size(),
+                  Z_BEST_COMPRESSION) != Z_OK)
+        return false;
+
+    output.resize(length);
+    return true;
+}
+#endif
+} // namespace
+
+filesystem::pack::statistics filesystem::pack::stats(enum codec codec)
+{
+    const codec_counters &counter = counters[(size_t)codec];
+    statistics result;
+    result.entries = counter.entries;
+    result.stored_bytes = counter.stored_bytes;
+    result.bytes = counter.bytes;
+    result.nanoseconds = counter.nanoseconds;
+    return result;
+}
+
+filesystem::pack::pack(const std::string &_path)
+    : contents(_path), path(std::filesystem::absolute(_path).string()),
+      last_modified(std::filesystem::last_write_time(_path))
+{
+    if (contents.size() < sizeof(struct header))
+        throw filesystem::exception::wrong_type("Not a pack: " + path);
+
+    const struct header &header = *(const struct header *)contents.data();
+
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0)
+        throw filesystem::exception::wrong_type("Not a pack: " + path);
+
+    if (header.version != version)
+        throw filesystem::exception::wrong_type(
+            "Unsupported pack version " + std::to_string(header.version) +
+            ": " + path);
+
+    const uint64_t index_size = (uint64_t)header.count * sizeof(entry);
+
+    if (header.index_offset % alignof(entry) != 0 ||
+        header.index_offset > contents.size() ||
+        index_size > contents.size() - header.index_offset ||
+        header.names_offset > contents.size())
+        throw filesystem::exception::base("Corrupt pack index: " + path);
+
+    const entry *index = (const entry *)(contents.data() + header.index_offset);
+    const char *names = (const char *)contents.data() + header.names_offset;
+    const uint64_t names_size = contents.size() - header.names_offset;
+
+    entries.reserve(header.count);
+
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        const entry &entry = index[i];
+
+        if (entry.offset > contents.size() ||
+            entry.stored_size > contents.size() - entry.offset ||
+            entry.name_offset > names_size ||
+            entry.name_length > names_size - entry.name_offset)
+            throw filesystem::exception::base("Corrupt pack entry: " + path);
+
+        switch (entry.codec)
+        {
+        case codec::stored:
+            if (entry.size != entry.stored_size)
+                throw filesystem::exception::base("Corrupt pack entry: " +
+                                                  path);
+            break;
+#ifdef USE_ZLIB
+        case codec::deflate:
+            break;
+#endif
+        default:
+            throw filesystem::exception::wrong_type(
+                "Unsupported pack entry codec: " + path);
+        }
+
+        entries.emplace(
+            std::string_view(names + entry.name_offset, entry.name_length),
+            &entry);
+    }
+}
+
+const filesystem::pack::entry *
+filesystem::pack::find(const std::string &name) const
+{
+    const auto it = entries.find(name);
+    if (it == entries.end())
+        return nullptr;
+    return it->second;
+}
+
+filesystem::mapping filesystem::pack::open(const std::string &name) const
+{
+    const entry *entry = find(name);
+
+    if (!entry)
+        throw filesystem::exception::not_found("Not in pack " + path + ": " +
+                                               name);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    switch (entry->codec)
+    {
+#ifdef USE_ZLIB
+    case codec::deflate:
+    {
+        mapping result = inflate_entry(contents, *entry, name);
+        count(codec::deflate, *entry, start);
+        return result;
+    }
+#endif
+    default:
+        count(codec::stored, *entry, start);
+        return mapping(contents, entry->offset, entry->size);
+    }
+}
+
+void filesystem::pack::write(const std::string &output,
+                             const class whitelist &wl,
+                             enum codec codec)
+{
+    std::vector<std::pair<std::string, std::string>> files;
+
+    for (const auto &[name, absolute] : wl)
+        if (std::filesystem::is_regular_file(absolute))
+            files.emplace_back(name, absolute);
+
+    std::sort(files.begin(), files.end());
+
+    std::vector<entry> index;
+    std::string names;
+    uint64_t offset = sizeof(struct header);
+    const std::string temporary = output + ".tmp";
+    std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+
+    if (!stream)
+        throw filesystem::exception::base("Could not create " + temporary);
+
+    stream.write(std::string(sizeof(struct header), '\0').data(),
+                 sizeof(struct header));
+
+    for (const auto &[name, absolute] : files)
+    {
+        const uint64_t aligned =
+            (offset + alignment - 1) / alignment * alignment;
+        stream.write(std::string(aligned - offset, '\0').data(),
+                     aligned - offset);
+
+        mapping file(absolute);
+
+        entry entry = {};
+        entry.offset = aligned;
+        entry.size = file.size();
+        entry.stored_size = file.size();
+        entry.name_offset = names.size();
+        entry.name_length = name.size();
+        entry.codec = codec::stored;
+
+#ifdef USE_ZLIB
+        std::string compressed;
+        if (codec == codec::deflate && deflate_entry(file, compressed) &&
+            compressed.size() < file.size() - file.size() / 16)
+        {
+            entry.codec = codec::deflate;
+            entry.stored_size = compressed.size();
+            stream.write(compressed.data(), compressed.size());
+        }
+        else
+#endif
+            stream.write((const char *)file.data(), file.size());
+
+        index.push_back(entry);
+
+        names += name;
+        offset = aligned + entry.stored_size;
+    }
+
+    struct header header = {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.count = index.size();
+    header.index_offset =
+        (offset + alignof(entry) - 1) / alignof(entry) * alignof(entry);
+    header.names_offset = header.index_offset + index.size() * sizeof(entry);
+
+    stream.write(std::string(header.index_offset - offset, '\0').data(),
+                 header.index_offset - offset);
+    stream.write((const char *)index.data(), index.size() * sizeof(entry));
+    stream.write(names.data(), names.size());
+    stream.seekp(0);
+    stream.write((const char *)&header, sizeof(header));
+    stream.close();
+
+    if (!stream)
+        throw filesystem::exception::base("Could not write " + temporary);
+
+    std::filesystem::rename(temporary, output);
+}
+
+filesystem::pool::pool(size_t threads)
+{
+    if (threads == 0)
+        threads = 1;
+
+    for (size_t i = 0; i < threads; i++)
+        workers.emplace_back(&pool::work, this);
+}
+
+filesystem::pool::~pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void filesystem::pool::work()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+void filesystem::pool::push(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(task));
+    }
+    ready.notify_one();
+}
+
+void filesystem::pool::batch::state::run()
+{
+    size_t index;
+
+    while ((index = next++) < count)
+    {
+        try
+        {
+            task(index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++finished == count)
+            done.notify_all();
+    }
+}
+
+filesystem::pool::batch::batch(class pool &pool,
+                               size_t count,
+                               std::function<void(size_t)> task)
+    : shared(std::make_shared<state>())
+{
+    shared->task = std::move(task);
+    shared->count = count;
+
+    // Helpers that start after the batch is done find no index left, and
+    // hold the state so it outlives them
+    const size_t helpers = std::min(count, pool.size());
+    for (size_t i = 0; i < helpers; i++)
+        pool.push([state = shared] { state->run(); });
+}
+
+filesystem::pool::batch::~batch()
+{
+    if (waited)
+        return;
+
+    try
+    {
+        wait();
+    }
+    catch (...)
+    {
+    }
+}
+
+void filesystem::pool::batch::wait()
+{
+    waited = true;
+    shared->run();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock,
+                      [this] { return shared->finished == shared->count; });
+
+    if (shared->error)
+        std::rethrow_exception(std::exchange(shared->error, nullptr));
+}
+
+filesystem::pool &filesystem::pool::shared()
+{
+    static pool instance;
+    return instance;
+}
+
+filesystem::watcher::watcher(const class whitelist &wl)
+{
+    inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify < 0)
+        throw filesystem::exception::base(std::string("inotify_init1: ") +
+                                          strerror(errno));
+
+    shutdown = eventfd(0, EFD_CLOEXEC);
+    if (shutdown < 0)
+    {
+        int error = errno;
+        close(inotify);
+        throw filesystem::exception::base(std::string("eventfd: ") +
+                                          strerror(error));
+    }
+
+    std::unordered_set<std::string> watched;
+
+    for (const auto &[name, absolute] : wl)
+    {
+        names.emplace(absolute, name);
+
+        std::string directory =
+            std::filesystem::path(absolute).parent_path().string();
+
+        if (!watched.insert(directory).second)
+            continue;
+
+        int wd = inotify_add_watch(inotify,
+                                   directory.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+        {
+            int error = errno;
+            close(inotify);
+            close(shutdown);
+            throw filesystem::exception::base("Could not watch " + directory +
+                                              ": " + strerror(error));
+        }
+
+        directories[wd] = directory;
+    }
+
+    thread = std::thread(&watcher::run, this);
+}
+
+filesystem::watcher::~watcher()
+{
+    uint64_t one = 1;
+    if (write(shutdown, &one, sizeof(one)) != sizeof(one))
+        abort();
+
+    thread.join();
+    close(inotify);
+    close(shutdown);
+}
+
+void filesystem::watcher::subscribe(callback callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    subscribers.push_back(std::move(callback));
+}
+
+void filesystem::watcher::run()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    struct pollfd fds[2] = {{inotify, POLLIN, 0}, {shutdown, POLLIN, 0}};
+
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        if (fds[1].revents)
+            return;
+
+        // Collect one batch so a file saved in several steps reloads once
+        std::unordered_set<std::string> changed;
+        ssize_t length;
+
+        while ((length = read(inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *at = buffer; at < buffer + length;)
+            {
+                const struct inotify_event *event =
+                    (const struct inotify_event *)at;
+                at += sizeof(struct inotify_event) + event->len;
+
+                const auto directory = directories.find(event->wd);
+                if (directory == directories.end() || event->len == 0)
+                    continue;
+
+                auto range = names.equal_range(directory->second + "/" +
+                                               event->name);
+                for (auto it = range.first; it != range.second; it++)
+                    changed.insert(it->second);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string &name : changed)
+            for (const callback &callback : subscribers)
+            {
+                try
+                {
+                    callback(name);
+                }
+                catch (...)
+                {
+                }
+            }
+    }
+}
+
 filesystem::whitelist::whitelist(const std::string &root)
 {
-    add_recursive(root);
+    if (std::filesystem::is_regular_file(root))
+        mount(root);
+    else
+        add_recursive(root);
 }
 
 void filesystem::whitelist::add(const std::string &name,
                                 const std::string &absolute)
 {
     (*this)[name] = std::filesystem::absolute(absolute).string();
+    packed.erase(name);
+}
+
+void filesystem::whitelist::mount(const std::string &pack_path)
+{
+    std::shared_ptr<struct mount> mount = std::make_shared<struct mount>();
+    mount->current = std::make_shared<pack>(pack_path);
+    mount->path = mount->current->path;
+
+    for (const auto &entry : *mount->current)
+    {
+        std::string name(entry.first);
+        (*this)[name] = mount->path;
+        packed[name] = mount;
+    }
+}
+
+filesystem::mapping
+filesystem::whitelist::open(const std::string &name,
+                            enum mapping::source source) const
+{
+    const auto packed_it = packed.find(name);
+
+    if (packed_it != packed.end())
+    {
+        struct mount &mount = *packed_it->second;
+        std::shared_ptr<const pack> current;
+        {
+            std::lock_guard<std::mutex> lock(mount.mutex);
+            if (std::filesystem::last_write_time(mount.path) !=
+                mount.current->last_modified)
+                mount.current = std::make_shared<pack>(mount.path);
+            current = mount.current;
+        }
+        return current->open(name);
+    }
+
+    const auto it = find(name);
+
+    if (it == end())
+        throw filesystem::exception::not_found("Path not in whitelist: " +
+                                               name);
+
+    return mapping(it->second, source);
 }
 
 void filesystem::whitelist::add_recursive(const std::string &root)
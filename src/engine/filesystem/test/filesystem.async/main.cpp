@@ -0,0 +1,111 @@
+#include <atomic>
+#include <engine/filesystem.hpp>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class counting_loads : public engine::filesystem::cache_binary_base
+{
+  protected:
+    reference load(const std::string &path_rel,
+                   const std::string &path_abs,
+                   std::filesystem::file_time_type mtime) override
+    {
+        loads++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return cache_binary_base::load(path_rel, path_abs, mtime);
+    }
+
+  public:
+    std::atomic<int> loads = 0;
+    counting_loads(const engine::filesystem::whitelist &wl,
+                   engine::filesystem::pool &pool)
+        : engine::filesystem::cache_binary_base(wl, pool)
+    {
+    }
+};
+using counting_cache = engine::filesystem::drained<counting_loads>;
+
+static bool check(const counting_cache::reference &ref)
+{
+    const engine::filesystem::mapping &contents = *ref;
+    return std::string(contents.begin(), contents.end()) ==
+           "Test file contents";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <directory>\n";
+        return 1;
+    }
+
+    engine::filesystem::whitelist wl(argv[1]);
+    engine::filesystem::pool pool(4);
+
+    {
+        counting_cache cache(wl, pool);
+
+        counting_cache::handle first = cache.request("test.txt");
+        counting_cache::handle second = cache.request("test.txt");
+
+        if (first.get() != second.get() || cache.loads != 1)
+        {
+            std::cerr << "Concurrent requests were not shared\n";
+            return 2;
+        }
+
+        if (!check(first.get()))
+        {
+            std::cerr << "File contents unexpected\n";
+            return 3;
+        }
+
+        if (cache["test.txt"] != first.get() || cache.loads != 1)
+        {
+            std::cerr << "Loaded file was not reused\n";
+            return 4;
+        }
+    }
+
+    {
+        counting_cache cache(wl, pool);
+        std::vector<std::thread> threads;
+        std::atomic<int> failures = 0;
+
+        for (int i = 0; i < 8; i++)
+            threads.emplace_back(
+                [&]
+                {
+                    if (!check(cache["test.txt"]))
+                        failures++;
+                });
+
+        for (std::thread &thread : threads)
+            thread.join();
+
+        if (failures != 0 || cache.loads != 1)
+        {
+            std::cerr << "Synchronous loads were not shared (" << cache.loads
+                      << " loads, " << failures << " failures)\n";
+            return 5;
+        }
+    }
+
+    try
+    {
+        counting_cache cache(wl, pool);
+        cache.request("missing.txt");
+        std::cerr << "Expected not_found\n";
+        return 6;
+    }
+    catch (const engine::filesystem::exception::not_found &)
+    {
+    }
+
+    std::cout << "Success for " << argv[0] << "\n";
+
+    return 0;
+}
@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <engine/filesystem.hpp>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <unistd.h>
 
 int main(int argc, char *argv[])
 {
@@ -14,13 +16,14 @@ int main(int argc, char *argv[])
 
     engine::filesystem::whitelist wl(file_path.parent_path().string());
     engine::filesystem::cache_binary cache(wl);
-    engine::filesystem::cache_binary::reference ref = cache[file_path.string()];
+    engine::filesystem::cache_binary::reference ref =
+        cache[file_path.filename().string()];
     if (!ref)
     {
         std::cerr << "Failed to load file: " << file_path.string() << "\n";
         return 2;
     }
-    const engine::filesystem::allocation &alloc = *ref;
+    const engine::filesystem::mapping &alloc = *ref;
     std::cout << "Loaded file: " << file_path.string() << " (" << alloc.size()
               << " bytes)\n";
 
@@ -32,6 +35,25 @@ int main(int argc, char *argv[])
         return 3;
     }
 
+    // A copied file keeps its contents when the file is truncated and
+    // written again in place, which would pull pages out from under a
+    // mapping
+    const std::filesystem::path rewritten =
+        std::filesystem::temp_directory_path() /
+        ("filesystem.base." + std::to_string(getpid()));
+    std::ofstream(rewritten) << std::string(1 << 16, 'a');
+    const engine::filesystem::mapping copy(
+        rewritten.string(), engine::filesystem::mapping::source::copied);
+    std::ofstream(rewritten, std::ios::trunc) << "b";
+    const std::string copied(copy.begin(), copy.end());
+    std::filesystem::remove(rewritten);
+
+    if (copied != std::string(1 << 16, 'a'))
+    {
+        std::cerr << "Copied file changed when it was rewritten\n";
+        return 4;
+    }
+
     std::cout << "Success for \n" << argv[0] << "\n";
 
     return 0;
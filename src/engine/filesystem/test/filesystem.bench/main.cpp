@@ -0,0 +1,97 @@
+#include <chrono>
+#include <engine/filesystem.hpp>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+using bench_clock = std::chrono::steady_clock;
+
+// Ask the kernel to drop the file from the page cache so the next load has
+// to go to disk. This is best effort: pages that are still mapped elsewhere
+// are kept.
+static void drop_cache(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Touch one byte per page so that lazily mapped files are fully paged in.
+static uint64_t touch(const uint8_t *begin, const uint8_t *end)
+{
+    uint64_t sum = 0;
+    for (const uint8_t *p = begin; p < end; p += 4096)
+        sum += *p;
+    return sum;
+}
+
+struct result
+{
+    double open = 0;
+    double open_and_read = 0;
+};
+
+template <typename T>
+static result run(const std::string &path, size_t iterations, bool cold)
+{
+    result total;
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        if (cold)
+            drop_cache(path);
+
+        bench_clock::time_point start = bench_clock::now();
+        T contents(path);
+        bench_clock::time_point opened = bench_clock::now();
+        sum += touch(contents.data(), contents.data() + contents.size());
+        bench_clock::time_point read = bench_clock::now();
+
+        total.open += std::chrono::duration<double>(opened - start).count();
+        total.open_and_read +=
+            std::chrono::duration<double>(read - start).count();
+    }
+
+    if (sum == 1)
+        std::cout << "";
+
+    total.open /= iterations;
+    total.open_and_read /= iterations;
+    return total;
+}
+
+static void print(const std::string &name, const result &result)
+{
+    std::cout << name << ": open " << result.open * 1e3 << " ms, open+read "
+              << result.open_and_read * 1e3 << " ms\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <path-to-file> [iterations]\n";
+        return 1;
+    }
+
+    const std::string path = argv[1];
+    const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 10;
+
+    std::cout << "File: " << path << " ("
+              << engine::filesystem::mapping(path).size() << " bytes), "
+              << iterations << " iterations\n";
+
+    using stream = engine::filesystem::allocation;
+    using mapping = engine::filesystem::mapping;
+
+    print("stream cold", run<stream>(path, iterations, true));
+    print("mmap   cold", run<mapping>(path, iterations, true));
+    print("stream warm", run<stream>(path, iterations, false));
+    print("mmap   warm", run<mapping>(path, iterations, false));
+
+    return 0;
+}
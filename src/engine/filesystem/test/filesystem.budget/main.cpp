@@ -0,0 +1,94 @@
+#include <engine/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using cache = engine::filesystem::cache_binary;
+
+static std::string name(int index)
+{
+    return std::to_string(index) + ".bin";
+}
+
+static bool expect(cache &cache,
+                   uint64_t hits,
+                   uint64_t misses,
+                   uint64_t evictions,
+                   size_t entries,
+                   const std::string &step)
+{
+    cache::statistics stats = cache.stats();
+
+    if (stats.hits == hits && stats.misses == misses &&
+        stats.evictions == evictions && stats.entries == entries &&
+        stats.resident_bytes == entries * 1000)
+        return true;
+
+    std::cerr << step << ": hits " << stats.hits << " misses " << stats.misses
+              << " evictions " << stats.evictions << " entries "
+              << stats.entries << " resident " << stats.resident_bytes
+              << "\n";
+    return false;
+}
+
+static int run(cache &cache)
+{
+    for (int i = 0; i < 8; i++)
+        cache[name(i)];
+
+    if (!expect(cache, 0, 8, 0, 8, "unlimited"))
+        return 2;
+
+    cache.set_budget(3000);
+
+    if (!expect(cache, 0, 8, 5, 3, "budget"))
+        return 3;
+
+    // 5, 6 and 7 are resident; touching 5 leaves 6 as the oldest
+    cache[name(5)];
+    cache[name(0)];
+
+    if (!expect(cache, 1, 9, 6, 3, "lru"))
+        return 4;
+
+    cache[name(5)];
+    cache[name(6)];
+
+    if (!expect(cache, 2, 10, 7, 3, "lru order"))
+        return 5;
+
+    // Files still in use stay loaded regardless of the budget
+    cache::reference held = cache[name(3)];
+    cache.set_budget(0);
+
+    if (!expect(cache, 2, 11, 10, 1, "held"))
+        return 6;
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::filesystem::path root =
+        std::filesystem::temp_directory_path() /
+        ("filesystem.budget." + std::to_string(getpid()));
+    std::filesystem::create_directories(root);
+
+    for (int i = 0; i < 8; i++)
+        std::ofstream(root / name(i)) << std::string(1000, 'a' + i);
+
+    int result;
+    {
+        engine::filesystem::whitelist wl(root.string());
+        cache cache(wl);
+        result = run(cache);
+    }
+
+    std::filesystem::remove_all(root);
+
+    if (result == 0)
+        std::cout << "Success for " << argv[0] << "\n";
+
+    return result;
+}
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <engine/filesystem.hpp>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures cache hit throughput with several threads looking up the same
+// already-loaded paths, the way a renderer looks up its assets every frame.
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <directory> [max-threads] [lookups-per-thread]\n";
+        return 1;
+    }
+
+    size_t max_threads = argc > 2 ? std::stoul(argv[2])
+                                  : std::thread::hardware_concurrency();
+    size_t lookups = argc > 3 ? std::stoul(argv[3]) : 1000000;
+
+    if (max_threads == 0)
+        max_threads = 1;
+
+    engine::filesystem::whitelist wl(argv[1]);
+    engine::filesystem::cache_binary cache(wl);
+    std::vector<std::string> keys;
+
+    for (const auto &[name, path] : wl)
+        if (std::filesystem::is_regular_file(path))
+        {
+            cache[name];
+            keys.push_back(name);
+        }
+
+    if (keys.empty())
+    {
+        std::cerr << "No files under " << argv[1] << "\n";
+        return 2;
+    }
+
+    std::cout << keys.size() << " hot keys, " << lookups
+              << " lookups per thread\n";
+
+    double single = 0;
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        std::vector<std::thread> workers;
+        std::atomic<size_t> misses = 0;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t t = 0; t < threads; t++)
+            workers.emplace_back(
+                [&, t]
+                {
+                    for (size_t i = 0; i < lookups; i++)
+                        if (!cache[keys[(i + t) % keys.size()]])
+                            misses++;
+                });
+
+        for (std::thread &worker : workers)
+            worker.join();
+
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        double rate = threads * lookups / seconds / 1e6;
+
+        if (threads == 1)
+            single = rate;
+
+        std::cout << threads << " threads: " << rate << " M lookups/s ("
+                  << rate / single << "x)\n";
+
+        if (misses != 0)
+        {
+            std::cerr << "Lookups returned no file\n";
+            return 3;
+        }
+    }
+
+    return 0;
+}
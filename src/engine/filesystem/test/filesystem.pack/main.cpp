@@ -0,0 +1,117 @@
+#include <chrono>
+#include <engine/filesystem.hpp>
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+
+static double since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static int check(const engine::filesystem::whitelist &directory,
+                 engine::filesystem::pack::codec codec)
+{
+    std::string pack_path =
+        (std::filesystem::temp_directory_path() /
+         ("filesystem.pack." + std::to_string(getpid()) + ".mbpack"))
+            .string();
+
+    engine::filesystem::pack::write(pack_path, directory, codec);
+
+    auto start = std::chrono::steady_clock::now();
+    engine::filesystem::whitelist packed(pack_path);
+    std::cout << "mount " << since(start) << " ms, "
+              << std::filesystem::file_size(pack_path) << " bytes\n";
+
+    int result = 0;
+    size_t files = 0;
+    engine::filesystem::pack pack(pack_path);
+    engine::filesystem::cache_binary cache(packed);
+
+    for (const auto &[name, absolute] : directory)
+    {
+        if (!std::filesystem::is_regular_file(absolute))
+            continue;
+        files++;
+
+        engine::filesystem::mapping expected(absolute);
+        engine::filesystem::cache_binary::reference ref = cache[name];
+        const engine::filesystem::mapping &actual = *ref;
+
+        if (actual.size() != expected.size() ||
+            memcmp(actual.data(), expected.data(), actual.size()) != 0)
+        {
+            std::cerr << "Contents differ for " << name << "\n";
+            result = 2;
+        }
+
+        if (pack.find(name)->codec == engine::filesystem::pack::codec::stored &&
+            (uintptr_t)actual.data() % engine::filesystem::pack::alignment)
+        {
+            std::cerr << "Entry not aligned: " << name << "\n";
+            result = 3;
+        }
+    }
+
+    if (files == 0 || pack.size() != files)
+    {
+        std::cerr << "Pack has the wrong number of files\n";
+        result = 4;
+    }
+
+    try
+    {
+        cache["missing"];
+        std::cerr << "Expected not_found\n";
+        result = 5;
+    }
+    catch (const engine::filesystem::exception::not_found &)
+    {
+    }
+
+    std::filesystem::remove(pack_path);
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <directory>\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    engine::filesystem::whitelist directory(argv[1]);
+    std::cout << "walk " << since(start) << " ms\n";
+
+    int result = check(directory, engine::filesystem::pack::codec::stored);
+
+#ifdef USE_ZLIB
+    if (result == 0)
+        result = check(directory, engine::filesystem::pack::codec::deflate);
+
+    engine::filesystem::pack::statistics stats =
+        engine::filesystem::pack::stats(
+            engine::filesystem::pack::codec::deflate);
+
+    std::cout << "deflate: " << stats.entries << " entries, "
+              << stats.stored_bytes << " -> " << stats.bytes << " bytes in "
+              << stats.nanoseconds / 1e6 << " ms\n";
+
+    if (result == 0 && stats.entries == 0)
+    {
+        std::cerr << "Nothing was compressed\n";
+        result = 6;
+    }
+#endif
+
+    if (result == 0)
+        std::cout << "Success for " << argv[0] << "\n";
+
+    return result;
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <engine/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+static void write(const std::filesystem::path &path,
+                  const std::string &contents)
+{
+    std::filesystem::path temporary = path.string() + ".tmp";
+    std::ofstream(temporary) << contents;
+    std::filesystem::rename(temporary, path);
+}
+
+static std::string read(engine::filesystem::cache_binary &cache)
+{
+    engine::filesystem::cache_binary::reference ref = cache["watched.txt"];
+    const engine::filesystem::mapping &contents = *ref;
+    return std::string(contents.begin(), contents.end());
+}
+
+// Waits for the cache to pick up contents
+static bool wait_for(engine::filesystem::cache_binary &cache,
+                     const std::string &contents)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+    while (read(cache) != contents)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::filesystem::path root =
+        std::filesystem::temp_directory_path() /
+        ("filesystem.watch." + std::to_string(getpid()));
+    std::filesystem::create_directories(root);
+    write(root / "watched.txt", "before");
+
+    int result = 0;
+
+    {
+        engine::filesystem::whitelist wl(root.string());
+        engine::filesystem::cache_binary cache(wl);
+        engine::filesystem::watcher watcher(wl);
+        cache.watch(watcher);
+
+        if (read(cache) != "before")
+        {
+            std::cerr << "Initial contents unexpected\n";
+            result = 2;
+        }
+
+        const std::string large(1 << 16, 'a');
+        write(root / "watched.txt", large);
+
+        if (result == 0 && !wait_for(cache, large))
+        {
+            std::cerr << "Change was not picked up\n";
+            result = 3;
+        }
+
+        // Truncated and written in place while the last version is held,
+        // which must neither change it nor pull its pages away
+        engine::filesystem::cache_binary::reference held =
+            cache["watched.txt"];
+        std::ofstream(root / "watched.txt", std::ios::trunc) << "after";
+
+        if (result == 0 && !wait_for(cache, "after"))
+        {
+            std::cerr << "Change in place was not picked up\n";
+            result = 4;
+        }
+
+        const engine::filesystem::mapping &contents = *held;
+        if (result == 0 &&
+            std::string(contents.begin(), contents.end()) != large)
+        {
+            std::cerr << "Held contents changed\n";
+            result = 5;
+        }
+    }
+
+    std::filesystem::remove_all(root);
+
+    if (result == 0)
+        std::cout << "Success for " << argv[0] << "\n";
+
+    return result;
+}
@@ -0,0 +1,83 @@
+#include <engine/filesystem.hpp>
+#include <iostream>
+#include <map>
+#include <string.h>
+
+// Builds a pack from a directory and prints how well each type of file
+// compressed, to help decide which content is worth compressing.
+
+int main(int argc, char *argv[])
+{
+    using codec = engine::filesystem::pack::codec;
+
+    codec method = codec::stored;
+    int arg = 1;
+
+    if (argc == 4 && strcmp(argv[1], "-z") == 0)
+    {
+        method = codec::deflate;
+        arg++;
+    }
+
+    if (argc - arg != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-z] <directory> <output-pack>\n"
+                  << "  -z  compress entries with deflate where it helps\n";
+        return 1;
+    }
+
+    const char *directory = argv[arg];
+    const char *output = argv[arg + 1];
+
+    try
+    {
+        engine::filesystem::whitelist wl(directory);
+        engine::filesystem::pack::write(output, wl, method);
+
+        engine::filesystem::pack pack(output);
+
+        struct totals
+        {
+            size_t files = 0;
+            size_t compressed = 0;
+            uint64_t bytes = 0;
+            uint64_t stored_bytes = 0;
+        };
+        std::map<std::string, totals> types;
+
+        for (const auto &[name, entry] : pack)
+        {
+            std::string type =
+                std::filesystem::path(name).extension().string();
+            totals &total = types[type.empty() ? "(none)" : type];
+            total.files++;
+            total.compressed += entry->codec != codec::stored;
+            total.bytes += entry->size;
+            total.stored_bytes += entry->stored_size;
+        }
+
+        for (const auto &[type, total] : types)
+            std::cout << type << ": " << total.files << " files, "
+                      << total.compressed << " compressed, " << total.bytes
+                      << " -> " << total.stored_bytes << " bytes ("
+                      << (total.bytes ? 100.0 * total.stored_bytes / total.bytes
+                                      : 100.0)
+                      << "%)\n";
+
+        std::cout << "Packed " << pack.size() << " files into " << output
+                  << " (" << std::filesystem::file_size(output)
+                  << " bytes)\n";
+    }
+    catch (const engine::exception &e)
+    {
+        std::cerr << e.message << "\n";
+        return 2;
+    }
+    catch (const std::filesystem::filesystem_error &e)
+    {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+
+    return 0;
+}
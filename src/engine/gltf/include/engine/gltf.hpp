@@ -6,6 +6,7 @@
 #include <engine/memory.hpp>
 #include <engine/vec.hpp>
 #include <optional>
+#include <string.h>
 #include <string>
 
 namespace skel
@@ -37,7 +38,7 @@ class asset
   public:
     std::string version;
     std::string generator;
-    asset(const json::object &root);
+    asset(const json::lazy &root);
     asset();
 };
 class buffer
@@ -45,8 +46,12 @@ class buffer
   public:
     std::string name;
     std::string uri;
-    engine::memory::allocation contents;
-    buffer(const json::object &root, const glb &glb);
+    engine::memory::const_view contents;
+    // Keeps the file that contents points into alive
+    engine::filesystem::cache_binary::reference source;
+    buffer(const json::lazy &root,
+           const glb &glb,
+           const engine::filesystem::cache_binary::reference &glb_source);
 };
 
 enum class buffer_view_target : uint16_t
@@ -66,7 +71,7 @@ class buffer_view
     offset byte_stride;
     enum buffer_view_target target;
     engine::image::rgba32 get_image() const;
-    buffer_view(const json::object &root, const gltf &gltf);
+    buffer_view(const json::lazy &root, const gltf &gltf);
 };
 enum class component_type : uint16_t
 {
@@ -94,7 +99,7 @@ class accessor_sparse_indices
     const class buffer_view &buffer_view;
     offset byte_offset;
     enum component_type component_type;
-    accessor_sparse_indices(const json::object &root, const gltf &gltf);
+    accessor_sparse_indices(const json::lazy &root, const gltf &gltf);
 };
 
 class accessor_sparse_values
@@ -102,7 +107,7 @@ class accessor_sparse_values
   public:
     const class buffer_view &buffer_view;
     offset byte_offset;
-    accessor_sparse_values(const json::object &root, const gltf &gltf);
+    accessor_sparse_values(const json::lazy &root, const gltf &gltf);
 };
 class accessor_sparse
 {
@@ -110,15 +115,99 @@ class accessor_sparse
     size_t count;
     const accessor_sparse_indices indices;
     const accessor_sparse_values values;
-    accessor_sparse(const json::object &root, const gltf &gltf);
+    accessor_sparse(const json::lazy &root, const gltf &gltf);
 };
-class accessor
+// Component type and component count of the types an accessor can be
+// viewed as
+template <typename T> struct component_traits;
+template <enum component_type C, size_t N> struct component_traits_of
+{
+    static constexpr enum component_type type = C;
+    static constexpr size_t count = N;
+};
+template <>
+struct component_traits<int8_t>
+    : component_traits_of<component_type::BYTE, 1>
+{
+};
+template <>
+struct component_traits<uint8_t>
+    : component_traits_of<component_type::UBYTE, 1>
+{
+};
+template <>
+struct component_traits<int16_t>
+    : component_traits_of<component_type::SHORT, 1>
+{
+};
+template <>
+struct component_traits<uint16_t>
+    : component_traits_of<component_type::USHORT, 1>
+{
+};
+template <>
+struct component_traits<uint32_t>
+    : component_traits_of<component_type::UINT, 1>
+{
+};
+template <>
+struct component_traits<float>
+    : component_traits_of<component_type::FLOAT, 1>
 {
-    float get_component_as_float(size_t attribute_index,
-                                 size_t component_index) const;
-    uint32_t get_component_as_index(size_t attribute_index,
-                                    size_t component_index) const;
+};
+template <typename T>
+struct component_traits<vec::vec2<T>>
+    : component_traits_of<component_traits<T>::type, 2>
+{
+};
+template <typename T>
+struct component_traits<vec::vec3<T>>
+    : component_traits_of<component_traits<T>::type, 3>
+{
+};
+template <typename T>
+struct component_traits<vec::vec4<T>>
+    : component_traits_of<component_traits<T>::type, 4>
+{
+};
+template <typename T>
+struct component_traits<vec::mat4<T>>
+    : component_traits_of<component_traits<T>::type, 16>
+{
+};
 
+// Elements of an accessor read in place as T. Bounds are checked once when
+// the view is made, so reading an element does no checks of its own.
+template <typename T> class accessor_view
+{
+    const uint8_t *first;
+    size_t stride;
+    size_t count;
+
+  public:
+    accessor_view(const uint8_t *_first, size_t _stride, size_t _count)
+        : first(_first), stride(_stride), count(_count)
+    {
+    }
+    size_t size() const
+    {
+        return count;
+    }
+    // Elements follow each other with nothing between them
+    bool contiguous() const
+    {
+        return stride == sizeof(T);
+    }
+    T operator[](size_t index) const
+    {
+        T element;
+        memcpy((void *)&element, first + index * stride, sizeof(T));
+        return element;
+    }
+};
+
+class accessor
+{
   public:
     std::string name;
     const class buffer_view &buffer_view;
@@ -127,7 +216,7 @@ class accessor
     attribute_type type;
     size_t count;
     std::unique_ptr<accessor_sparse> sparse;
-    accessor(const json::object &root, const gltf &gltf);
+    accessor(const json::lazy &root, const gltf &gltf);
     bool normalized;
     size_t component_size;
     size_t attribute_size;
@@ -147,15 +236,65 @@ class accessor
                attribute_index * stride + component_index * component_size;
     }
 
-    void dump_uint32(std::vector<uint8_t> &out) const;
-    void dump_uint16(std::vector<uint8_t> &out) const;
-    void dump_fvec3(std::vector<uint8_t> &out) const;
-    void dump_fvec2(std::vector<uint8_t> &output) const;
-    void dump_i16vec2(std::vector<uint8_t> &out) const;
-    void dump_i16vec3(std::vector<uint8_t> &out) const;
-    void dump_i16vec4(std::vector<uint8_t> &out) const;
-    void dump_u16vec2(std::vector<uint8_t> &out) const;
-    void dump_u8vec4(std::vector<uint8_t> &out) const;
+    // The first byte of the first element. Throws unless every element lies
+    // within the buffer view.
+    const uint8_t *elements() const;
+
+    // T must have the component type and count of the accessor
+    template <typename T> accessor_view<T> view() const
+    {
+        if (component_type != component_traits<T>::type ||
+            (size_t)type != component_traits<T>::count)
+            throw exception::parse_error("Accessor " + name +
+                                         " does not hold the type viewed");
+        return accessor_view<T>(elements(), stride, count);
+    }
+
+    // Each writes length converted elements from first, one every out_stride
+    // bytes of out
+    void dump_uint32(uint8_t *out,
+                     size_t out_stride,
+                     size_t first,
+                     size_t length) const;
+    void dump_uint16(uint8_t *out,
+                     size_t out_stride,
+                     size_t first,
+                     size_t length) const;
+    void dump_fvec3(uint8_t *out,
+                    size_t out_stride,
+                    size_t first,
+                    size_t length) const;
+    void dump_fvec2(uint8_t *out,
+                    size_t out_stride,
+                    size_t first,
+                    size_t length) const;
+    void dump_i16vec2(uint8_t *out,
+                      size_t out_stride,
+                      size_t first,
+                      size_t length) const;
+    void dump_i16vec3(uint8_t *out,
+                      size_t out_stride,
+                      size_t first,
+                      size_t length) const;
+    void dump_i16vec4(uint8_t *out,
+                      size_t out_stride,
+                      size_t first,
+                      size_t length) const;
+    void dump_u16vec2(uint8_t *out,
+                      size_t out_stride,
+                      size_t first,
+                      size_t length) const;
+    void dump_u8vec4(uint8_t *out,
+                     size_t out_stride,
+                     size_t first,
+                     size_t length) const;
+    void dump(uint8_t *out,
+              size_t out_stride,
+              size_t first,
+              size_t length,
+              enum component_type target_component_type,
+              attribute_type target_attribute_type) const;
+    // Appends the elements to out, tightly packed
     void dump(std::vector<uint8_t> &out,
               enum component_type target_component_type,
               attribute_type target_attribute_type) const;
@@ -182,9 +321,11 @@ class image
     std::string mime_type;
     std::string uri;
     engine::image::rgba32 contents;
-    image(const json::object &root,
-          const gltf &gltf,
-          engine::filesystem::cache_binary &cache);
+    image(const json::lazy &root, const gltf &gltf);
+
+    // Fills contents. Kept out of the constructor so the images of a file
+    // can be decoded at the same time.
+    void decode(engine::filesystem::cache_binary &cache);
 };
 
 enum class mag_filter : uint16_t
@@ -216,7 +357,7 @@ class sampler
     enum wrap_mode wrap_s;
     enum wrap_mode wrap_t;
     std::string name;
-    sampler(const json::object &root);
+    sampler(const json::lazy &root);
 };
 
 class texture
@@ -225,7 +366,7 @@ class texture
     std::string name;
     const class image &source;
     const class sampler &sampler;
-    texture(const json::object &root, const gltf &gltf);
+    texture(const json::lazy &root, const gltf &gltf);
 };
 
 class texture_info
@@ -233,7 +374,7 @@ class texture_info
   public:
     const class texture &texture;
     offset tex_coord;
-    texture_info(const json::object &root, const gltf &gltf);
+    texture_info(const json::lazy &root, const gltf &gltf);
 };
 
 class pbr_metallic_roughness
@@ -244,7 +385,7 @@ class pbr_metallic_roughness
     std::optional<texture_info> metallic_roughness_texture;
     float metallic_factor;
     float roughness_factor;
-    pbr_metallic_roughness(const json::object &root, const gltf &gltf);
+    pbr_metallic_roughness(const json::lazy &root, const gltf &gltf);
 };
 
 class material
@@ -260,13 +401,13 @@ class material
     {
       public:
         float strength;
-        occlusion_texture_info(const json::object &root, const gltf &gltf);
+        occlusion_texture_info(const json::lazy &root, const gltf &gltf);
     };
     class normal_texture_info : public texture_info
     {
       public:
         float scale;
-        normal_texture_info(const json::object &root, const gltf &gltf);
+        normal_texture_info(const json::lazy &root, const gltf &gltf);
     };
 
     std::string name;
@@ -279,7 +420,7 @@ class material
     alpha_mode alpha_mode;
     bool double_sided;
 
-    material(const json::object &root, const gltf &gltf);
+    material(const json::lazy &root, const gltf &gltf);
 };
 
 class mesh_primitive
@@ -291,7 +432,7 @@ class mesh_primitive
         const accessor *position;
         const accessor *normal;
         const accessor *tangent;
-        target(const json::object &root, const gltf &gltf);
+        target(const json::lazy &root, const gltf &gltf);
     };
 
     class attributes
@@ -305,7 +446,7 @@ class mesh_primitive
         const accessor *color_0;
         const accessor *joints;
         const accessor *weights;
-        attributes(const json::object &root, const gltf &gltf);
+        attributes(const json::lazy &root, const gltf &gltf);
     };
 
     enum class mode : uint8_t
@@ -324,14 +465,14 @@ class mesh_primitive
     mode mode;
     std::vector<target> targets;
     const ::gltf::material *material = NULL;
-    mesh_primitive(const json::object &root, const gltf &gltf);
+    mesh_primitive(const json::lazy &root, const gltf &gltf);
 };
 class mesh
 {
   public:
     std::string name;
     std::vector<mesh_primitive> primitives;
-    mesh(const json::object &root, const gltf &gltf);
+    mesh(const json::lazy &root, const gltf &gltf);
 };
 class skin;
 class node
@@ -343,7 +484,7 @@ class node
     std::vector<const node *> children;
     const class mesh *mesh = NULL;
     const node *parent = NULL;
-    node(const json::object &root, const gltf &gltf);
+    node(const json::lazy &root, const gltf &gltf);
     node() {};
 };
 class skin
@@ -353,7 +494,7 @@ class skin
     const accessor *inverse_bind_matrices;
     const node *skeleton;
     std::vector<const node *> joints;
-    skin(const json::object &root, const gltf &gltf);
+    skin(const json::lazy &root, const gltf &gltf);
 };
 
 class glb
@@ -373,7 +514,7 @@ class scene
   public:
     std::string name;
     std::vector<const node *> nodes;
-    scene(const json::object &root, const gltf &gltf);
+    scene(const json::lazy &root, const gltf &gltf);
 };
 
 enum class animation_channel_path : uint8_t
@@ -396,7 +537,7 @@ class animation_sampler
     const accessor &input;
     const accessor &output;
     enum animation_sampler_interpolation interpolation;
-    animation_sampler(const json::object &root, const gltf &gltf);
+    animation_sampler(const json::lazy &root, const gltf &gltf);
 };
 
 class animation_channel_target
@@ -404,7 +545,7 @@ class animation_channel_target
   public:
     const class node *node = NULL;
     enum animation_channel_path path;
-    animation_channel_target(const json::object &root, const gltf &gltf);
+    animation_channel_target(const json::lazy &root, const gltf &gltf);
 };
 
 class animation_channel
@@ -412,7 +553,7 @@ class animation_channel
   public:
     const animation_channel_target target;
     const animation_sampler &sampler;
-    animation_channel(const json::object &root,
+    animation_channel(const json::lazy &root,
                       const gltf &gltf,
                       const std::vector<animation_sampler> &samplers);
 };
@@ -445,7 +586,7 @@ class animation
                 "Animation sampler not part of animation");
         return result;
     }
-    animation(const json::object &root, const gltf &gltf);
+    animation(const json::lazy &root, const gltf &gltf);
 };
 
 class gltf
@@ -544,12 +685,14 @@ class gltf
         return animations[index];
     }
 
+    // Images are decoded on pool while the rest of the file is read
     gltf(const std::string &_path,
          engine::filesystem::cache_binary &_fs_bin,
-         engine::image::cache::rgba32 &_fs_img);
+         engine::image::cache::rgba32 &_fs_img,
+         engine::filesystem::pool &pool = engine::filesystem::pool::shared());
 };
 
-class gltf_cache
+class gltf_cache_base
     : public engine::filesystem::cache<gltf,
                                        engine::filesystem::cache_binary &,
                                        engine::image::cache::rgba32 &>
@@ -562,7 +705,7 @@ class gltf_cache
                    const std::string &path_abs,
                    std::filesystem::file_time_type mtime) override
     {
-        return std::make_shared<gltf_cache::file>(path_rel, mtime, fs_bin, fs_img);
+        return std::make_shared<file>(path_rel, mtime, fs_bin, fs_img);
     }
 
     std::filesystem::file_time_type get_mtime(const std::string &path) override
@@ -570,10 +713,20 @@ class gltf_cache
         return std::filesystem::last_write_time(path);
     }
 
+    // Buffers alias the GLB held by fs_bin, so only decoded images count
+    size_t measure(const gltf &contents) override
+    {
+        size_t size = sizeof(gltf);
+        for (const image &image : contents.images)
+            size += (size_t)image.contents.width * image.contents.height *
+                    sizeof(engine::image::rgba32::pixel);
+        return size;
+    }
+
   public:
-    gltf_cache(class engine::filesystem::whitelist &wl,
-               engine::filesystem::cache_binary &_fs_bin,
-               engine::image::cache::rgba32 &_fs_img)
+    gltf_cache_base(class engine::filesystem::whitelist &wl,
+                    engine::filesystem::cache_binary &_fs_bin,
+                    engine::image::cache::rgba32 &_fs_img)
         : engine::filesystem::cache<gltf,
                                     engine::filesystem::cache_binary &,
                                     engine::image::cache::rgba32 &>(wl),
@@ -581,4 +734,5 @@ class gltf_cache
     {
     }
 };
+using gltf_cache = engine::filesystem::drained<gltf_cache_base>;
 }; // namespace gltf
\ No newline at end of file
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cmath>
 #include <engine/filesystem.hpp>
 #include <engine/gltf.hpp>
 #include <iostream>
+#include <type_traits>
 
 namespace gltf
 {
@@ -80,12 +82,12 @@ static class gltf::glb parse_glb(const engine::memory::const_view input)
         engine::memory::const_view{toc.bin->data, toc.bin->length});
 }
 
-gltf::asset::asset(const json::object &root)
+gltf::asset::asset(const json::lazy &root)
 {
-    version = root.at("version");
-    json::object::const_iterator generator_it = root.find("generator");
-    if (generator_it != root.end())
-        generator = generator_it->second;
+    version = root.at("version").as_string();
+    json::lazy generator_it = root.find("generator");
+    if (generator_it)
+        generator = generator_it.as_string();
 
     std::cout << "GLTF Asset version: " << version << "\n";
     std::cout << "GLTF Asset generator: " << generator << "\n";
@@ -93,53 +95,56 @@ gltf::asset::asset(const json::object &root)
 
 gltf::asset::asset() : version(""), generator("") {}
 
-static std::string get_string(const json::object &root,
-                              const std::string &key,
+static std::string get_string(const json::lazy &root,
+                              std::string_view key,
                               const std::string &default_value)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return (std::string)it->second;
+    json::lazy it = root.find(key);
+    if (it)
+        return std::string(it.as_string());
     return default_value;
 }
 
-static std::string get_string(const json::object &root, const std::string &key)
+static std::string get_string(const json::lazy &root,
+                              std::string_view key)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return (std::string)it->second;
+    json::lazy it = root.find(key);
+    if (it)
+        return std::string(it.as_string());
     return "";
 }
 
-static bool
-get_bool(const json::object &root, const std::string &key, bool default_value)
+static bool get_bool(const json::lazy &root,
+                     std::string_view key,
+                     bool default_value)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return it->second.as_bool();
+    json::lazy it = root.find(key);
+    if (it)
+        return it.as_bool();
     return default_value;
 }
 
-static gltf::offset get_offset(const json::object &root,
-                               const std::string &key,
+static gltf::offset get_offset(const json::lazy &root,
+                               std::string_view key,
                                gltf::offset default_value)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return (gltf::offset)it->second.strict_int();
+    json::lazy it = root.find(key);
+    if (it)
+        return (gltf::offset)it.strict_int();
     return default_value;
 }
 
-static float
-get_float(const json::object &root, const std::string &key, float default_value)
+static float get_float(const json::lazy &root,
+                       std::string_view key,
+                       float default_value)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return (float)it->second.as_float();
+    json::lazy it = root.find(key);
+    if (it)
+        return (float)it.as_float();
     return default_value;
 }
 
-static vec::fvec4 array_to_fvec4(const json::array &array)
+static vec::fvec4 array_to_fvec4(const json::lazy &array)
 {
     if (array.size() != 4)
         throw gltf::exception::parse_error("Not a vec4");
@@ -150,17 +155,17 @@ static vec::fvec4 array_to_fvec4(const json::array &array)
                       array[3].as_float());
 }
 
-static vec::fvec4 get_fvec4(const json::object &root,
-                            const std::string &key,
+static vec::fvec4 get_fvec4(const json::lazy &root,
+                            std::string_view key,
                             const vec::fvec4 &default_value)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return array_to_fvec4(it->second);
+    json::lazy it = root.find(key);
+    if (it)
+        return array_to_fvec4(it);
     return default_value;
 }
 
-static vec::fvec3 array_to_fvec3(const json::array &array)
+static vec::fvec3 array_to_fvec3(const json::lazy &array)
 {
     if (array.size() != 3)
         throw gltf::exception::parse_error("Not a vec3");
@@ -170,45 +175,49 @@ static vec::fvec3 array_to_fvec3(const json::array &array)
                       array[2].as_float());
 }
 
-static vec::fvec3 get_fvec3(const json::object &root,
-                            const std::string &key,
+static vec::fvec3 get_fvec3(const json::lazy &root,
+                            std::string_view key,
                             const vec::fvec3 &default_value)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return array_to_fvec3(it->second);
+    json::lazy it = root.find(key);
+    if (it)
+        return array_to_fvec3(it);
     return default_value;
 }
 
-gltf::buffer::buffer(const json::object &root, const glb &glb)
+gltf::buffer::buffer(
+    const json::lazy &root,
+    const glb &glb,
+    const engine::filesystem::cache_binary::reference &glb_source)
     : name(get_string(root, "name")), uri(get_string(root, "uri"))
 {
     if (uri.empty())
     {
-        json::object::const_iterator byte_length_it = root.find("byteLength");
-        if (byte_length_it == root.end())
+        json::lazy byte_length_it = root.find("byteLength");
+        if (!byte_length_it)
             throw ::gltf::exception::parse_error(
                 "Buffer missing byteLength and uri");
 
-        const ::gltf::offset byte_length = byte_length_it->second.strict_int();
+        const ::gltf::offset byte_length = byte_length_it.strict_int();
         if (byte_length > glb.bin.size())
             throw ::gltf::exception::parse_error(
                 "Buffer byteLength exceeds GLB BIN chunk size");
 
-        contents = engine::memory::allocation(glb.bin.begin,
+        contents = engine::memory::const_view(glb.bin.begin,
                                               glb.bin.begin + byte_length);
+        source = glb_source;
     }
 }
 
-gltf::buffer_view::buffer_view(const json::object &root, const gltf &gltf)
+gltf::buffer_view::buffer_view(const json::lazy &root, const gltf &gltf)
     : buffer(gltf.get_buffer(root.at("buffer").strict_int())),
       byte_offset(get_offset(root, "byteOffset", 0)),
       byte_length(root.at("byteLength").strict_int()),
       byte_stride(get_offset(root, "byteStride", 0))
 {
-    json::object::const_iterator it = root.find("target");
-    if (it != root.end())
-        target = (enum buffer_view_target)it->second.strict_int();
+    json::lazy it = root.find("target");
+    if (it)
+        target = (enum buffer_view_target)it.strict_int();
     else
         target = buffer_view_target::UNSET;
 }
@@ -247,7 +256,7 @@ static gltf::attribute_type parse_attribute_type(const std::string &name)
     throw gltf::exception::parse_error("Invalid attribute type: " + name);
 }
 
-gltf::accessor_sparse_indices::accessor_sparse_indices(const json::object &root,
+gltf::accessor_sparse_indices::accessor_sparse_indices(const json::lazy &root,
                                                        const gltf &gltf)
     : buffer_view(gltf.get_buffer_view(root.at("bufferView").strict_int())),
       byte_offset(get_offset(root, "byteOffset", 0)),
@@ -255,14 +264,14 @@ gltf::accessor_sparse_indices::accessor_sparse_indices(const json::object &root,
 {
 }
 
-gltf::accessor_sparse_values::accessor_sparse_values(const json::object &root,
+gltf::accessor_sparse_values::accessor_sparse_values(const json::lazy &root,
                                                      const gltf &gltf)
     : buffer_view(gltf.get_buffer_view(root.at("bufferView").strict_int())),
       byte_offset(get_offset(root, "byteOffset", 0))
 {
 }
 
-gltf::accessor_sparse::accessor_sparse(const json::object &root,
+gltf::accessor_sparse::accessor_sparse(const json::lazy &root,
                                        const gltf &gltf)
     : count(root.at("count").strict_int()),
       indices(accessor_sparse_indices(root.at("indices"), gltf)),
@@ -270,16 +279,16 @@ gltf::accessor_sparse::accessor_sparse(const json::object &root,
 {
 }
 
-static gltf::mag_filter get_mag_filter(const json::object &root,
-                                       const std::string &key,
+static gltf::mag_filter get_mag_filter(const json::lazy &root,
+                                       std::string_view key,
                                        gltf::mag_filter default_value)
 {
-    json::object::const_iterator it = root.find(key);
+    json::lazy it = root.find(key);
 
-    if (it == root.end())
+    if (!it)
         return default_value;
 
-    gltf::mag_filter result = (gltf::mag_filter)it->second.strict_int();
+    gltf::mag_filter result = (gltf::mag_filter)it.strict_int();
 
     switch (result)
     {
@@ -291,16 +300,16 @@ static gltf::mag_filter get_mag_filter(const json::object &root,
     }
 }
 
-static gltf::min_filter get_min_filter(const json::object &root,
-                                       const std::string &key,
+static gltf::min_filter get_min_filter(const json::lazy &root,
+                                       std::string_view key,
                                        gltf::min_filter default_value)
 {
-    json::object::const_iterator it = root.find(key);
+    json::lazy it = root.find(key);
 
-    if (it == root.end())
+    if (!it)
         return default_value;
 
-    gltf::min_filter result = (gltf::min_filter)it->second.strict_int();
+    gltf::min_filter result = (gltf::min_filter)it.strict_int();
 
     switch (result)
     {
@@ -316,16 +325,16 @@ static gltf::min_filter get_min_filter(const json::object &root,
     }
 }
 
-static gltf::wrap_mode get_wrap_mode(const json::object &root,
-                                     const std::string &key,
+static gltf::wrap_mode get_wrap_mode(const json::lazy &root,
+                                     std::string_view key,
                                      gltf::wrap_mode default_value)
 {
-    json::object::const_iterator it = root.find(key);
+    json::lazy it = root.find(key);
 
-    if (it == root.end())
+    if (!it)
         return default_value;
 
-    gltf::wrap_mode result = (gltf::wrap_mode)it->second.strict_int();
+    gltf::wrap_mode result = (gltf::wrap_mode)it.strict_int();
 
     switch (result)
     {
@@ -338,7 +347,7 @@ static gltf::wrap_mode get_wrap_mode(const json::object &root,
     }
 }
 
-gltf::sampler::sampler(const json::object &root)
+gltf::sampler::sampler(const json::lazy &root)
     : mag_filter(get_mag_filter(root, "magFilter", ::gltf::mag_filter::LINEAR)),
       min_filter(get_min_filter(root,
                                 "minFilter",
@@ -350,49 +359,41 @@ gltf::sampler::sampler(const json::object &root)
 }
 
 const class ::gltf::buffer_view *
-get_optional_buffer_view(const json::object &root,
-                         const std::string &key,
+get_optional_buffer_view(const json::lazy &root,
+                         std::string_view key,
                          const ::gltf::gltf &gltf)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return &gltf.get_buffer_view(it->second.strict_int());
+    json::lazy it = root.find(key);
+    if (it)
+        return &gltf.get_buffer_view(it.strict_int());
     return nullptr;
 }
 
-static engine::image::rgba32 get_image(const std::string &uri,
-                                       const ::gltf::buffer_view *buffer_view,
-                                       const ::gltf::gltf &gltf,
-                                       engine::filesystem::cache_binary &cache)
+::gltf::image::image(const json::lazy &root, const gltf &gltf)
+    : name(get_string(root, "name")),
+      buffer_view(get_optional_buffer_view(root, "bufferView", gltf)),
+      mime_type(get_string(root, "mimeType")), uri(get_string(root, "uri"))
+{
+    if (!buffer_view && uri.empty())
+        throw ::gltf::exception::parse_error(
+            "Image must have either bufferView or uri");
+}
+
+void ::gltf::image::decode(engine::filesystem::cache_binary &cache)
 {
     if (buffer_view)
     {
-        return buffer_view->get_image();
-    }
-    else if (!uri.empty())
-    {
-        engine::filesystem::cache_binary::reference ref = cache[uri];
-        const engine::filesystem::allocation &allocation = *ref;
-        return engine::image::rgba32(allocation);
+        contents = buffer_view->get_image();
     }
     else
     {
-        throw gltf::exception::parse_error(
-            "Image must have either bufferView or uri");
+        engine::filesystem::cache_binary::reference ref = cache[uri];
+        const engine::filesystem::mapping &mapping = *ref;
+        contents = engine::image::rgba32(mapping);
     }
 }
 
-::gltf::image::image(const json::object &root,
-                     const gltf &gltf,
-                     engine::filesystem::cache_binary &cache)
-    : name(get_string(root, "name")),
-      buffer_view(get_optional_buffer_view(root, "bufferView", gltf)),
-      mime_type(get_string(root, "mimeType")), uri(get_string(root, "uri")),
-      contents(get_image(uri, buffer_view, gltf, cache))
-{
-}
-
-gltf::texture::texture(const json::object &root, const gltf &gltf)
+gltf::texture::texture(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name")),
       source(gltf.get_image(root.at("source").strict_int())),
       sampler(gltf.get_sampler(root.at("sampler").strict_int()))
@@ -401,24 +402,24 @@ gltf::texture::texture(const json::object &root, const gltf &gltf)
         name = source.name;
 }
 
-gltf::texture_info::texture_info(const json::object &root, const gltf &gltf)
+gltf::texture_info::texture_info(const json::lazy &root, const gltf &gltf)
     : texture(gltf.get_texture(root.at("index").strict_int())),
       tex_coord(get_offset(root, "texCoord", 0))
 {
 }
 
 static std::optional<gltf::texture_info>
-get_optional_texture_info(const json::object &root,
-                          const std::string &key,
+get_optional_texture_info(const json::lazy &root,
+                          std::string_view key,
                           const gltf::gltf &gltf)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return gltf::texture_info(it->second, gltf);
+    json::lazy it = root.find(key);
+    if (it)
+        return gltf::texture_info(it, gltf);
     return std::nullopt;
 }
 
-gltf::pbr_metallic_roughness::pbr_metallic_roughness(const json::object &root,
+gltf::pbr_metallic_roughness::pbr_metallic_roughness(const json::lazy &root,
                                                      const gltf &gltf)
     : base_color_factor(
           get_fvec4(root, "baseColorFactor", vec::fvec4(1, 1, 1, 1))),
@@ -442,7 +443,7 @@ static enum gltf::material::alpha_mode parse_alpha_mode(const std::string &name)
     throw gltf::exception::parse_error("Invalid alpha mode: " + name);
 }
 
-gltf::material::material(const json::object &root, const gltf &gltf)
+gltf::material::material(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name")),
       emissive_factor(get_fvec3(root, "emissiveFactor", vec::fvec3(0, 0, 0))),
       alpha_cutoff(get_float(root, "alphaCutoff", 0.5f)),
@@ -453,48 +454,45 @@ gltf::material::material(const json::object &root, const gltf &gltf)
     using occlusion_t = class ::gltf::material::occlusion_texture_info;
     using normal_t = class ::gltf::material::normal_texture_info;
 
-    json::object::const_iterator _pbr_metallic_roughness =
-        root.find("pbrMetallicRoughness");
+    json::lazy _pbr_metallic_roughness = root.find("pbrMetallicRoughness");
 
-    if (_pbr_metallic_roughness != root.end())
+    if (_pbr_metallic_roughness)
         pbr_metallic_roughness.emplace(
-            pbr_metallic_roughness_t(_pbr_metallic_roughness->second, gltf));
+            pbr_metallic_roughness_t(_pbr_metallic_roughness, gltf));
 
-    json::object::const_iterator _occlusion_texture =
-        root.find("occlusionTexture");
+    json::lazy _occlusion_texture = root.find("occlusionTexture");
 
-    if (_occlusion_texture != root.end())
+    if (_occlusion_texture)
         occlusion_texture.emplace(
-            occlusion_t(_occlusion_texture->second, gltf));
+            occlusion_t(_occlusion_texture, gltf));
 
-    json::object::const_iterator _normal_texture = root.find("normalTexture");
-    if (_normal_texture != root.end())
-        normal_texture.emplace(normal_t(_normal_texture->second, gltf));
+    json::lazy _normal_texture = root.find("normalTexture");
+    if (_normal_texture)
+        normal_texture.emplace(normal_t(_normal_texture, gltf));
 
-    json::object::const_iterator _emissive_texture =
-        root.find("emissiveTexture");
-    if (_emissive_texture != root.end())
-        emissive_texture.emplace(texture_info(_emissive_texture->second, gltf));
+    json::lazy _emissive_texture = root.find("emissiveTexture");
+    if (_emissive_texture)
+        emissive_texture.emplace(texture_info(_emissive_texture, gltf));
 }
 
-static const gltf::accessor *get_optional_accessor(const json::object &root,
-                                                   const std::string &key,
+static const gltf::accessor *get_optional_accessor(const json::lazy &root,
+                                                   std::string_view key,
                                                    const gltf::gltf &gltf)
 {
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-        return &gltf.get_accessor(it->second.strict_int());
+    json::lazy it = root.find(key);
+    if (it)
+        return &gltf.get_accessor(it.strict_int());
     return nullptr;
 }
 
-gltf::mesh_primitive::target::target(const json::object &root, const gltf &gltf)
+gltf::mesh_primitive::target::target(const json::lazy &root, const gltf &gltf)
     : position(get_optional_accessor(root, "POSITION", gltf)),
       normal(get_optional_accessor(root, "NORMAL", gltf)),
       tangent(get_optional_accessor(root, "TANGENT", gltf))
 {
 }
 
-gltf::mesh_primitive::attributes::attributes(const json::object &root,
+gltf::mesh_primitive::attributes::attributes(const json::lazy &root,
                                              const gltf &gltf)
     : position(get_optional_accessor(root, "POSITION", gltf)),
       normal(get_optional_accessor(root, "NORMAL", gltf)),
@@ -508,17 +506,17 @@ gltf::mesh_primitive::attributes::attributes(const json::object &root,
 }
 
 static enum gltf::mesh_primitive::mode
-get_mode(const json::object &root,
-         const std::string &key,
+get_mode(const json::lazy &root,
+         std::string_view key,
          enum gltf::mesh_primitive::mode default_value)
 {
-    json::object::const_iterator it = root.find(key);
+    json::lazy it = root.find(key);
 
-    if (it == root.end())
+    if (!it)
         return default_value;
 
     enum gltf::mesh_primitive::mode result =
-        (enum gltf::mesh_primitive::mode)it->second.strict_int();
+        (enum gltf::mesh_primitive::mode)it.strict_int();
 
     switch (result)
     {
@@ -536,78 +534,78 @@ get_mode(const json::object &root,
 }
 
 using attributes_t = class gltf::mesh_primitive::attributes;
-gltf::mesh_primitive::mesh_primitive(const json::object &root, const gltf &gltf)
+gltf::mesh_primitive::mesh_primitive(const json::lazy &root, const gltf &gltf)
     : attributes(attributes_t(root.at("attributes"), gltf)),
       mode(get_mode(root, "mode", ::gltf::mesh_primitive::mode::TRIANGLES))
 {
-    json::object::const_iterator indices_it = root.find("indices");
+    json::lazy indices_it = root.find("indices");
 
-    if (indices_it != root.end())
-        indices = &gltf.get_accessor(indices_it->second.strict_int());
+    if (indices_it)
+        indices = &gltf.get_accessor(indices_it.strict_int());
 
-    json::object::const_iterator targets_it = root.find("targets");
+    json::lazy targets_it = root.find("targets");
 
-    if (targets_it != root.end())
+    if (targets_it)
     {
-        const json::array &targets_array = targets_it->second;
+        const json::lazy targets_array = targets_it;
 
-        for (const json::object &target : targets_array)
+        for (const json::lazy &target : targets_array)
             targets.push_back(::gltf::mesh_primitive::target(target, gltf));
     }
 
-    json::object::const_iterator it = root.find("material");
-    if (it != root.end())
-        material = &gltf.get_material(it->second.strict_int());
+    json::lazy it = root.find("material");
+    if (it)
+        material = &gltf.get_material(it.strict_int());
 }
 
-gltf::mesh::mesh(const json::object &root, const gltf &gltf)
+gltf::mesh::mesh(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name"))
 {
-    json::object::const_iterator primitives_it = root.find("primitives");
-    if (primitives_it != root.end())
+    json::lazy primitives_it = root.find("primitives");
+    if (primitives_it)
     {
-        const json::array &primitives_array = primitives_it->second;
+        const json::lazy primitives_array = primitives_it;
 
-        for (const json::object &primitive : primitives_array)
+        for (const json::lazy &primitive : primitives_array)
             primitives.push_back(::gltf::mesh_primitive(primitive, gltf));
     }
 }
 
 ::gltf::material::occlusion_texture_info::occlusion_texture_info(
-    const json::object &root,
+    const json::lazy &root,
     const gltf &gltf)
     : texture_info(root, gltf), strength(get_float(root, "strength", 1.0f))
 {
 }
 
 ::gltf::material::normal_texture_info::normal_texture_info(
-    const json::object &root,
+    const json::lazy &root,
     const gltf &gltf)
     : texture_info(root, gltf), scale(get_float(root, "scale", 1.0f))
 {
 }
 
-gltf::node::node(const json::object &root, const gltf &gltf)
+gltf::node::node(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name")),
       transform(
           vec::transform3(get_fvec3(root, "translation", vec::fvec3(0, 0, 0)),
                           get_fvec4(root, "rotation", vec::fvec4(0, 0, 0, 1)),
                           get_fvec3(root, "scale", vec::fvec3(1, 1, 1))))
 {
-    json::object::const_iterator skin_it = root.find("skin");
-    if (skin_it != root.end())
-        skin = &gltf.get_skin(skin_it->second.strict_int());
+    json::lazy skin_it = root.find("skin");
+    if (skin_it)
+        skin = &gltf.get_skin(skin_it.strict_int());
 
-    json::object::const_iterator mesh_it = root.find("mesh");
-    if (mesh_it != root.end())
-        mesh = &gltf.get_mesh(mesh_it->second.strict_int());
+    json::lazy mesh_it = root.find("mesh");
+    if (mesh_it)
+        mesh = &gltf.get_mesh(mesh_it.strict_int());
 
-    json::object::const_iterator children_it = root.find("children");
-    if (children_it != root.end())
+    json::lazy children_it = root.find("children");
+    if (children_it)
     {
-        const json::array &children_array = children_it->second;
+        const json::lazy children_array = children_it;
 
-        for (const json::value &child : children_array)
+        for (const json::lazy &child : children_array)
             children.push_back(&gltf.get_node(child.strict_int()));
     }
 }
@@ -639,7 +637,7 @@ static size_t get_component_size(enum gltf::component_type component_type)
     }
 }
 
-::gltf::accessor::accessor(const json::object &root, const gltf &gltf)
+::gltf::accessor::accessor(const json::lazy &root, const gltf &gltf)
     : buffer_view(gltf.get_buffer_view(root.at("bufferView").strict_int())),
       byte_offset(get_offset(root, "byteOffset", 0)),
       component_type(
@@ -666,37 +664,25 @@ static size_t get_component_size(enum gltf::component_type component_type)
             std::to_string(static_cast<uint16_t>(component_type)));
     }
 
-    json::object::const_iterator sparse_it = root.find("sparse");
-    if (sparse_it != root.end())
+    json::lazy sparse_it = root.find("sparse");
+    if (sparse_it)
         sparse = std::unique_ptr<accessor_sparse>(
-            new accessor_sparse(sparse_it->second, gltf));
+            new accessor_sparse(sparse_it, gltf));
 }
 
-::gltf::scene::scene(const json::object &root, const gltf &gltf)
+::gltf::scene::scene(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name"))
 {
-    json::object::const_iterator nodes_it = root.find("nodes");
-    if (nodes_it != root.end())
+    json::lazy nodes_it = root.find("nodes");
+    if (nodes_it)
     {
-        const json::array &nodes_array = nodes_it->second;
+        const json::lazy nodes_array = nodes_it;
 
-        for (const json::value &node : nodes_array)
+        for (const json::lazy &node : nodes_array)
             nodes.push_back(&gltf.get_node(node.strict_int()));
     }
 }
 
-static const json::array *get_optional_array(const json::object &root,
-                                             const std::string &key)
-{
-    json::object::const_iterator it = root.find(key);
-    if (it != root.end())
-    {
-        const json::array &array = it->second;
-        return &array;
-    }
-    return nullptr;
-}
-
 enum gltf::animation_sampler_interpolation
 parse_animation_sampler_interpolation(const std::string &name)
 {
@@ -710,7 +696,7 @@ parse_animation_sampler_interpolation(const std::string &name)
         "Invalid animation sampler interpolation: " + name);
 }
 
-::gltf::animation_sampler::animation_sampler(const json::object &root,
+::gltf::animation_sampler::animation_sampler(const json::lazy &root,
                                              const gltf &gltf)
     : input(gltf.get_accessor(root.at("input").strict_int())),
       output(gltf.get_accessor(root.at("output").strict_int())),
@@ -733,17 +719,17 @@ parse_animation_channel_path(const std::string &name)
 }
 
 ::gltf::animation_channel_target::animation_channel_target(
-    const json::object &root,
+    const json::lazy &root,
     const gltf &gltf)
     : path(parse_animation_channel_path(get_string(root, "path")))
 {
-    json::object::const_iterator node_it = root.find("node");
-    if (node_it != root.end())
-        node = &gltf.get_node(node_it->second.strict_int());
+    json::lazy node_it = root.find("node");
+    if (node_it)
+        node = &gltf.get_node(node_it.strict_int());
 }
 
 ::gltf::animation_channel::animation_channel(
-    const json::object &root,
+    const json::lazy &root,
     const gltf &gltf,
     const std::vector<animation_sampler> &samplers)
     : target(animation_channel_target(root.at("target"), gltf)),
@@ -751,313 +737,572 @@ parse_animation_channel_path(const std::string &name)
 {
 }
 
-::gltf::animation::animation(const json::object &root, const gltf &gltf)
+::gltf::animation::animation(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name"))
 {
-    json::object::const_iterator samplers_it = root.find("samplers");
-    if (samplers_it != root.end())
+    json::lazy samplers_it = root.find("samplers");
+    if (samplers_it)
     {
-        const json::array &samplers_array = samplers_it->second;
+        const json::lazy samplers_array = samplers_it;
 
         samplers.reserve(samplers_array.size());
 
-        for (const json::object &sampler : samplers_array)
+        for (const json::lazy &sampler : samplers_array)
             samplers.push_back(::gltf::animation_sampler(sampler, gltf));
     }
 
-    json::object::const_iterator channels_it = root.find("channels");
-    if (channels_it != root.end())
+    json::lazy channels_it = root.find("channels");
+    if (channels_it)
     {
-        const json::array &channels_array = channels_it->second;
+        const json::lazy channels_array = channels_it;
 
         channels.reserve(channels_array.size());
 
-        for (const json::object &channel : channels_array)
+        for (const json::lazy &channel : channels_array)
             channels.push_back(
                 ::gltf::animation_channel(channel, gltf, samplers));
     }
 }
 
-::gltf::skin::skin(const json::object &root, const gltf &gltf)
+::gltf::skin::skin(const json::lazy &root, const gltf &gltf)
     : name(get_string(root, "name"))
 {
-    json::object::const_iterator inverse_bind_matrices_it =
-        root.find("inverseBindMatrices");
-    if (inverse_bind_matrices_it != root.end())
+    json::lazy inverse_bind_matrices_it = root.find("inverseBindMatrices");
+    if (inverse_bind_matrices_it)
         inverse_bind_matrices =
-            &gltf.get_accessor(inverse_bind_matrices_it->second.strict_int());
+            &gltf.get_accessor(inverse_bind_matrices_it.strict_int());
 
-    json::object::const_iterator skeleton_it = root.find("skeleton");
-    if (skeleton_it != root.end())
-        skeleton = &gltf.get_node(skeleton_it->second.strict_int());
+    json::lazy skeleton_it = root.find("skeleton");
+    if (skeleton_it)
+        skeleton = &gltf.get_node(skeleton_it.strict_int());
 
-    const json::array &joints_array = root.at("joints");
-    for (const json::value &joint : joints_array)
+    const json::lazy joints_array = root.at("joints");
+    for (const json::lazy &joint : joints_array)
         joints.push_back(&gltf.get_node(joint.strict_int()));
 }
 
 ::gltf::gltf::gltf(const std::string &_path,
                    engine::filesystem::cache_binary &fs_bin,
-                   engine::image::cache::rgba32 &fs_img)
+                   engine::image::cache::rgba32 &fs_img,
+                   engine::filesystem::pool &pool)
 {
     const engine::filesystem::cache_binary::reference glb_ref = fs_bin[_path];
-    const engine::filesystem::allocation &glb_alloc = *glb_ref;
-    glb glb(parse_glb(glb_alloc));
-    json::object root(json::parse_memory(_path, glb.json));
-    this->asset = ::gltf::asset(root.at("asset"));
-
-    const json::array *_buffers = get_optional_array(root, "buffers");
-    const json::array *_buffer_views = get_optional_array(root, "bufferViews");
-    const json::array *_accessors = get_optional_array(root, "accessors");
-    const json::array *_images = get_optional_array(root, "images");
-    const json::array *_samplers = get_optional_array(root, "samplers");
-    const json::array *_textures = get_optional_array(root, "textures");
-    const json::array *_materials = get_optional_array(root, "materials");
-    const json::array *_meshes = get_optional_array(root, "meshes");
-    const json::array *_nodes = get_optional_array(root, "nodes");
-    const json::array *_skins = get_optional_array(root, "skins");
-    const json::array *_scenes = get_optional_array(root, "scenes");
-    const json::array *_animations = get_optional_array(root, "animations");
+    const engine::filesystem::mapping &glb_mapping = *glb_ref;
+    glb glb(parse_glb(glb_mapping));
+    const json::lazy::document document(_path, glb.json);
+    const json::lazy root = document.root();
+
+    json::lazy _asset;
+    json::lazy _buffers;
+    json::lazy _buffer_views;
+    json::lazy _accessors;
+    json::lazy _images;
+    json::lazy _samplers;
+    json::lazy _textures;
+    json::lazy _materials;
+    json::lazy _meshes;
+    json::lazy _nodes;
+    json::lazy _skins;
+    json::lazy _scenes;
+    json::lazy _animations;
+
+    const std::pair<std::string_view, json::lazy *> arrays[] = {
+        {"buffers", &_buffers},
+        {"bufferViews", &_buffer_views},
+        {"accessors", &_accessors},
+        {"images", &_images},
+        {"samplers", &_samplers},
+        {"textures", &_textures},
+        {"materials", &_materials},
+        {"meshes", &_meshes},
+        {"nodes", &_nodes},
+        {"skins", &_skins},
+        {"scenes", &_scenes},
+        {"animations", &_animations},
+    };
+
+    // One pass over the top level finds everything, rather than a scan of
+    // the document for each key
+    for (json::lazy::iterator it = root.begin(); it != root.end(); ++it)
+    {
+        if (it.key() == "asset")
+        {
+            if (!_asset)
+                _asset = *it;
+            continue;
+        }
+
+        for (const auto &[key, array] : arrays)
+            if (it.key() == key && !*array)
+            {
+                *array = *it;
+                if (array->type() != json::tape::type::array)
+                    throw array->error("Expected an array");
+                break;
+            }
+    }
+
+    if (!_asset)
+        throw root.error("Missing key 'asset'");
+    this->asset = ::gltf::asset(_asset);
 
     if (_buffers)
-        buffers.reserve(_buffers->size());
+        buffers.reserve(_buffers.size());
     if (_buffer_views)
-        buffer_views.reserve(_buffer_views->size());
+        buffer_views.reserve(_buffer_views.size());
     if (_accessors)
-        accessors.reserve(_accessors->size());
+        accessors.reserve(_accessors.size());
     if (_images)
-        images.reserve(_images->size());
+        images.reserve(_images.size());
     if (_samplers)
-        samplers.reserve(_samplers->size());
+        samplers.reserve(_samplers.size());
     if (_textures)
-        textures.reserve(_textures->size());
+        textures.reserve(_textures.size());
     if (_materials)
-        materials.reserve(_materials->size());
+        materials.reserve(_materials.size());
     if (_meshes)
-        meshes.reserve(_meshes->size());
+        meshes.reserve(_meshes.size());
     if (_nodes)
-        nodes.resize(_nodes->size());
+        nodes.resize(_nodes.size());
     if (_skins)
-        skins.reserve(_skins->size());
+        skins.reserve(_skins.size());
     if (_scenes)
-        scenes.reserve(_scenes->size());
+        scenes.reserve(_scenes.size());
     if (_animations)
-        animations.reserve(_animations->size());
+        animations.reserve(_animations.size());
 
     if (_buffers)
-        for (const json::object &buffer : *_buffers)
-            buffers.push_back(::gltf::buffer(buffer, glb));
+        for (const json::lazy &buffer : _buffers)
+            buffers.push_back(::gltf::buffer(buffer, glb, glb_ref));
 
     if (_buffer_views)
-        for (const json::object &buffer_view : *_buffer_views)
+        for (const json::lazy &buffer_view : _buffer_views)
             buffer_views.push_back(::gltf::buffer_view(buffer_view, *this));
 
     if (_accessors)
-        for (const json::object &accessor : *_accessors)
+        for (const json::lazy &accessor : _accessors)
             accessors.push_back(::gltf::accessor(accessor, *this));
 
     if (_images)
-        for (const json::object &image : *_images)
-            images.push_back(::gltf::image(image, *this, fs_bin));
+        for (const json::lazy &image : _images)
+            images.push_back(::gltf::image(image, *this));
+
+    // Textures and materials only refer to the images, so decoding runs
+    // alongside the sections after this
+    engine::filesystem::pool::batch decoding(
+        pool,
+        images.size(),
+        [this, &fs_bin](size_t index) { images[index].decode(fs_bin); });
 
     if (_samplers)
-        for (const json::object &sampler : *_samplers)
+        for (const json::lazy &sampler : _samplers)
             samplers.push_back(::gltf::sampler(sampler));
 
     if (_textures)
-        for (const json::object &texture : *_textures)
+        for (const json::lazy &texture : _textures)
             textures.push_back(::gltf::texture(texture, *this));
 
     if (_materials)
-        for (const json::object &material : *_materials)
+        for (const json::lazy &material : _materials)
             materials.push_back(::gltf::material(material, *this));
 
     if (_meshes)
-        for (const json::object &mesh : *_meshes)
+        for (const json::lazy &mesh : _meshes)
             meshes.push_back(::gltf::mesh(mesh, *this));
 
     if (_skins)
-        for (const json::object &skin : *_skins)
+        for (const json::lazy &skin : _skins)
             skins.push_back(::gltf::skin(skin, *this));
 
     if (_nodes)
-        for (size_t i = 0, size = _nodes->size(); i < size; i++)
-            nodes[i] = ::gltf::node((*_nodes)[i], *this);
+    {
+        size_t i = 0;
+        for (const json::lazy &node : _nodes)
+            nodes[i++] = ::gltf::node(node, *this);
+    }
 
     if (_scenes)
-        for (const json::object &scene : *_scenes)
+        for (const json::lazy &scene : _scenes)
             scenes.push_back(::gltf::scene(scene, *this));
 
     if (_animations)
-        for (const json::object &animation : *_animations)
+        for (const json::lazy &animation : _animations)
             animations.push_back(::gltf::animation(animation, *this));
+
+    decoding.wait();
 }
 
-float gltf::accessor::get_component_as_float(size_t attribute_index,
-                                             size_t component_index) const
+const uint8_t *gltf::accessor::elements() const
 {
-    const uint8_t *ptr = buffer_view.buffer.contents.data() +
-                         get_byte_offset(attribute_index, component_index);
+    const size_t size = count ? (count - 1) * stride + attribute_size : 0;
+    const size_t contents_size = buffer_view.buffer.contents.size();
 
-    if (component_type == component_type::FLOAT)
-        return *reinterpret_cast<const float *>(ptr);
+    if (byte_offset > buffer_view.byte_length ||
+        size > buffer_view.byte_length - byte_offset ||
+        buffer_view.byte_offset > contents_size ||
+        buffer_view.byte_length > contents_size - buffer_view.byte_offset)
+        throw exception::parse_error("Accessor " + name +
+                                     " is out of bounds of its buffer view");
 
-    if (!normalized)
-        throw exception::parse_error(
-            "Attempted to read non-normalized component as float");
+    return buffer_view.buffer.contents.data() + buffer_view.byte_offset +
+           byte_offset;
+}
 
-    switch (component_type)
-    {
-    case component_type::BYTE:
-        return std::fmax(
-            static_cast<float>(*reinterpret_cast<const int8_t *>(ptr)) / 127.0f,
-            -1.0f);
-    case component_type::UBYTE:
-        return static_cast<float>(*reinterpret_cast<const uint8_t *>(ptr)) /
-               255.0f;
-    case component_type::SHORT:
-        return std::fmax(
-            static_cast<float>(*reinterpret_cast<const int16_t *>(ptr)) /
-                32767.0f,
-            -1.0f);
-    case component_type::USHORT:
-        return static_cast<float>(*reinterpret_cast<const uint16_t *>(ptr)) /
-               65535.0f;
-    default:
-        throw exception::parse_error(
-            "Invalid component type for normalized conversion: " +
-            std::to_string(static_cast<uint16_t>(component_type)));
-    }
+// Normalized components read as floats, and floats as themselves
+static float float_from(float value)
+{
+    return value;
 }
 
-uint32_t gltf::accessor::get_component_as_index(size_t attribute_index,
-                                                size_t component_index) const
+static float float_from(int8_t value)
 {
-    if (normalized)
-        throw exception::parse_error(
-            "Attempted to read normalized component as an index");
+    return std::fmax(static_cast<float>(value) / 127.0f, -1.0f);
+}
 
-    const uint8_t *ptr = buffer_view.buffer.contents.data() +
-                         get_byte_offset(attribute_index, component_index);
+static float float_from(uint8_t value)
+{
+    return static_cast<float>(value) / 255.0f;
+}
 
-    switch (component_type)
-    {
-    case component_type::UBYTE:
-        return *reinterpret_cast<const uint8_t *>(ptr);
-    case component_type::USHORT:
-        return *reinterpret_cast<const uint16_t *>(ptr);
-    case component_type::UINT:
-        return *reinterpret_cast<const uint32_t *>(ptr);
-    default:
-        throw exception::parse_error(
-            "Invalid component type for index conversion: " +
-            std::to_string(static_cast<uint16_t>(component_type)));
-    }
+static float float_from(int16_t value)
+{
+    return std::fmax(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+static float float_from(uint16_t value)
+{
+    return static_cast<float>(value) / 65535.0f;
+}
+
+// std::round without the call, once truncated. Adding a half to a float is
+// exact in double, so this rounds every float as std::round does.
+static double round_half_away(float value)
+{
+    return value < 0 ? (double)value - 0.5 : (double)value + 0.5;
 }
 
 static int16_t i16_from_float(float value)
 {
-    return static_cast<int16_t>(std::round(value * 32767.0f));
+    return static_cast<int16_t>(round_half_away(value * 32767.0f));
 }
 
 static uint16_t u16_from_float(float value)
 {
-    return static_cast<uint16_t>(std::round(value * 65535.0f));
+    return static_cast<uint16_t>(round_half_away(value * 65535.0f));
 }
 
 static uint8_t u8_from_float(float value)
 {
-    return static_cast<uint8_t>(std::round(value * 255.0f));
+    return static_cast<uint8_t>(round_half_away(value * 255.0f));
 }
 
-::gltf::accessor::operator std::vector<float>() const
+// Conversions of one component to each target type. identity is set when a
+// source of the target type converts to itself, so it can be copied whole.
+namespace
 {
-    if (type != attribute_type::SCALAR)
-        throw exception::parse_error("Accessor type is not SCALAR, cannot "
-                                     "convert to std::vector<float>");
+struct to_float
+{
+    static constexpr bool identity = true;
+    template <typename S> static float convert(S value)
+    {
+        return float_from(value);
+    }
+};
 
-    std::vector<float> result;
-    result.reserve(count);
+// Normalized components of the target type convert to themselves, but for
+// the one short below -1
+struct to_i16
+{
+    static constexpr bool identity = false;
+    template <typename S> static int16_t convert(S value)
+    {
+        return i16_from_float(float_from(value));
+    }
+    static int16_t convert(int16_t value)
+    {
+        return value < -32767 ? -32767 : value;
+    }
+};
 
-    for (size_t i = 0; i < count; i++)
+struct to_u16
+{
+    static constexpr bool identity = true;
+    template <typename S> static uint16_t convert(S value)
     {
-        result.push_back(get_component_as_float(i, 0));
+        return u16_from_float(float_from(value));
     }
+    static uint16_t convert(uint16_t value)
+    {
+        return value;
+    }
+};
 
-    return result;
-}
+struct to_u8
+{
+    static constexpr bool identity = true;
+    template <typename S> static uint8_t convert(S value)
+    {
+        return u8_from_float(float_from(value));
+    }
+    static uint8_t convert(uint8_t value)
+    {
+        return value;
+    }
+};
 
-::gltf::accessor::operator std::vector<vec::fvec3>() const
+// Integer components that are not normalized read as the numbers they hold,
+// as KHR_mesh_quantization allows for positions and texture coordinates.
+// Only floats can hold them; the other targets are normalized.
+struct to_unnormalized_float
 {
-    if (type != attribute_type::VEC3)
-        throw exception::parse_error("Accessor type is not VEC3, cannot "
-                                     "convert to std::vector<vec::fvec3>");
+    static constexpr bool identity = false;
+    template <typename S> static float convert(S value)
+    {
+        return static_cast<float>(value);
+    }
+};
 
-    std::vector<vec::fvec3> result;
-    result.reserve(count);
+template <typename T> struct to_index
+{
+    static constexpr bool identity = true;
+    template <typename S> static T convert(S value)
+    {
+        return static_cast<T>(value);
+    }
+};
+} // namespace
+
+template <typename Source, typename Convert>
+static void convert_components(const uint8_t *input, size_t count, uint8_t *out)
+{
+    using Target = decltype(Convert::convert(Source()));
 
     for (size_t i = 0; i < count; i++)
     {
-        result.push_back(vec::fvec3(get_component_as_float(i, 0),
-                                    get_component_as_float(i, 1),
-                                    get_component_as_float(i, 2)));
+        Source value;
+        memcpy(&value, input + i * sizeof(Source), sizeof(Source));
+        const Target result = Convert::convert(value);
+        memcpy(out + i * sizeof(Target), &result, sizeof(Target));
     }
+}
 
-    return result;
+// Writes N converted components for each of length elements of accessor from
+// first, one element every out_stride bytes of out. Elements tightly packed on
+// both sides are converted as one run of components, or copied when nothing
+// changes.
+template <typename Source, typename Convert, size_t N>
+static void convert_elements(const gltf::accessor &accessor,
+                             size_t first,
+                             size_t length,
+                             uint8_t *out,
+                             size_t out_stride)
+{
+    using Target = decltype(Convert::convert(Source()));
+
+    const uint8_t *input = accessor.elements() + first * accessor.stride;
+    const size_t element_size = N * sizeof(Source);
+
+    if (accessor.stride == element_size && out_stride == N * sizeof(Target))
+    {
+        if constexpr (Convert::identity && std::is_same_v<Source, Target>)
+            memcpy(out, input, length * element_size);
+        else
+            convert_components<Source, Convert>(input, length * N, out);
+        return;
+    }
+
+    // Packed elements are converted a run at a time, then spread out
+    if (accessor.stride == element_size)
+    {
+        constexpr size_t run = 64;
+        Target converted[run * N];
+
+        for (size_t begin = 0; begin < length; begin += run)
+        {
+            const size_t elements = std::min(run, length - begin);
+            convert_components<Source, Convert>(input + begin * element_size,
+                                                elements * N,
+                                                (uint8_t *)converted);
+            for (size_t i = 0; i < elements; i++)
+                memcpy(out + (begin + i) * out_stride,
+                       converted + i * N,
+                       N * sizeof(Target));
+        }
+        return;
+    }
+
+    // Whole elements are loaded and stored at once
+    for (size_t i = 0; i < length; i++)
+    {
+        Source element[N];
+        Target result[N];
+        memcpy(element, input + i * accessor.stride, sizeof(element));
+        for (size_t c = 0; c < N; c++)
+            result[c] = Convert::convert(element[c]);
+        memcpy(out + i * out_stride, result, sizeof(result));
+    }
 }
 
-::gltf::accessor::operator std::vector<vec::fvec4>() const
+static bool in_range(const gltf::accessor &accessor,
+                     size_t first,
+                     size_t length)
 {
-    if (type != attribute_type::VEC4)
-        throw exception::parse_error("Accessor type is not VEC4, cannot "
-                                     "convert to std::vector<vec::fvec4>");
+    return first <= accessor.count && length <= accessor.count - first;
+}
 
-    std::vector<vec::fvec4> result;
-    result.reserve(count);
+template <typename Convert, size_t N>
+static void convert_numbers(const gltf::accessor &accessor,
+                            size_t first,
+                            size_t length,
+                            uint8_t *out,
+                            size_t out_stride)
+{
+    using gltf::component_type;
 
-    for (size_t i = 0; i < count; i++)
+    switch (accessor.component_type)
     {
-        result.push_back(vec::fvec4(get_component_as_float(i, 0),
-                                    get_component_as_float(i, 1),
-                                    get_component_as_float(i, 2),
-                                    get_component_as_float(i, 3)));
+    case component_type::FLOAT:
+        convert_elements<float, Convert, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    case component_type::BYTE:
+        convert_elements<int8_t, Convert, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    case component_type::UBYTE:
+        convert_elements<uint8_t, Convert, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    case component_type::SHORT:
+        convert_elements<int16_t, Convert, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    case component_type::USHORT:
+        convert_elements<uint16_t, Convert, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    default:
+        throw gltf::exception::parse_error(
+            "Invalid component type for float conversion: " +
+            std::to_string(static_cast<uint16_t>(accessor.component_type)));
     }
+}
 
-    return result;
+// Components read as floats are floats, normalized, or integers read as they
+// are when the target is a float too
+template <typename Convert, size_t N>
+static void convert_floats(const gltf::accessor &accessor,
+                           size_t first,
+                           size_t length,
+                           uint8_t *out,
+                           size_t out_stride)
+{
+    if (!in_range(accessor, first, length))
+        throw gltf::exception::parse_error(
+            "Range is out of bounds of accessor " + accessor.name);
+
+    if (!length)
+        return;
+
+    if (accessor.component_type == gltf::component_type::FLOAT ||
+        accessor.normalized)
+        convert_numbers<Convert, N>(accessor, first, length, out, out_stride);
+    else if constexpr (std::is_same_v<Convert, to_float>)
+        convert_numbers<to_unnormalized_float, N>(
+            accessor, first, length, out, out_stride);
+    else
+        throw gltf::exception::parse_error(
+            "Attempted to read non-normalized component as float");
 }
 
-::gltf::accessor::operator std::vector<uint32_t>() const
+template <typename T, size_t N>
+static void convert_indices(const gltf::accessor &accessor,
+                            size_t first,
+                            size_t length,
+                            uint8_t *out,
+                            size_t out_stride)
 {
-    if (type != attribute_type::SCALAR)
-        throw exception::parse_error("Accessor type is not SCALAR, cannot "
-                                     "convert to std::vector<uint32_t>");
+    using gltf::component_type;
 
-    std::vector<uint32_t> result;
-    result.reserve(count);
+    if (!in_range(accessor, first, length))
+        throw gltf::exception::parse_error(
+            "Range is out of bounds of accessor " + accessor.name);
 
-    for (size_t i = 0; i < count; i++)
+    if (!length)
+        return;
+
+    if (accessor.normalized)
+        throw gltf::exception::parse_error(
+            "Attempted to read normalized component as an index");
+
+    switch (accessor.component_type)
     {
-        result.push_back(get_component_as_index(i, 0));
+    case component_type::UBYTE:
+        convert_elements<uint8_t, to_index<T>, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    case component_type::USHORT:
+        convert_elements<uint16_t, to_index<T>, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    case component_type::UINT:
+        convert_elements<uint32_t, to_index<T>, N>(
+            accessor, first, length, out, out_stride);
+        return;
+    default:
+        throw gltf::exception::parse_error(
+            "Invalid component type for index conversion: " +
+            std::to_string(static_cast<uint16_t>(accessor.component_type)));
     }
+}
 
+// Reads an accessor into a vector of T, converted by read
+template <typename T, typename Read>
+static std::vector<T> read_vector(const gltf::accessor &accessor, Read read)
+{
+    std::vector<T> result(accessor.count);
+    read(accessor, 0, accessor.count, (uint8_t *)result.data(), sizeof(T));
     return result;
 }
 
-::gltf::accessor::operator std::vector<uint16_t>() const
+::gltf::accessor::operator std::vector<float>() const
 {
     if (type != attribute_type::SCALAR)
         throw exception::parse_error("Accessor type is not SCALAR, cannot "
-                                     "convert to std::vector<uint16_t>");
+                                     "convert to std::vector<float>");
+    return read_vector<float>(*this, convert_floats<to_float, 1>);
+}
 
-    std::vector<uint16_t> result;
-    result.reserve(count);
+::gltf::accessor::operator std::vector<vec::fvec3>() const
+{
+    if (type != attribute_type::VEC3)
+        throw exception::parse_error("Accessor type is not VEC3, cannot "
+                                     "convert to std::vector<vec::fvec3>");
+    return read_vector<vec::fvec3>(*this, convert_floats<to_float, 3>);
+}
 
-    for (size_t i = 0; i < count; i++)
-    {
-        result.push_back(get_component_as_index(i, 0));
-    }
+::gltf::accessor::operator std::vector<vec::fvec4>() const
+{
+    if (type != attribute_type::VEC4)
+        throw exception::parse_error("Accessor type is not VEC4, cannot "
+                                     "convert to std::vector<vec::fvec4>");
+    return read_vector<vec::fvec4>(*this, convert_floats<to_float, 4>);
+}
 
-    return result;
+::gltf::accessor::operator std::vector<uint32_t>() const
+{
+    if (type != attribute_type::SCALAR)
+        throw exception::parse_error("Accessor type is not SCALAR, cannot "
+                                     "convert to std::vector<uint32_t>");
+    return read_vector<uint32_t>(*this, convert_indices<uint32_t, 1>);
+}
+
+::gltf::accessor::operator std::vector<uint16_t>() const
+{
+    if (type != attribute_type::SCALAR)
+        throw exception::parse_error("Accessor type is not SCALAR, cannot "
+                                     "convert to std::vector<uint16_t>");
+    return read_vector<uint16_t>(*this, convert_indices<uint16_t, 1>);
 }
 
 ::gltf::accessor::operator std::vector<vec::i16vec2>() const
@@ -1065,18 +1310,7 @@ static uint8_t u8_from_float(float value)
     if (type != attribute_type::VEC2)
         throw exception::parse_error("Accessor type is not VEC2, cannot "
                                      "convert to std::vector<vec::i16vec2>");
-
-    std::vector<vec::i16vec2> result;
-
-    result.reserve(count);
-
-    for (size_t i = 0; i < count; i++)
-    {
-        result.push_back(
-            vec::i16vec2(i16_from_float(get_component_as_float(i, 0)),
-                         i16_from_float(get_component_as_float(i, 1))));
-    }
-    return result;
+    return read_vector<vec::i16vec2>(*this, convert_floats<to_i16, 2>);
 }
 
 ::gltf::accessor::operator std::vector<vec::i16vec4>() const
@@ -1084,20 +1318,7 @@ static uint8_t u8_from_float(float value)
     if (type != attribute_type::VEC4)
         throw exception::parse_error("Accessor type is not VEC4, cannot "
                                      "convert to std::vector<vec::i16vec4>");
-
-    std::vector<vec::i16vec4> result;
-
-    result.reserve(count);
-
-    for (size_t i = 0; i < count; i++)
-    {
-        result.push_back(
-            vec::i16vec4(i16_from_float(get_component_as_float(i, 0)),
-                         i16_from_float(get_component_as_float(i, 1)),
-                         i16_from_float(get_component_as_float(i, 2)),
-                         i16_from_float(get_component_as_float(i, 3))));
-    }
-    return result;
+    return read_vector<vec::i16vec4>(*this, convert_floats<to_i16, 4>);
 }
 
 ::gltf::accessor::operator std::vector<vec::u16vec2>() const
@@ -1105,18 +1326,7 @@ static uint8_t u8_from_float(float value)
     if (type != attribute_type::VEC2)
         throw exception::parse_error("Accessor type is not VEC2, cannot "
                                      "convert to std::vector<vec::u16vec2>");
-
-    std::vector<vec::u16vec2> result;
-
-    result.reserve(count);
-
-    for (size_t i = 0; i < count; i++)
-    {
-        result.push_back(
-            vec::u16vec2(u16_from_float(get_component_as_float(i, 0)),
-                         u16_from_float(get_component_as_float(i, 1))));
-    }
-    return result;
+    return read_vector<vec::u16vec2>(*this, convert_floats<to_u16, 2>);
 }
 
 ::gltf::accessor::operator std::vector<vec::u8vec4>() const
@@ -1125,33 +1335,9 @@ static uint8_t u8_from_float(float value)
         throw exception::parse_error("Accessor type is not VEC4, cannot "
                                      "convert to std::vector<vec::u8vec4>");
 
-    std::vector<vec::u8vec4> result;
-
-    result.reserve(count);
-
     if (normalized)
-    {
-        for (size_t i = 0; i < count; i++)
-        {
-            result.push_back(
-                vec::u8vec4(u8_from_float(get_component_as_float(i, 0)),
-                            u8_from_float(get_component_as_float(i, 1)),
-                            u8_from_float(get_component_as_float(i, 2)),
-                            u8_from_float(get_component_as_float(i, 3))));
-        }
-    }
-    else
-    {
-        for (size_t i = 0; i < count; i++)
-        {
-            result.push_back(vec::u8vec4(get_component_as_index(i, 0),
-                                         get_component_as_index(i, 1),
-                                         get_component_as_index(i, 2),
-                                         get_component_as_index(i, 3)));
-        }
-    }
-
-    return result;
+        return read_vector<vec::u8vec4>(*this, convert_floats<to_u8, 4>);
+    return read_vector<vec::u8vec4>(*this, convert_indices<uint8_t, 4>);
 }
 
 ::gltf::accessor::operator std::vector<vec::fmat4>() const
@@ -1159,29 +1345,19 @@ static uint8_t u8_from_float(float value)
     if (type != attribute_type::MAT4)
         throw exception::parse_error("Accessor type is not MAT4, cannot "
                                      "convert to std::vector<vec::fmat4>");
+    return read_vector<vec::fmat4>(*this, convert_floats<to_float, 16>);
+}
 
-    std::vector<vec::fmat4> result;
-    result.reserve(count);
+template <typename T>
+static std::vector<vec::cubicspline<T>>
+read_cubicsplines(const std::vector<T> &keys)
+{
+    std::vector<vec::cubicspline<T>> result;
+    result.reserve(keys.size() / 3);
 
-    for (size_t i = 0; i < count; i++)
-    {
-        result.push_back(vec::fmat4(get_component_as_float(i, 0),
-                                    get_component_as_float(i, 1),
-                                    get_component_as_float(i, 2),
-                                    get_component_as_float(i, 3),
-                                    get_component_as_float(i, 4),
-                                    get_component_as_float(i, 5),
-                                    get_component_as_float(i, 6),
-                                    get_component_as_float(i, 7),
-                                    get_component_as_float(i, 8),
-                                    get_component_as_float(i, 9),
-                                    get_component_as_float(i, 10),
-                                    get_component_as_float(i, 11),
-                                    get_component_as_float(i, 12),
-                                    get_component_as_float(i, 13),
-                                    get_component_as_float(i, 14),
-                                    get_component_as_float(i, 15)));
-    }
+    for (size_t i = 0; i < keys.size(); i += 3)
+        result.push_back(
+            vec::cubicspline<T>(keys[i], keys[i + 1], keys[i + 2]));
 
     return result;
 }
@@ -1198,24 +1374,7 @@ static uint8_t u8_from_float(float value)
             "Accessor count is not a multiple of 3, cannot convert to "
             "std::vector<vec::cubicspline<fvec3>>");
 
-    std::vector<vec::cubicspline<vec::fvec3>> result;
-    result.reserve(count / 3);
-
-    for (size_t i = 0; i < count; i += 3)
-    {
-        result.push_back(vec::cubicspline<vec::fvec3>(
-            vec::fvec3(get_component_as_float(i, 0),
-                       get_component_as_float(i, 1),
-                       get_component_as_float(i, 2)),
-            vec::fvec3(get_component_as_float(i + 1, 0),
-                       get_component_as_float(i + 1, 1),
-                       get_component_as_float(i + 1, 2)),
-            vec::fvec3(get_component_as_float(i + 2, 0),
-                       get_component_as_float(i + 2, 1),
-                       get_component_as_float(i + 2, 2))));
-    }
-
-    return result;
+    return read_cubicsplines<vec::fvec3>(*this);
 }
 
 ::gltf::accessor::operator std::vector<vec::cubicspline<vec::fvec4>>() const
@@ -1230,194 +1389,116 @@ static uint8_t u8_from_float(float value)
             "Accessor count is not a multiple of 3, cannot convert to "
             "std::vector<vec::cubicspline<fvec4>>");
 
-    std::vector<vec::cubicspline<vec::fvec4>> result;
-    result.reserve(count / 3);
-
-    for (size_t i = 0; i < count; i += 3)
-    {
-        result.push_back(vec::cubicspline<vec::fvec4>(
-            vec::fvec4(get_component_as_float(i, 0),
-                       get_component_as_float(i, 1),
-                       get_component_as_float(i, 2),
-                       get_component_as_float(i, 3)),
-            vec::fvec4(get_component_as_float(i + 1, 0),
-                       get_component_as_float(i + 1, 1),
-                       get_component_as_float(i + 1, 2),
-                       get_component_as_float(i + 1, 3)),
-            vec::fvec4(get_component_as_float(i + 2, 0),
-                       get_component_as_float(i + 2, 1),
-                       get_component_as_float(i + 2, 2),
-                       get_component_as_float(i + 2, 3))));
-    }
-
-    return result;
-}
-
-template <typename T>
-static void append_type(std::vector<uint8_t> &output, const T &input)
-{
-    size_t begin = output.size();
-    output.resize(begin + sizeof(T));
-    T *dest = (T *)(&output[begin]);
-    *dest = input;
+    return read_cubicsplines<vec::fvec4>(*this);
 }
 
-void gltf::accessor::dump_uint32(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_uint32(uint8_t *out,
+                                 size_t out_stride,
+                                 size_t first,
+                                 size_t length) const
 {
     if (type != ::gltf::attribute_type::SCALAR)
         throw exception::parse_error(
             "Accessor type is not SCALAR, cannot dump to uint32_t");
-
-    output.reserve(output.size() + count * sizeof(uint32_t));
-    for (size_t i = 0; i < count; i++)
-        append_type<uint32_t>(output, get_component_as_index(i, 0));
+    convert_indices<uint32_t, 1>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_uint16(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_uint16(uint8_t *out,
+                                 size_t out_stride,
+                                 size_t first,
+                                 size_t length) const
 {
     if (type != ::gltf::attribute_type::SCALAR)
         throw exception::parse_error(
             "Accessor type is not SCALAR, cannot dump to uint16_t");
-
-    output.reserve(output.size() + count * sizeof(uint16_t));
-    for (size_t i = 0; i < count; i++)
-        append_type<uint16_t>(
-            output,
-            static_cast<uint16_t>(get_component_as_index(i, 0)));
+    convert_indices<uint16_t, 1>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_fvec3(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_fvec3(uint8_t *out,
+                                size_t out_stride,
+                                size_t first,
+                                size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC3)
         throw exception::parse_error(
             "Accessor type is not VEC3, cannot dump to fvec3");
-
-    output.reserve(output.size() + count * 3 * sizeof(float));
-    for (size_t i = 0; i < count; i++)
-    {
-        append_type<vec::fvec3>(output,
-                                vec::fvec3(get_component_as_float(i, 0),
-                                           get_component_as_float(i, 1),
-                                           get_component_as_float(i, 2)));
-    }
+    convert_floats<to_float, 3>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_fvec2(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_fvec2(uint8_t *out,
+                                size_t out_stride,
+                                size_t first,
+                                size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC2)
         throw exception::parse_error(
             "Accessor type is not VEC2, cannot dump to fvec2");
-
-    output.reserve(output.size() + count * 3 * sizeof(float));
-    for (size_t i = 0; i < count; i++)
-    {
-        append_type<vec::fvec2>(output,
-                                vec::fvec2(get_component_as_float(i, 0),
-                                           get_component_as_float(i, 1)));
-    }
+    convert_floats<to_float, 2>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_i16vec3(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_i16vec3(uint8_t *out,
+                                  size_t out_stride,
+                                  size_t first,
+                                  size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC3)
         throw exception::parse_error(
             "Accessor type is not VEC3, cannot dump to i16vec3");
-
-    output.reserve(output.size() + count * 3 * sizeof(int16_t));
-    for (size_t i = 0; i < count; i++)
-    {
-        append_type<vec::i16vec3>(
-            output,
-            vec::i16vec3(i16_from_float(get_component_as_float(i, 0)),
-                         i16_from_float(get_component_as_float(i, 1)),
-                         i16_from_float(get_component_as_float(i, 2))));
-    }
+    convert_floats<to_i16, 3>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_i16vec2(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_i16vec2(uint8_t *out,
+                                  size_t out_stride,
+                                  size_t first,
+                                  size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC2)
         throw exception::parse_error(
             "Accessor type is not VEC2, cannot dump to i16vec2");
-
-    output.reserve(output.size() + count * 2 * sizeof(int16_t));
-    for (size_t i = 0; i < count; i++)
-    {
-        append_type<vec::i16vec2>(
-            output,
-            vec::i16vec2(i16_from_float(get_component_as_float(i, 0)),
-                         i16_from_float(get_component_as_float(i, 1))));
-    }
+    convert_floats<to_i16, 2>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_i16vec4(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_i16vec4(uint8_t *out,
+                                  size_t out_stride,
+                                  size_t first,
+                                  size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC4)
         throw exception::parse_error(
             "Accessor type is not VEC4, cannot dump to i16vec4");
-
-    output.reserve(output.size() + count * 4 * sizeof(int16_t));
-    for (size_t i = 0; i < count; i++)
-    {
-        append_type<vec::i16vec4>(
-            output,
-            vec::i16vec4(i16_from_float(get_component_as_float(i, 0)),
-                         i16_from_float(get_component_as_float(i, 1)),
-                         i16_from_float(get_component_as_float(i, 2)),
-                         i16_from_float(get_component_as_float(i, 3))));
-    }
+    convert_floats<to_i16, 4>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_u16vec2(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_u16vec2(uint8_t *out,
+                                  size_t out_stride,
+                                  size_t first,
+                                  size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC2)
         throw exception::parse_error(
             "Accessor type is not VEC2, cannot dump to u16vec2");
-
-    output.reserve(output.size() + count * 2 * sizeof(uint16_t));
-
-    for (size_t i = 0; i < count; i++)
-    {
-        append_type<vec::u16vec2>(
-            output,
-            vec::u16vec2(u16_from_float(get_component_as_float(i, 0)),
-                         u16_from_float(get_component_as_float(i, 1))));
-    }
+    convert_floats<to_u16, 2>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump_u8vec4(std::vector<uint8_t> &output) const
+void gltf::accessor::dump_u8vec4(uint8_t *out,
+                                 size_t out_stride,
+                                 size_t first,
+                                 size_t length) const
 {
     if (type != ::gltf::attribute_type::VEC4)
         throw exception::parse_error(
             "Accessor type is not VEC4, cannot dump to u8vec4");
 
-    output.reserve(output.size() + count * 4 * sizeof(uint8_t));
     if (normalized || component_type == component_type::FLOAT)
-    {
-        for (size_t i = 0; i < count; i++)
-        {
-            append_type<vec::u8vec4>(
-                output,
-                vec::u8vec4(u8_from_float(get_component_as_float(i, 0)),
-                            u8_from_float(get_component_as_float(i, 1)),
-                            u8_from_float(get_component_as_float(i, 2)),
-                            u8_from_float(get_component_as_float(i, 3))));
-        }
-    }
+        convert_floats<to_u8, 4>(*this, first, length, out, out_stride);
     else
-    {
-        for (size_t i = 0; i < count; i++)
-        {
-            append_type<vec::u8vec4>(output,
-                                     vec::u8vec4(get_component_as_index(i, 0),
-                                                 get_component_as_index(i, 1),
-                                                 get_component_as_index(i, 2),
-                                                 get_component_as_index(i, 3)));
-        }
-    }
+        convert_indices<uint8_t, 4>(*this, first, length, out, out_stride);
 }
 
-void gltf::accessor::dump(std::vector<uint8_t> &output,
+void gltf::accessor::dump(uint8_t *out,
+                          size_t out_stride,
+                          size_t first,
+                          size_t length,
                           enum component_type target_component_type,
                           attribute_type target_attribute_type) const
 {
@@ -1427,10 +1508,10 @@ void gltf::accessor::dump(std::vector<uint8_t> &output,
         switch (target_component_type)
         {
         case component_type::UINT:
-            dump_uint32(output);
+            dump_uint32(out, out_stride, first, length);
             return;
         case component_type::USHORT:
-            dump_uint16(output);
+            dump_uint16(out, out_stride, first, length);
             return;
         default:
             throw exception::parse_error(
@@ -1439,12 +1520,12 @@ void gltf::accessor::dump(std::vector<uint8_t> &output,
     case attribute_type::VEC3:
         if (target_component_type == component_type::FLOAT)
         {
-            dump_fvec3(output);
+            dump_fvec3(out, out_stride, first, length);
             return;
         }
         if (target_component_type == component_type::SHORT)
         {
-            dump_i16vec3(output);
+            dump_i16vec3(out, out_stride, first, length);
             return;
         }
         throw exception::parse_error(
@@ -1452,17 +1533,17 @@ void gltf::accessor::dump(std::vector<uint8_t> &output,
     case attribute_type::VEC2:
         if (target_component_type == component_type::SHORT)
         {
-            dump_i16vec2(output);
+            dump_i16vec2(out, out_stride, first, length);
             return;
         }
         if (target_component_type == component_type::USHORT)
         {
-            dump_u16vec2(output);
+            dump_u16vec2(out, out_stride, first, length);
             return;
         }
         if (target_component_type == component_type::FLOAT)
         {
-            dump_fvec2(output);
+            dump_fvec2(out, out_stride, first, length);
             return;
         }
         throw exception::parse_error(
@@ -1470,12 +1551,12 @@ void gltf::accessor::dump(std::vector<uint8_t> &output,
     case attribute_type::VEC4:
         if (target_component_type == component_type::SHORT)
         {
-            dump_i16vec4(output);
+            dump_i16vec4(out, out_stride, first, length);
             return;
         }
         if (target_component_type == component_type::UBYTE)
         {
-            dump_u8vec4(output);
+            dump_u8vec4(out, out_stride, first, length);
             return;
         }
         throw exception::parse_error(
@@ -1484,3 +1565,28 @@ void gltf::accessor::dump(std::vector<uint8_t> &output,
         throw exception::parse_error("Unsupported target attribute type");
     }
 }
+
+void gltf::accessor::dump(std::vector<uint8_t> &output,
+                          enum component_type target_component_type,
+                          attribute_type target_attribute_type) const
+{
+    const size_t element_size = get_component_size(target_component_type) *
+                                (size_t)target_attribute_type;
+    const size_t begin = output.size();
+    output.resize(begin + count * element_size);
+
+    try
+    {
+        dump(output.data() + begin,
+             element_size,
+             0,
+             count,
+             target_component_type,
+             target_attribute_type);
+    }
+    catch (...)
+    {
+        output.resize(begin);
+        throw;
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Builds a GLB for tests: a binary chunk with views into it and accessors
+// over those, and the JSON that describes them.
+struct glb
+{
+    std::string bin;
+    std::vector<std::string> views;
+    std::vector<std::string> accessors;
+
+    template <typename T> void append(T value)
+    {
+        bin.append((const char *)&value, sizeof(value));
+    }
+
+    // Makes everything appended since begin a view and returns its index
+    size_t view(size_t begin, size_t stride = 0)
+    {
+        std::string json = "{\"buffer\":0,\"byteOffset\":" +
+                           std::to_string(begin) + ",\"byteLength\":" +
+                           std::to_string(bin.size() - begin);
+        if (stride)
+            json += ",\"byteStride\":" + std::to_string(stride);
+        views.push_back(json + "}");
+        pad(bin, '\0');
+        return views.size() - 1;
+    }
+
+    size_t accessor(size_t view,
+                    size_t offset,
+                    int component_type,
+                    const std::string &type,
+                    size_t count,
+                    bool normalized)
+    {
+        accessors.push_back(
+            "{\"bufferView\":" + std::to_string(view) +
+            ",\"byteOffset\":" + std::to_string(offset) +
+            ",\"componentType\":" + std::to_string(component_type) +
+            ",\"type\":\"" + type + "\",\"count\":" + std::to_string(count) +
+            (normalized ? ",\"normalized\":true}" : "}"));
+        return accessors.size() - 1;
+    }
+
+    // Appends an accessor with a view of its own, calling element with the
+    // index of each element to append it
+    template <typename F>
+    size_t add(int component_type,
+               const std::string &type,
+               bool normalized,
+               size_t count,
+               F element)
+    {
+        const size_t begin = bin.size();
+        for (size_t i = 0; i < count; i++)
+            element(i);
+        return accessor(
+            view(begin), 0, component_type, type, count, normalized);
+    }
+
+    // Writes the file. members are any JSON members to add after the
+    // accessors, each starting with a comma.
+    void write(const std::filesystem::path &path,
+               const std::string &members = "") const
+    {
+        std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{"
+                           "\"byteLength\":" +
+                           std::to_string(bin.size()) + "}]";
+        json += ",\"bufferViews\":" + list(views);
+        if (!accessors.empty())
+            json += ",\"accessors\":" + list(accessors);
+        json += members + "}";
+        pad(json, ' ');
+
+        std::ofstream stream(path, std::ios::binary);
+        write_u32(stream, 0x46546C67);
+        write_u32(stream, 2);
+        write_u32(stream, 12 + 8 + json.size() + 8 + bin.size());
+        write_u32(stream, json.size());
+        write_u32(stream, 0x4E4F534A);
+        stream.write(json.data(), json.size());
+        write_u32(stream, bin.size());
+        write_u32(stream, 0x004E4942);
+        stream.write(bin.data(), bin.size());
+    }
+
+    static std::string list(const std::vector<std::string> &items)
+    {
+        std::string json = "[";
+        for (size_t i = 0; i < items.size(); i++)
+            json += (i ? "," : "") + items[i];
+        return json + "]";
+    }
+
+  private:
+    static void pad(std::string &chunk, char fill)
+    {
+        while (chunk.size() % 4)
+            chunk.push_back(fill);
+    }
+
+    static void write_u32(std::ofstream &stream, uint32_t value)
+    {
+        stream.write((const char *)&value, sizeof(value));
+    }
+};
@@ -0,0 +1,309 @@
+#include "glb.hpp"
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <engine/gltf.hpp>
+#include <filesystem>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Writes a GLB holding one large mesh's worth of accessors, packed and
+// interleaved, checks typed views and conversions of them against values
+// worked out here, then times dumping each to the types the gpu uploads.
+
+static const size_t vertex_count = 1 << 20;
+
+// Interleaved normal and texture coordinate
+static const size_t interleaved_stride = 5 * sizeof(float);
+
+static float position(size_t vertex, size_t component)
+{
+    return (float)(vertex % 1000) * 0.5f - (float)component;
+}
+
+static float normal(size_t vertex, size_t component)
+{
+    return component == (vertex % 3) ? 1.0f : 0.0f;
+}
+
+static float texcoord(size_t vertex, size_t component)
+{
+    return (float)((vertex + component * 7) % 256) / 256.0f;
+}
+
+static int16_t tangent(size_t vertex, size_t component)
+{
+    return (int16_t)((vertex * 31 + component * 977) % 65535 - 32767);
+}
+
+static uint8_t joint(size_t vertex, size_t component)
+{
+    return (uint8_t)((vertex + component) % 64);
+}
+
+static uint8_t weight(size_t vertex, size_t component)
+{
+    return (uint8_t)((vertex * 13 + component * 101) % 256);
+}
+
+static void write_glb(const std::filesystem::path &path)
+{
+    glb glb;
+    size_t begin;
+
+    begin = glb.bin.size();
+    for (size_t v = 0; v < vertex_count; v++)
+        for (size_t c = 0; c < 3; c++)
+            glb.append(position(v, c));
+    glb.view(begin);
+
+    begin = glb.bin.size();
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        for (size_t c = 0; c < 3; c++)
+            glb.append(normal(v, c));
+        for (size_t c = 0; c < 2; c++)
+            glb.append(texcoord(v, c));
+    }
+    glb.view(begin, interleaved_stride);
+
+    begin = glb.bin.size();
+    for (size_t v = 0; v < vertex_count; v++)
+        for (size_t c = 0; c < 4; c++)
+            glb.append(tangent(v, c));
+    glb.view(begin);
+
+    begin = glb.bin.size();
+    for (size_t v = 0; v < vertex_count; v++)
+        for (size_t c = 0; c < 4; c++)
+            glb.append(joint(v, c));
+    glb.view(begin);
+
+    begin = glb.bin.size();
+    for (size_t v = 0; v < vertex_count; v++)
+        for (size_t c = 0; c < 4; c++)
+            glb.append(weight(v, c));
+    glb.view(begin);
+
+    begin = glb.bin.size();
+    for (size_t v = 0; v < vertex_count; v++)
+        glb.append((uint32_t)(vertex_count - 1 - v));
+    glb.view(begin);
+
+    glb.accessor(0, 0, 5126, "VEC3", vertex_count, false);
+    glb.accessor(1, 0, 5126, "VEC3", vertex_count, false);
+    glb.accessor(1, 12, 5126, "VEC2", vertex_count, false);
+    glb.accessor(2, 0, 5122, "VEC4", vertex_count, true);
+    glb.accessor(3, 0, 5121, "VEC4", vertex_count, false);
+    glb.accessor(4, 0, 5121, "VEC4", vertex_count, true);
+    glb.accessor(5, 0, 5125, "SCALAR", vertex_count, false);
+    // One element past the end of its view
+    glb.accessor(5, 4, 5125, "SCALAR", vertex_count, false);
+
+    glb.write(path);
+}
+
+template <typename T>
+static T read(const std::vector<uint8_t> &output, size_t index)
+{
+    T value;
+    memcpy(&value, output.data() + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+static void check(const gltf::gltf &gltf)
+{
+    const gltf::accessor &positions = gltf.accessors[0];
+    const gltf::accessor &normals = gltf.accessors[1];
+    const gltf::accessor &texcoords = gltf.accessors[2];
+    const gltf::accessor &tangents = gltf.accessors[3];
+    const gltf::accessor &joints = gltf.accessors[4];
+    const gltf::accessor &weights = gltf.accessors[5];
+    const gltf::accessor &indices = gltf.accessors[6];
+    const gltf::accessor &overrun = gltf.accessors[7];
+
+    const size_t last = vertex_count - 1;
+
+    // Views read elements in place, packed or interleaved
+    const gltf::accessor_view<vec::fvec3> position_view =
+        positions.view<vec::fvec3>();
+    assert(position_view.contiguous());
+    assert(position_view.size() == vertex_count);
+    assert(position_view[last].y == position(last, 1));
+
+    const gltf::accessor_view<vec::fvec2> texcoord_view =
+        texcoords.view<vec::fvec2>();
+    assert(!texcoord_view.contiguous());
+    assert(texcoord_view[last].y == texcoord(last, 1));
+
+    assert(joints.view<vec::u8vec4>()[last].w == joint(last, 3));
+    assert(tangents.view<vec::i16vec4>()[last].z == tangent(last, 2));
+    assert(indices.view<uint32_t>()[0] == last);
+
+    bool threw = false;
+    try
+    {
+        normals.view<vec::fvec4>();
+    }
+    catch (const gltf::exception::parse_error &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    threw = false;
+    try
+    {
+        overrun.view<uint32_t>();
+    }
+    catch (const gltf::exception::parse_error &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    threw = false;
+    try
+    {
+        std::vector<uint32_t> read = overrun;
+    }
+    catch (const gltf::exception::parse_error &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    // Only floats take integers that are not normalized, as the other
+    // targets would take them as normalized values out of their range
+    threw = false;
+    try
+    {
+        std::vector<vec::i16vec4> read = joints;
+    }
+    catch (const gltf::exception::parse_error &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    // Conversions match the glTF rules applied one component at a time
+    const std::vector<vec::fvec3> normal_floats = normals;
+    const std::vector<vec::fvec4> tangent_floats = tangents;
+    const std::vector<vec::u8vec4> weight_bytes = weights;
+    // Integers that are not normalized read as they are, as quantized
+    // positions do
+    const std::vector<vec::fvec4> joint_floats = joints;
+    std::vector<uint8_t> i16_normals;
+    std::vector<uint8_t> u16_texcoords;
+    std::vector<uint8_t> u8_weights;
+    std::vector<uint8_t> short_indices;
+    normals.dump(i16_normals,
+                 gltf::component_type::SHORT,
+                 gltf::attribute_type::VEC3);
+    texcoords.dump(u16_texcoords,
+                   gltf::component_type::USHORT,
+                   gltf::attribute_type::VEC2);
+    weights.dump(u8_weights,
+                 gltf::component_type::UBYTE,
+                 gltf::attribute_type::VEC4);
+    indices.dump(short_indices,
+                 gltf::component_type::USHORT,
+                 gltf::attribute_type::SCALAR);
+
+    for (size_t v = 0; v < vertex_count; v += 997)
+    {
+        assert(normal_floats[v].x == normal(v, 0));
+        assert(normal_floats[v].z == normal(v, 2));
+        assert(read<int16_t>(i16_normals, v * 3 + 1) ==
+               (int16_t)std::round(normal(v, 1) * 32767.0f));
+        assert(read<uint16_t>(u16_texcoords, v * 2 + 1) ==
+               (uint16_t)std::round(texcoord(v, 1) * 65535.0f));
+        assert(tangent_floats[v].y ==
+               std::fmax((float)tangent(v, 1) / 32767.0f, -1.0f));
+        assert(weight_bytes[v].z == weight(v, 2));
+        assert(joint_floats[v].y == joint(v, 1));
+        assert(read<uint8_t>(u8_weights, v * 4 + 3) == weight(v, 3));
+        assert(read<uint16_t>(short_indices, v) == (uint16_t)(last - v));
+    }
+}
+
+static void bench(const gltf::gltf &gltf)
+{
+    struct target
+    {
+        const char *name;
+        size_t accessor;
+        enum gltf::component_type component_type;
+        gltf::attribute_type attribute_type;
+    };
+
+    const target targets[] = {
+        {"position fvec3", 0, gltf::component_type::FLOAT,
+         gltf::attribute_type::VEC3},
+        {"position i16vec3", 0, gltf::component_type::SHORT,
+         gltf::attribute_type::VEC3},
+        {"normal fvec3, interleaved", 1, gltf::component_type::FLOAT,
+         gltf::attribute_type::VEC3},
+        {"texcoord u16vec2, interleaved", 2, gltf::component_type::USHORT,
+         gltf::attribute_type::VEC2},
+        {"tangent i16vec4", 3, gltf::component_type::SHORT,
+         gltf::attribute_type::VEC4},
+        {"joints u8vec4", 4, gltf::component_type::UBYTE,
+         gltf::attribute_type::VEC4},
+        {"weights u8vec4", 5, gltf::component_type::UBYTE,
+         gltf::attribute_type::VEC4},
+        {"indices uint32", 6, gltf::component_type::UINT,
+         gltf::attribute_type::SCALAR},
+        {"indices uint16", 6, gltf::component_type::USHORT,
+         gltf::attribute_type::SCALAR},
+    };
+
+    const size_t repeat = 10;
+    std::vector<uint8_t> output;
+
+    for (const target &target : targets)
+    {
+        const gltf::accessor &accessor = gltf.accessors[target.accessor];
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < repeat; n++)
+        {
+            output.clear();
+            accessor.dump(output, target.component_type, target.attribute_type);
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << target.name << ": "
+                  << vertex_count * repeat / elapsed.count() / 1e6
+                  << " M vertices/s\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scratch directory>\n";
+        return 1;
+    }
+
+    const std::filesystem::path directory =
+        std::filesystem::path(argv[1]) / "gltf.accessor";
+    std::filesystem::create_directories(directory);
+    write_glb(directory / "mesh.glb");
+
+    engine::filesystem::whitelist wl(directory.string());
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+    const gltf::gltf gltf("mesh.glb", fs_bin, fs_img);
+
+    check(gltf);
+    bench(gltf);
+
+    std::cout << "Success\n";
+    return 0;
+}
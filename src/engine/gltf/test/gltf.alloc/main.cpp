@@ -0,0 +1,107 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <engine/gltf.hpp>
+#include <engine/skel.hpp>
+#include <filesystem>
+#include <iostream>
+#include <new>
+
+// Counts heap allocations made while loading each glTF and building its
+// armatures and animations, so load-time allocation changes can be compared.
+// Only new is replaced; the default delete releases with free, which matches
+// the allocators below.
+
+static std::atomic<size_t> allocations = 0;
+static std::atomic<size_t> allocated_bytes = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    allocated_bytes += size;
+    if (void *result = std::malloc(size ? size : 1))
+        return result;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    allocations++;
+    allocated_bytes += size;
+    const size_t align = (size_t)alignment;
+    if (void *result = std::aligned_alloc(align, (size + align - 1) & -align))
+        return result;
+    throw std::bad_alloc();
+}
+
+struct counts
+{
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+static counts load(const std::filesystem::path &path)
+{
+    engine::filesystem::whitelist wl(path.parent_path().string());
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+    gltf::gltf_cache cache(wl, fs_bin, fs_img);
+
+    const size_t start = allocations;
+    const size_t start_bytes = allocated_bytes;
+
+    const gltf::gltf_cache::reference ref = cache[path.filename().string()];
+    const gltf::gltf &gltf = *ref;
+
+    for (const gltf::skin &skin : gltf.skins)
+        skel::armature armature(skin, gltf);
+
+    for (const gltf::animation &animation : gltf.animations)
+        skel::animation anim(animation, gltf);
+
+    return {allocations - start, allocated_bytes - start_bytes};
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <file.glb> ...\n";
+        return 1;
+    }
+
+    const size_t repeat = 20;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::filesystem::path path(argv[i]);
+
+        // The first load also pays for thread pool and stream setup
+        load(path);
+
+        const auto start = std::chrono::steady_clock::now();
+        counts total;
+
+        for (size_t n = 0; n < repeat; n++)
+        {
+            const counts once = load(path);
+            total.allocations += once.allocations;
+            total.bytes += once.bytes;
+        }
+
+        const std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << path.filename().string() << ": "
+                  << total.allocations / repeat << " allocations, "
+                  << total.bytes / repeat << " bytes, "
+                  << elapsed.count() / repeat << " us per load\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "glb.hpp"
+#include <assert.h>
+#include <chrono>
+#include <engine/gltf.hpp>
+#include <filesystem>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef USE_LIBPNG
+#include <png.h>
+#endif
+
+// Writes a GLB holding many embedded PNG textures into the given directory
+// and times loading it with pools of increasing size, to show how image
+// decoding scales with the cores available.
+
+#ifdef USE_LIBPNG
+static const size_t image_count = 16;
+static const uint32_t image_size = 512;
+
+static void append(png_structp png, png_bytep data, png_size_t length)
+{
+    std::vector<uint8_t> &out = *(std::vector<uint8_t> *)png_get_io_ptr(png);
+    out.insert(out.end(), data, data + length);
+}
+
+static uint8_t shade(uint32_t x, uint32_t y, uint32_t seed)
+{
+    uint32_t noise = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+    return (x + y + seed * 16) / 4 + (noise >> 28);
+}
+
+static std::vector<uint8_t> encode_png(uint32_t seed)
+{
+    std::vector<uint8_t> out;
+    png_structp png =
+        png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+
+    png_set_write_fn(png, &out, append, NULL);
+    png_set_IHDR(png,
+                 info,
+                 image_size,
+                 image_size,
+                 8,
+                 PNG_COLOR_TYPE_RGBA,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    std::vector<uint8_t> row(image_size * 4);
+    for (uint32_t y = 0; y < image_size; y++)
+    {
+        for (uint32_t x = 0; x < image_size; x++)
+        {
+            row[x * 4 + 0] = shade(x, y, seed);
+            row[x * 4 + 1] = shade(y, x, seed);
+            row[x * 4 + 2] = seed;
+            row[x * 4 + 3] = 255;
+        }
+        png_write_row(png, row.data());
+    }
+
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+    return out;
+}
+
+static void write_glb(const std::filesystem::path &path)
+{
+    glb glb;
+    std::vector<std::string> images;
+
+    for (size_t i = 0; i < image_count; i++)
+    {
+        const std::vector<uint8_t> png = encode_png(i);
+        const size_t begin = glb.bin.size();
+        glb.bin.append((const char *)png.data(), png.size());
+        images.push_back("{\"bufferView\":" +
+                         std::to_string(glb.view(begin)) +
+                         ",\"mimeType\":\"image/png\"}");
+    }
+
+    glb.write(path, ",\"images\":" + glb.list(images));
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scratch directory>\n";
+        return 1;
+    }
+
+    const std::filesystem::path directory =
+        std::filesystem::path(argv[1]) / "gltf.images";
+    std::filesystem::create_directories(directory);
+    write_glb(directory / "textures.glb");
+
+    engine::filesystem::whitelist wl(directory.string());
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+
+    std::vector<size_t> thread_counts = {1, 2, 4};
+    const size_t cores = std::thread::hardware_concurrency();
+    if (cores > 4)
+        thread_counts.push_back(cores);
+
+    double single = 0;
+
+    for (size_t threads : thread_counts)
+    {
+        engine::filesystem::pool pool(threads);
+        const size_t repeat = 5;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t n = 0; n < repeat; n++)
+        {
+            const gltf::gltf gltf("textures.glb", fs_bin, fs_img, pool);
+
+            assert(gltf.images.size() == image_count);
+            for (size_t i = 0; i < image_count; i++)
+            {
+                const engine::image::rgba32 &image = gltf.images[i].contents;
+                assert(image.width == image_size);
+                assert(image.height == image_size);
+                assert(image.data()[7].b == i);
+            }
+        }
+
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        const double per_load = elapsed.count() / repeat;
+
+        if (threads == 1)
+            single = per_load;
+
+        std::cout << threads << " threads: " << per_load << " ms per load ("
+                  << single / per_load << "x)\n";
+    }
+
+    std::cout << cores << " cores available\n";
+
+    return 0;
+}
+#else
+int main()
+{
+    std::cout << "Built without libpng, nothing to decode\n";
+    return 0;
+}
+#endif
@@ -8,8 +8,10 @@
 #include <engine/memory.hpp>
 #include <engine/skel.hpp>
 #include <engine/vec.hpp>
+#include <optional>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 namespace gltf
@@ -23,7 +25,7 @@ class gltf;
 
 namespace engine::gpu::attributes
 {
-using position = vec::fvec3;
+using position = vec::vec3<uint16_t>;
 using normal = vec::vec3<int16_t>;
 using tangent = vec::vec4<int16_t>;
 using texcoord = vec::vec2<uint16_t>;
@@ -31,8 +33,363 @@ using color = vec::vec4<uint8_t>;
 using joints = vec::vec4<uint8_t>;
 using weights = vec::vec4<uint8_t>;
 using index = uint32_t;
+
+// How each vertex attribute of a primitive is stored and bound. Attributes
+// are stored in this order, and each is bound to the location of its index.
+struct layout
+{
+    bool normalized;
+    gltf::component_type component_type;
+    gltf::attribute_type attribute_type;
+
+    // Bytes of one element
+    constexpr size_t size() const
+    {
+        const size_t components = (size_t)attribute_type;
+        switch (component_type)
+        {
+        case gltf::component_type::BYTE:
+        case gltf::component_type::UBYTE:
+            return components;
+        case gltf::component_type::SHORT:
+        case gltf::component_type::USHORT:
+            return components * 2;
+        default:
+            return components * 4;
+        }
+    }
+};
+inline constexpr size_t count = 6;
+inline constexpr layout layouts[count] = {
+    {true, gltf::component_type::USHORT, gltf::attribute_type::VEC3},
+    {true, gltf::component_type::SHORT, gltf::attribute_type::VEC3},
+    {true, gltf::component_type::SHORT, gltf::attribute_type::VEC4},
+    {true, gltf::component_type::USHORT, gltf::attribute_type::VEC2},
+    {false, gltf::component_type::UBYTE, gltf::attribute_type::VEC4},
+    {true, gltf::component_type::UBYTE, gltf::attribute_type::VEC4},
+};
+
+// Positions and texture coordinates are stored as unsigned normalized shorts
+// spread over the range of each component within their primitive, and read
+// back as offset + scale * stored
+struct quantization
+{
+    vec::fvec3 position_offset;
+    vec::fvec3 position_scale;
+    vec::fvec2 texcoord_offset;
+    vec::fvec2 texcoord_scale;
+
+    position quantize(const vec::fvec3 &) const;
+    texcoord quantize(const vec::fvec2 &) const;
+    vec::fvec3 dequantize(const position &) const;
+    vec::fvec2 dequantize(const texcoord &) const;
+};
+
+// How the attributes of a primitive are arranged in its vertex buffer:
+// separate holds one array per attribute, one after another, and interleaved
+// one record per vertex holding each of its attributes, each aligned to 4
+// bytes, so fetching a vertex reads one run of memory.
+enum class arrangement : uint32_t
+{
+    separate,
+    interleaved,
+};
 } // namespace engine::gpu::attributes
 
+namespace engine::gpu
+{
+// An asset flattened into the form engine::gpu::asset uploads: vertex and
+// index arrays in attributes::layouts, decoded RGBA textures, and armatures
+// and animations as skel holds them. The file is mapped once and records are
+// read where they lie, so loading one involves no parsing or conversion.
+//
+// A header records the size, modification time and hash of the source it was
+// baked from. It is current while the size and time match, or while the hash
+// matches when only the time has changed, which is hashed again on every open.
+// Changes to files the source refers to would go unseen, so only sources
+// without external buffers or images are baked. Baked files are little-endian
+// and, like packs, written to a temporary file that is renamed into place and
+// never written again.
+class baked
+{
+  public:
+    static constexpr char magic[8] = {'M', 'B', 'B', 'A', 'K', 'E', 0, 0};
+    static constexpr uint32_t version = 5;
+    static constexpr size_t alignment = 64;
+    static constexpr uint32_t absent = UINT32_MAX;
+    // Levels of detail of each primitive, the full one first
+    static constexpr size_t lod_count = 4;
+
+    // Bytes in the names area, absent if there is no name at all
+    struct string
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Bytes from the start of the file
+    struct range
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    enum class section : uint32_t
+    {
+        textures,
+        materials,
+        meshes,
+        primitives,
+        objects,
+        armatures,
+        bones,
+        animations,
+        samplers,
+        inputs,
+        channels,
+        names,
+    };
+    static constexpr size_t section_count = 12;
+
+    struct header
+    {
+        char magic[8];
+        uint32_t version;
+        enum attributes::arrangement arrangement;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint64_t source_hash;
+        range sections[section_count];
+    };
+
+    struct texture
+    {
+        string name;
+        uint32_t width;
+        uint32_t height;
+        range pixels;
+        enum gltf::min_filter min_filter;
+        enum gltf::mag_filter mag_filter;
+        enum gltf::wrap_mode wrap_s;
+        enum gltf::wrap_mode wrap_t;
+    };
+
+    // Textures are referred to by name
+    struct material
+    {
+        string name;
+        string normal_texture;
+        string occlusion_texture;
+        string emissive_texture;
+        string base_color_texture;
+        string metallic_roughness_texture;
+        vec::fvec4 base_color_factor;
+        vec::fvec3 emissive_factor;
+        float metallic;
+        float roughness;
+        float alpha_cutoff;
+        uint32_t double_sided;
+    };
+
+    struct mesh
+    {
+        string name;
+        uint32_t first_primitive;
+        uint32_t primitive_count;
+    };
+
+    // Indices drawn for a level of detail, counted from the first of the
+    // primitive, and how far it strays from the full primitive in the units
+    // of its positions. Levels that could not be simplified further repeat
+    // the one before.
+    struct lod
+    {
+        uint32_t first;
+        uint32_t count;
+        float error;
+    };
+
+    struct primitive
+    {
+        string material;
+        range vertices;
+        range indices;
+        // Bytes from the start of vertices, or absent. Interleaved, from the
+        // start of each vertex.
+        uint32_t offsets[attributes::count];
+        // Bytes between vertices when interleaved, otherwise 0
+        uint32_t stride;
+        // Attributes bound as integers rather than as floats
+        uint32_t integer_mask;
+        // Indices of every level of detail, or vertices if there are none
+        uint32_t count;
+        uint32_t short_indices;
+        float radius;
+        lod lods[lod_count];
+        attributes::quantization quantization;
+    };
+
+    struct object
+    {
+        string name;
+        string mesh;
+        string skin;
+    };
+
+    struct armature
+    {
+        string name;
+        string root_name;
+        uint32_t first_bone;
+        uint32_t bone_count;
+        // Of vec::transform3 and vec::fmat4, one per bone
+        range default_transforms;
+        range inverse_bind_matrices;
+    };
+
+    struct bone
+    {
+        string name;
+        uint32_t child;
+        uint32_t peer;
+        uint32_t parent;
+        uint32_t reserved;
+    };
+
+    // Samplers, inputs and channels are numbered within their animation
+    struct animation
+    {
+        string name;
+        uint32_t first_sampler;
+        uint32_t sampler_count;
+        uint32_t first_input;
+        uint32_t input_count;
+    };
+
+    struct sampler
+    {
+        // Index of the alternative in skel::animation_sampler
+        uint32_t kind;
+        uint32_t count;
+        range output;
+    };
+
+    // Keyframe times shared by the channels that follow them
+    struct input
+    {
+        range times;
+        uint32_t first_channel;
+        uint32_t channel_count;
+    };
+
+    struct channel
+    {
+        string bone;
+        enum gltf::animation_channel_path path;
+        uint32_t sampler;
+    };
+
+    template <typename T> class table
+    {
+        const T *first = nullptr;
+        size_t count = 0;
+
+      public:
+        table() {}
+        table(const T *_first, size_t _count) : first(_first), count(_count)
+        {
+        }
+        const T *begin() const
+        {
+            return first;
+        }
+        const T *end() const
+        {
+            return first + count;
+        }
+        size_t size() const
+        {
+            return count;
+        }
+        const T &operator[](size_t index) const
+        {
+            return first[index];
+        }
+    };
+
+  private:
+    filesystem::mapping contents;
+
+    template <typename T> table<T> records(enum section section) const;
+
+  public:
+    const std::string path;
+
+    baked(const std::string &path);
+
+    // The baked file at path if it exists, is readable by this version and
+    // is current for source
+    static std::optional<baked> open(const std::string &path,
+                                     const std::string &source);
+
+    const struct header &header() const
+    {
+        return *(const struct header *)contents.data();
+    }
+    bool current(const std::string &source) const;
+
+    table<texture> textures() const;
+    table<material> materials() const;
+    table<mesh> meshes() const;
+    table<primitive> primitives() const;
+    table<object> objects() const;
+    table<armature> armatures() const;
+    table<bone> bones() const;
+    table<animation> animations() const;
+    table<sampler> samplers() const;
+    table<input> inputs() const;
+    table<channel> channels() const;
+
+    // A name that is absent reads as empty
+    std::string_view name(const string &string) const;
+    const uint8_t *data(const range &range) const
+    {
+        return contents.data() + range.offset;
+    }
+
+    skel::armature load(const armature &armature) const;
+    skel::animation load(const animation &animation) const;
+
+    // Whether gltf refers to no files other than its source, which write
+    // requires
+    static bool self_contained(const gltf::gltf &gltf);
+
+    // Bakes every named texture, material, mesh, object, skin and animation
+    // of gltf, read from source, into a new file at output
+    static void write(const std::string &output,
+                      const std::string &source,
+                      const gltf::gltf &gltf,
+                      enum attributes::arrangement arrangement =
+                          attributes::arrangement::separate);
+
+    static uint64_t hash(engine::memory::const_view bytes);
+};
+
+// The vertex and index arrays of a primitive as they are uploaded
+class vertices
+{
+  public:
+    // Ranges are sizes only, counted from the start of data and indices
+    baked::primitive layout;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> indices;
+
+    vertices(const gltf::mesh_primitive &primitive,
+             enum attributes::arrangement arrangement =
+                 attributes::arrangement::separate);
+};
+} // namespace engine::gpu
+
 namespace engine::gpu::shader
 {
 class program;
@@ -46,11 +403,20 @@ class asset
     {
         uint32_t id = 0;
 
+        void upload(uint32_t width,
+                    uint32_t height,
+                    const void *pixels,
+                    enum gltf::min_filter min_filter,
+                    enum gltf::mag_filter mag_filter,
+                    enum gltf::wrap_mode wrap_s,
+                    enum gltf::wrap_mode wrap_t);
+
       public:
         texture(const texture &) = delete;
         texture &operator=(const texture &) = delete;
         texture(asset::texture &&other) noexcept;
         texture(const gltf::texture &texture);
+        texture(const baked &baked, const baked::texture &texture);
         // texture& operator=(texture&& other) noexcept;
         ~texture();
 
@@ -76,6 +442,9 @@ class asset
         bool double_sided = false;
         float alpha_cutoff = 0.5;
         material(const engine::gpu::asset &, const gltf::material &);
+        material(const engine::gpu::asset &,
+                 const baked &,
+                 const baked::material &);
         void use(engine::gpu::shader::program &program) const;
     };
 
@@ -86,16 +455,30 @@ class asset
         uint32_t ibo = 0;
         uint32_t count = 0;
         bool short_indices = false;
+        baked::lod lods[baked::lod_count] = {};
+
+        void upload(const baked::primitive &layout,
+                    const uint8_t *vertices,
+                    const uint8_t *indices);
 
       public:
         const class material &material;
         float radius = 0;
+        attributes::quantization quantization;
+        primitive(const gpu::asset::material &,
+                  const class gltf::mesh_primitive &,
+                  enum attributes::arrangement);
         primitive(const gpu::asset::material &,
-                  const class gltf::mesh_primitive &);
+                  const baked &,
+                  const baked::primitive &);
         ~primitive();
 
-        void draw() const;
+        void draw(size_t lod = 0) const;
         void bind() const;
+        float error(size_t lod) const
+        {
+            return lods[lod].error;
+        }
 
         primitive(const primitive &) = delete;
         primitive &operator=(const primitive &) = delete;
@@ -109,7 +492,11 @@ class asset
       public:
         float radius;
         mesh(const asset &, const class gltf::mesh &);
-        void draw(engine::gpu::shader::program &) const;
+        mesh(const asset &, const baked &, const baked::mesh &);
+        void draw(engine::gpu::shader::program &, size_t lod = 0) const;
+        // The coarsest level of detail whose primitives all stray no further
+        // than error, in the units of their positions
+        size_t lod(float error) const;
 
         mesh(const mesh &) = delete;
         mesh &operator=(const mesh &) = delete;
@@ -124,6 +511,7 @@ class asset
         std::string skin_name;
 
         object(const asset &, const gltf::node &);
+        object(const asset &, const baked &, const baked::object &);
         void draw(engine::gpu::shader::program &) const;
     };
 
@@ -133,9 +521,29 @@ class asset
     std::unordered_map<std::string, skel::animation> animations;
     std::unordered_map<std::string, mesh> meshes;
     std::unordered_map<std::string, object> objects;
+    // Of the vertex buffers of every primitive
+    enum attributes::arrangement arrangement;
+
+  private:
+    void load(const gltf::gltf &gltf);
+    void load(const baked &baked);
 
-    asset(const gltf::gltf &gltf);
+  public:
+    asset(const gltf::gltf &gltf,
+          enum attributes::arrangement arrangement =
+              attributes::arrangement::separate);
+    asset(const baked &baked);
     asset(const std::string &path, gltf::gltf_cache &cache);
+    // Loads from the baked file at baked_path when it is current for source
+    // and arranged as asked, otherwise from cache, baking it for next time.
+    // Without a baked_path, or for a source that is not self_contained, it
+    // always loads from cache.
+    asset(const std::string &path,
+          gltf::gltf_cache &cache,
+          const std::string &source,
+          const std::string &baked_path,
+          enum attributes::arrangement arrangement =
+              attributes::arrangement::separate);
 
     void draw(const std::string &mesh_name,
               engine::gpu::shader::program &) const;
@@ -208,28 +616,53 @@ class skin
 
 namespace engine::gpu::cache
 {
-class asset : public filesystem::cache<engine::gpu::asset, gltf::gltf_cache &>
+class asset_base : public filesystem::cache<engine::gpu::asset,
+                                            gltf::gltf_cache &,
+                                            const std::string &,
+                                            const std::string &,
+                                            enum attributes::arrangement>
 {
     gltf::gltf_cache &fs_gltf;
+    const std::string bake_directory;
+    const enum attributes::arrangement arrangement;
 
   protected:
     reference load(const std::string &path_rel,
                    const std::string &path_abs,
                    std::filesystem::file_time_type mtime) override
     {
-        return std::make_shared<engine::gpu::cache::asset::file>(path_rel,
-                                                                 mtime,
-                                                                 fs_gltf);
+        const std::string baked_path =
+            bake_directory.empty() ? ""
+                                   : bake_directory + "/" + path_rel + ".baked";
+        return std::make_shared<file>(
+            path_rel, mtime, fs_gltf, path_abs, baked_path, arrangement);
     }
     std::filesystem::file_time_type get_mtime(const std::string &path) override;
+    // GL objects can only be created on the context's thread
+    bool background_reload() override
+    {
+        return false;
+    }
 
   public:
-    asset(class engine::filesystem::whitelist &wl, gltf::gltf_cache &_fs_gltf)
-        : engine::filesystem::cache<engine::gpu::asset, gltf::gltf_cache &>(wl),
-          fs_gltf(_fs_gltf)
+    // Assets are baked into bake_directory, if given, and loaded from there
+    // while their source is unchanged. Their vertices are arranged as given.
+    asset_base(class engine::filesystem::whitelist &wl,
+               gltf::gltf_cache &_fs_gltf,
+               const std::string &_bake_directory = "",
+               enum attributes::arrangement _arrangement =
+                   attributes::arrangement::separate)
+        : engine::filesystem::cache<engine::gpu::asset,
+                                    gltf::gltf_cache &,
+                                    const std::string &,
+                                    const std::string &,
+                                    enum attributes::arrangement>(wl),
+          fs_gltf(_fs_gltf), bake_directory(_bake_directory),
+          arrangement(_arrangement)
     {
     }
 };
+using asset = filesystem::drained<asset_base>;
 } // namespace engine::gpu::cache
 
 namespace engine::gpu::exception
@@ -260,7 +693,7 @@ class vertex : public shader
 {
   public:
     vertex(const std::string &source);
-    vertex(const engine::memory::allocation &source);
+    vertex(engine::memory::const_view source);
     vertex(engine::filesystem::cache_binary &fs, const std::string &path);
 };
 
@@ -268,7 +701,7 @@ class fragment : public shader
 {
   public:
     fragment(std::string source);
-    fragment(const engine::memory::allocation &source);
+    fragment(engine::memory::const_view source);
     fragment(engine::filesystem::cache_binary &fs, const std::string &path);
 };
 
@@ -284,6 +717,10 @@ class program
     int32_t u_normal = -1;
     int32_t u_mvp = -1;
     int32_t u_albedo_tex = -1;
+    int32_t u_position_offset = -1;
+    int32_t u_position_scale = -1;
+    int32_t u_texcoord_offset = -1;
+    int32_t u_texcoord_scale = -1;
 
     size_t skin_bone_count = 0;
 
@@ -309,6 +746,7 @@ class program
     void set_view_perspective(const vec::transform3 &,
                               const vec::perspective &);
     void set_albedo_texture(const asset::texture &) const;
+    void set_quantization(const attributes::quantization &) const;
 };
 
 } // namespace engine::gpu::shader
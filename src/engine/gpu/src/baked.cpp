@@ -0,0 +1,1158 @@
+#include <engine/gpu.hpp>
+#include <engine/mesh.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+uint64_t align(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Records, names and data of a baked file as it is built. Data comes right
+// after the header, then the records of each section, then the names.
+class builder
+{
+    using section = engine::gpu::baked::section;
+    static constexpr size_t section_count = engine::gpu::baked::section_count;
+    static constexpr size_t alignment = engine::gpu::baked::alignment;
+
+    const uint64_t data_offset =
+        align(sizeof(struct engine::gpu::baked::header), alignment);
+    std::string data;
+    std::string sections[section_count];
+
+  public:
+    engine::gpu::baked::string name(std::string_view name)
+    {
+        std::string &names = sections[(size_t)section::names];
+        engine::gpu::baked::string result = {(uint32_t)names.size(),
+                                             (uint32_t)name.size()};
+        names += name;
+        return result;
+    }
+
+    engine::gpu::baked::range append(const void *bytes, size_t size)
+    {
+        data.resize(align(data.size(), alignment));
+        engine::gpu::baked::range result = {data_offset + data.size(), size};
+        data.append((const char *)bytes, size);
+        return result;
+    }
+
+    template <typename T> uint32_t size(section which) const
+    {
+        return sections[(size_t)which].size() / sizeof(T);
+    }
+
+    template <typename T> void add(section which, const T &record)
+    {
+        sections[(size_t)which].append((const char *)&record, sizeof(T));
+    }
+
+    void write(const std::string &output,
+               struct engine::gpu::baked::header &header) const
+    {
+        const std::filesystem::path parent =
+            std::filesystem::path(output).parent_path();
+        if (!parent.empty())
+            std::filesystem::create_directories(parent);
+
+        // Named for this process and write, so bakes of the same asset
+        // running side by side do not write into each other's file
+        static std::atomic<uint64_t> writes = 0;
+        const std::string temporary = output + "." +
+                                      std::to_string(getpid()) + "." +
+                                      std::to_string(writes++) + ".tmp";
+        std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+
+        if (!stream)
+            throw engine::gpu::exception::base("Could not create " +
+                                               temporary);
+
+        uint64_t offset = data_offset + data.size();
+
+        for (size_t i = 0; i < section_count; i++)
+        {
+            offset = align(offset, alignment);
+            header.sections[i] = {offset, sections[i].size()};
+            offset += sections[i].size();
+        }
+
+        stream.write((const char *)&header, sizeof(header));
+        stream.write(std::string(data_offset - sizeof(header), '\0').data(),
+                     data_offset - sizeof(header));
+        stream.write(data.data(), data.size());
+
+        offset = data_offset + data.size();
+
+        for (size_t i = 0; i < section_count; i++)
+        {
+            stream.write(
+                std::string(header.sections[i].offset - offset, '\0').data(),
+                header.sections[i].offset - offset);
+            stream.write(sections[i].data(), sections[i].size());
+            offset = header.sections[i].offset + sections[i].size();
+        }
+
+        stream.close();
+
+        std::error_code error;
+        if (stream)
+            std::filesystem::rename(temporary, output, error);
+
+        if (!stream || error)
+        {
+            std::filesystem::remove(temporary, error);
+            throw engine::gpu::exception::base("Could not write " + output);
+        }
+    }
+};
+
+template <typename T>
+engine::gpu::baked::string texture_name(builder &builder,
+                                        const std::optional<T> &info)
+{
+    if (!info)
+        return {engine::gpu::baked::absent, 0};
+    return builder.name(info->texture.name);
+}
+
+void bake_armature(builder &builder,
+                   const std::string &name,
+                   const skel::armature &armature)
+{
+    using baked = engine::gpu::baked;
+
+    baked::armature record = {};
+    record.name = builder.name(name);
+    record.root_name = builder.name(armature.root_name);
+    record.first_bone = builder.size<baked::bone>(baked::section::bones);
+    record.bone_count = armature.bones.size();
+    record.default_transforms =
+        builder.append(armature.default_transforms.data(),
+                       armature.default_transforms.size() *
+                           sizeof(vec::transform3));
+    record.inverse_bind_matrices =
+        builder.append(armature.inverse_bind_matrices.data(),
+                       armature.inverse_bind_matrices.size() *
+                           sizeof(vec::fmat4));
+
+    for (const skel::armature_bone &bone : armature.bones)
+    {
+        baked::bone bone_record = {};
+        bone_record.name = builder.name(bone.name);
+        bone_record.child = bone.child;
+        bone_record.peer = bone.peer;
+        bone_record.parent = bone.parent;
+        builder.add(baked::section::bones, bone_record);
+    }
+
+    builder.add(baked::section::armatures, record);
+}
+
+void bake_animation(builder &builder,
+                    const std::string &name,
+                    const skel::animation &animation)
+{
+    using baked = engine::gpu::baked;
+
+    const std::vector<skel::animation_sampler> &samplers =
+        animation.get_samplers();
+
+    baked::animation record = {};
+    record.name = builder.name(name);
+    record.first_sampler =
+        builder.size<baked::sampler>(baked::section::samplers);
+    record.sampler_count = samplers.size();
+    record.first_input = builder.size<baked::input>(baked::section::inputs);
+    record.input_count = animation.times.size();
+
+    for (const skel::animation_sampler &sampler : samplers)
+    {
+        baked::sampler sampler_record = {};
+        sampler_record.kind = sampler.index();
+        std::visit(
+            [&](const auto &alternative)
+            {
+                const auto &output = alternative.get_output();
+                sampler_record.count = output.size();
+                sampler_record.output = builder.append(
+                    output.data(), output.size() * sizeof(output[0]));
+            },
+            sampler);
+        builder.add(baked::section::samplers, sampler_record);
+    }
+
+    for (const skel::animation_times &times : animation.times)
+    {
+        baked::input input_record = {};
+        input_record.times = builder.append(
+            times.input.data(), times.input.size() * sizeof(float));
+        input_record.first_channel =
+            builder.size<baked::channel>(baked::section::channels);
+
+        for (const auto &[bone, channels] : times.bones)
+        {
+            for (const skel::animation_channel &channel : channels)
+            {
+                baked::channel channel_record = {};
+                channel_record.bone = builder.name(bone);
+                channel_record.path = channel.path;
+                channel_record.sampler = &channel.sampler - samplers.data();
+                builder.add(baked::section::channels, channel_record);
+                input_record.channel_count++;
+            }
+        }
+
+        builder.add(baked::section::inputs, input_record);
+    }
+
+    builder.add(baked::section::animations, record);
+}
+
+// Bytes of one output element of each alternative of skel::animation_sampler
+constexpr size_t sampler_element_sizes[] = {
+    sizeof(vec::fvec3),
+    sizeof(vec::fvec4),
+    sizeof(vec::fvec3),
+    sizeof(vec::fvec4),
+    sizeof(vec::cubicspline<vec::fvec3>),
+    sizeof(vec::cubicspline<vec::fvec4>),
+};
+static_assert(std::size(sampler_element_sizes) ==
+              std::variant_size_v<skel::animation_sampler>);
+
+template <typename S, typename T>
+skel::animation_sampler load_sampler(const engine::gpu::baked &baked,
+                                     const engine::gpu::baked::sampler &sampler)
+{
+    const T *output = (const T *)baked.data(sampler.output);
+    return S(std::vector<T>(output, output + sampler.count));
+}
+} // namespace
+
+// Interleaved vertices converted at a time
+static const size_t vertex_block = 256;
+
+static uint16_t quantize(float value, float offset, float scale)
+{
+    if (scale <= 0)
+        return 0;
+    return (uint16_t)std::min((value - offset) / scale * 65535.0f + 0.5f,
+                              65535.0f);
+}
+
+static float dequantize(uint16_t value, float offset, float scale)
+{
+    return offset + scale * (value / 65535.0f);
+}
+
+engine::gpu::attributes::position engine::gpu::attributes::quantization::
+    quantize(const vec::fvec3 &value) const
+{
+    return position(::quantize(value.x, position_offset.x, position_scale.x),
+                    ::quantize(value.y, position_offset.y, position_scale.y),
+                    ::quantize(value.z, position_offset.z, position_scale.z));
+}
+
+engine::gpu::attributes::texcoord engine::gpu::attributes::quantization::
+    quantize(const vec::fvec2 &value) const
+{
+    return texcoord(::quantize(value.x, texcoord_offset.x, texcoord_scale.x),
+                    ::quantize(value.y, texcoord_offset.y, texcoord_scale.y));
+}
+
+vec::fvec3 engine::gpu::attributes::quantization::dequantize(
+    const position &value) const
+{
+    return vec::fvec3(
+        ::dequantize(value.x, position_offset.x, position_scale.x),
+        ::dequantize(value.y, position_offset.y, position_scale.y),
+        ::dequantize(value.z, position_offset.z, position_scale.z));
+}
+
+vec::fvec2 engine::gpu::attributes::quantization::dequantize(
+    const texcoord &value) const
+{
+    return vec::fvec2(
+        ::dequantize(value.x, texcoord_offset.x, texcoord_scale.x),
+        ::dequantize(value.y, texcoord_offset.y, texcoord_scale.y));
+}
+
+// Reads count elements of accessor as floats, and the least of each of their
+// N components and how far the greatest is beyond it
+template <typename V, size_t N>
+static std::vector<V> read_range(const gltf::accessor &accessor,
+                                 size_t count,
+                                 V &offset,
+                                 V &scale)
+{
+    std::vector<V> values(count);
+    accessor.dump((uint8_t *)values.data(),
+                  sizeof(V),
+                  0,
+                  count,
+                  gltf::component_type::FLOAT,
+                  (gltf::attribute_type)N);
+    if (values.empty())
+        return values;
+
+    V high = values[0];
+    offset = values[0];
+    for (const V &value : values)
+    {
+        for (size_t c = 0; c < N; c++)
+        {
+            (&offset.x)[c] = std::min((&offset.x)[c], (&value.x)[c]);
+            (&high.x)[c] = std::max((&high.x)[c], (&value.x)[c]);
+        }
+    }
+    scale = high - offset;
+    return values;
+}
+
+// Appends to the triangles of a primitive coarser levels of detail, each
+// simplified from the one before to half as many triangles, until a level
+// keeps nearly all the triangles of the last. Errors add up from level to
+// level, bounding how far each strays from the full primitive.
+static void add_lods(std::vector<uint32_t> &list,
+                     const std::vector<vec::fvec3> &positions,
+                     engine::gpu::baked::lod *lods)
+{
+    std::vector<uint32_t> level(list);
+    size_t lod = 1;
+
+    for (; lod < engine::gpu::baked::lod_count; lod++)
+    {
+        engine::mesh::simplification simpler = engine::mesh::simplify(
+            level, positions, level.size() / 2, INFINITY);
+        if (simpler.indices.empty() ||
+            simpler.indices.size() * 10 > level.size() * 9)
+            break;
+
+        engine::mesh::optimize_cache(simpler.indices, positions.size());
+        lods[lod] = {(uint32_t)list.size(),
+                     (uint32_t)simpler.indices.size(),
+                     lods[lod - 1].error + simpler.error};
+        list.insert(list.end(), simpler.indices.begin(), simpler.indices.end());
+        level.swap(simpler.indices);
+    }
+
+    for (; lod < engine::gpu::baked::lod_count; lod++)
+        lods[lod] = lods[lod - 1];
+}
+
+engine::gpu::vertices::vertices(const gltf::mesh_primitive &input,
+                                enum attributes::arrangement arrangement)
+    : layout()
+{
+    const gltf::accessor *const accessors[attributes::count] = {
+        input.attributes.position,
+        input.attributes.normal,
+        input.attributes.tangent,
+        input.attributes.texcoord_0,
+        input.attributes.joints,
+        input.attributes.weights,
+    };
+
+    // Attributes of one vertex lie stride bytes apart, or tightly packed in
+    // arrays one after another when separate
+    std::optional<size_t> vertex_count;
+    size_t end = 0;
+
+    for (size_t index = 0; index < attributes::count; index++)
+    {
+        const gltf::accessor *accessor = accessors[index];
+        const attributes::layout &attribute = attributes::layouts[index];
+
+        if (!accessor)
+        {
+            layout.offsets[index] = baked::absent;
+            continue;
+        }
+
+        if (vertex_count && accessor->count != *vertex_count)
+            throw engine::gpu::exception::base(
+                "Attributes of a primitive differ in count");
+        vertex_count = accessor->count;
+
+        if (accessor->component_type != gltf::component_type::FLOAT &&
+            !attribute.normalized)
+            layout.integer_mask |= 1 << index;
+
+        layout.offsets[index] = end;
+        if (arrangement == attributes::arrangement::interleaved)
+            end += (attribute.size() + 3) & ~(size_t)3;
+        else
+            end += accessor->count * attribute.size();
+    }
+
+    if (arrangement == attributes::arrangement::interleaved)
+    {
+        layout.stride = end;
+        data.resize(vertex_count.value_or(0) * layout.stride);
+    }
+    else
+        data.resize(end);
+
+    // Vertices are filled a block at a time, so that interleaved ones are
+    // written while they are still in cache
+    const size_t total = vertex_count.value_or(0);
+    const size_t block = layout.stride ? vertex_block : total;
+
+    // Positions and texture coordinates are read whole first, for the range
+    // their shorts are spread over
+    attributes::quantization &quantization = layout.quantization;
+    std::vector<vec::fvec3> positions;
+    std::vector<vec::fvec2> texcoords;
+    if (input.attributes.position)
+        positions = read_range<vec::fvec3, 3>(*input.attributes.position,
+                                              total,
+                                              quantization.position_offset,
+                                              quantization.position_scale);
+    if (input.attributes.texcoord_0)
+        texcoords = read_range<vec::fvec2, 2>(*input.attributes.texcoord_0,
+                                              total,
+                                              quantization.texcoord_offset,
+                                              quantization.texcoord_scale);
+
+    for (size_t first = 0; first < total; first += block)
+    {
+        const size_t length = std::min(block, total - first);
+
+        for (size_t index = 0; index < attributes::count; index++)
+        {
+            const attributes::layout &attribute = attributes::layouts[index];
+            const size_t stride =
+                layout.stride ? layout.stride : attribute.size();
+
+            if (!accessors[index])
+                continue;
+
+            // Positions and texture coordinates are quantized over their
+            // range rather than converted as the accessor holds them
+            uint8_t *out =
+                data.data() + layout.offsets[index] + first * stride;
+            if (index == 0)
+                for (size_t i = 0; i < length; i++)
+                {
+                    const attributes::position position =
+                        quantization.quantize(positions[first + i]);
+                    memcpy((void *)(out + i * stride),
+                           &position,
+                           sizeof(position));
+                }
+            else if (index == 3)
+                for (size_t i = 0; i < length; i++)
+                {
+                    const attributes::texcoord texcoord =
+                        quantization.quantize(texcoords[first + i]);
+                    memcpy((void *)(out + i * stride),
+                           &texcoord,
+                           sizeof(texcoord));
+                }
+            else
+                accessors[index]->dump(out,
+                                       stride,
+                                       first,
+                                       length,
+                                       attribute.component_type,
+                                       attribute.attribute_type);
+        }
+    }
+
+    if (!input.indices && !input.attributes.position)
+        throw engine::gpu::exception::base(
+            "Cannot create GPU primitive without position accessor or "
+            "indices");
+
+    // Primitives without indices get one for each vertex, so that repeated
+    // vertices can be welded into one
+    std::vector<uint32_t> list;
+    if (input.indices)
+        list = *input.indices;
+    else
+    {
+        list.resize(total);
+        for (size_t i = 0; i < total; i++)
+            list[i] = i;
+    }
+
+    size_t kept_count = total;
+
+    if (total)
+    {
+        // Vertices are the same if they convert to the same bytes
+        std::vector<engine::mesh::stream> streams;
+        if (layout.stride)
+            streams.push_back({data.data(), layout.stride, layout.stride});
+        else
+            for (size_t index = 0; index < attributes::count; index++)
+                if (accessors[index])
+                    streams.push_back({data.data() + layout.offsets[index],
+                                       attributes::layouts[index].size(),
+                                       attributes::layouts[index].size()});
+
+        std::vector<uint32_t> order = engine::mesh::weld(list, streams, total);
+
+        // Triangles that share vertices are drawn together so the gpu
+        // transforms each fewer times, then vertices are stored in the order
+        // those triangles first fetch them
+        if (input.mode == gltf::mesh_primitive::mode::TRIANGLES)
+        {
+            engine::mesh::optimize_cache(list, order.size());
+            std::vector<uint32_t> fetch =
+                engine::mesh::optimize_fetch(list, order.size());
+            for (uint32_t &vertex : fetch)
+                vertex = order[vertex];
+            order.swap(fetch);
+        }
+
+        kept_count = order.size();
+        std::vector<uint8_t> kept(data.size() / total * kept_count);
+
+        if (layout.stride)
+            engine::mesh::gather(kept.data(),
+                                 data.data(),
+                                 layout.stride,
+                                 order);
+        else
+        {
+            size_t end = 0;
+            for (size_t index = 0; index < attributes::count; index++)
+            {
+                if (!accessors[index])
+                    continue;
+
+                const size_t size = attributes::layouts[index].size();
+                engine::mesh::gather(kept.data() + end,
+                                     data.data() + layout.offsets[index],
+                                     size,
+                                     order);
+                layout.offsets[index] = end;
+                end += kept_count * size;
+            }
+        }
+
+        data.swap(kept);
+    }
+
+    // Positions as the gpu reads them back, for levels of detail and the
+    // radius
+    positions.clear();
+    if (input.attributes.position)
+    {
+        const size_t stride =
+            layout.stride ? layout.stride : sizeof(attributes::position);
+        const uint8_t *first = data.data() + layout.offsets[0];
+
+        positions.resize(kept_count);
+        for (size_t i = 0; i < kept_count; i++)
+        {
+            attributes::position position;
+            memcpy((void *)&position,
+                   first + i * stride,
+                   sizeof(attributes::position));
+            positions[i] = quantization.dequantize(position);
+        }
+    }
+
+    layout.lods[0] = {0, (uint32_t)list.size(), 0};
+    if (input.mode == gltf::mesh_primitive::mode::TRIANGLES &&
+        !positions.empty())
+        add_lods(list, positions, layout.lods);
+    else
+        std::fill(layout.lods + 1,
+                  layout.lods + baked::lod_count,
+                  layout.lods[0]);
+
+    layout.count = list.size();
+
+    if (!list.empty())
+    {
+        layout.short_indices = *std::max_element(list.begin(), list.end()) <
+                               std::numeric_limits<uint16_t>::max();
+
+        if (layout.short_indices)
+        {
+            indices.resize(list.size() * sizeof(uint16_t));
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                const uint16_t index = list[i];
+                memcpy(indices.data() + i * sizeof(index),
+                       &index,
+                       sizeof(index));
+            }
+        }
+        else
+        {
+            indices.resize(list.size() * sizeof(uint32_t));
+            memcpy(indices.data(), list.data(), indices.size());
+        }
+    }
+
+    layout.vertices.size = data.size();
+    layout.indices.size = indices.size();
+
+    for (const vec::fvec3 &position : positions)
+    {
+        float length = vec::length(position);
+        if (layout.radius < length)
+            layout.radius = length;
+    }
+}
+
+engine::gpu::baked::baked(const std::string &_path)
+    : contents(_path), path(_path)
+{
+    if (contents.size() < sizeof(struct header))
+        throw engine::gpu::exception::base("Not a baked asset: " + path);
+
+    if (memcmp(header().magic, magic, sizeof(magic)) != 0)
+        throw engine::gpu::exception::base("Not a baked asset: " + path);
+
+    if (header().version != version)
+        throw engine::gpu::exception::base(
+            "Unsupported baked asset version " +
+            std::to_string(header().version) + ": " + path);
+
+    const size_t record_sizes[section_count] = {
+        sizeof(texture),
+        sizeof(material),
+        sizeof(mesh),
+        sizeof(primitive),
+        sizeof(object),
+        sizeof(armature),
+        sizeof(bone),
+        sizeof(animation),
+        sizeof(sampler),
+        sizeof(input),
+        sizeof(channel),
+        1,
+    };
+
+    const auto corrupt = [this]()
+    { return engine::gpu::exception::base("Corrupt baked asset: " + path); };
+
+    const auto check_range = [&](const range &range, size_t element_size)
+    {
+        if (range.offset > contents.size() ||
+            range.size > contents.size() - range.offset ||
+            range.offset % alignof(uint32_t) != 0 ||
+            range.size % element_size != 0)
+            throw corrupt();
+    };
+
+    for (size_t i = 0; i < section_count; i++)
+    {
+        check_range(header().sections[i], record_sizes[i]);
+        if (header().sections[i].offset % alignof(uint64_t) != 0)
+            throw corrupt();
+    }
+
+    const uint64_t names_size =
+        header().sections[(size_t)section::names].size;
+
+    const auto check_string = [&](const string &string)
+    {
+        if (string.offset != absent &&
+            (string.offset > names_size ||
+             string.length > names_size - string.offset))
+            throw corrupt();
+    };
+
+    const auto check_slice = [&](uint32_t first, uint32_t count, size_t size)
+    {
+        if (first > size || count > size - first)
+            throw corrupt();
+    };
+
+    for (const texture &texture : textures())
+    {
+        check_string(texture.name);
+        check_range(texture.pixels, 1);
+        if (texture.pixels.size != (uint64_t)texture.width * texture.height *
+                                       sizeof(engine::image::rgba32::pixel))
+            throw corrupt();
+    }
+
+    for (const material &material : materials())
+        for (const string &string : {material.name,
+                                     material.normal_texture,
+                                     material.occlusion_texture,
+                                     material.emissive_texture,
+                                     material.base_color_texture,
+                                     material.metallic_roughness_texture})
+            check_string(string);
+
+    for (const mesh &mesh : meshes())
+    {
+        check_string(mesh.name);
+        check_slice(mesh.first_primitive,
+                    mesh.primitive_count,
+                    primitives().size());
+    }
+
+    for (const primitive &primitive : primitives())
+    {
+        check_string(primitive.material);
+        check_range(primitive.vertices, 1);
+        const size_t index_size =
+            primitive.short_indices ? sizeof(uint16_t) : sizeof(uint32_t);
+        check_range(primitive.indices, index_size);
+        for (uint32_t offset : primitive.offsets)
+            if (offset != absent && offset > primitive.vertices.size)
+                throw corrupt();
+        if (primitive.indices.size &&
+            primitive.indices.size != primitive.count * index_size)
+            throw corrupt();
+        for (const lod &lod : primitive.lods)
+            check_slice(lod.first, lod.count, primitive.count);
+    }
+
+    for (const object &object : objects())
+        for (const string &string : {object.name, object.mesh, object.skin})
+            check_string(string);
+
+    for (const armature &armature : armatures())
+    {
+        check_string(armature.name);
+        check_string(armature.root_name);
+        check_slice(armature.first_bone, armature.bone_count, bones().size());
+        check_range(armature.default_transforms, sizeof(vec::transform3));
+        check_range(armature.inverse_bind_matrices, sizeof(vec::fmat4));
+        if (armature.bone_count > skel::max_bones ||
+            armature.default_transforms.size !=
+                armature.bone_count * sizeof(vec::transform3) ||
+            armature.inverse_bind_matrices.size !=
+                armature.bone_count * sizeof(vec::fmat4))
+            throw corrupt();
+    }
+
+    for (const bone &bone : bones())
+    {
+        check_string(bone.name);
+        if (bone.child > skel::max_bones || bone.peer > skel::max_bones ||
+            bone.parent > skel::max_bones)
+            throw corrupt();
+    }
+
+    for (const animation &animation : animations())
+    {
+        check_string(animation.name);
+        check_slice(animation.first_sampler,
+                    animation.sampler_count,
+                    samplers().size());
+        check_slice(animation.first_input,
+                    animation.input_count,
+                    inputs().size());
+
+        for (uint32_t i = 0; i < animation.input_count; i++)
+        {
+            const input &input = inputs()[animation.first_input + i];
+            check_slice(input.first_channel,
+                        input.channel_count,
+                        channels().size());
+            for (uint32_t j = 0; j < input.channel_count; j++)
+                if (channels()[input.first_channel + j].sampler >=
+                    animation.sampler_count)
+                    throw corrupt();
+        }
+    }
+
+    for (const sampler &sampler : samplers())
+    {
+        if (sampler.kind >= std::size(sampler_element_sizes))
+            throw corrupt();
+        check_range(sampler.output, sampler_element_sizes[sampler.kind]);
+        if (sampler.output.size !=
+            sampler.count * sampler_element_sizes[sampler.kind])
+            throw corrupt();
+    }
+
+    for (const input &input : inputs())
+        check_range(input.times, sizeof(float));
+
+    for (const channel &channel : channels())
+        check_string(channel.bone);
+}
+
+std::optional<engine::gpu::baked>
+engine::gpu::baked::open(const std::string &path, const std::string &source)
+{
+    if (!std::filesystem::is_regular_file(path))
+        return std::nullopt;
+
+    try
+    {
+        std::optional<baked> result(std::in_place, path);
+        if (result->current(source))
+            return result;
+    }
+    catch (engine::exception &)
+    {
+    }
+
+    return std::nullopt;
+}
+
+bool engine::gpu::baked::current(const std::string &source) const
+{
+    std::error_code error;
+
+    const uint64_t size = std::filesystem::file_size(source, error);
+    if (error || size != header().source_size)
+        return false;
+
+    const std::filesystem::file_time_type mtime =
+        std::filesystem::last_write_time(source, error);
+    if (error)
+        return false;
+
+    if (mtime.time_since_epoch().count() == header().source_mtime)
+        return true;
+
+    // Only the time changed. The baked file stays as it is, since it may be
+    // mapped elsewhere, so the next open hashes the source again.
+    return hash(filesystem::mapping(source)) == header().source_hash;
+}
+
+template <typename T>
+engine::gpu::baked::table<T>
+engine::gpu::baked::records(enum section section) const
+{
+    const range &range = header().sections[(size_t)section];
+    return table<T>((const T *)data(range), range.size / sizeof(T));
+}
+
+engine::gpu::baked::table<engine::gpu::baked::texture>
+engine::gpu::baked::textures() const
+{
+    return records<texture>(section::textures);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::material>
+engine::gpu::baked::materials() const
+{
+    return records<material>(section::materials);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::mesh>
+engine::gpu::baked::meshes() const
+{
+    return records<mesh>(section::meshes);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::primitive>
+engine::gpu::baked::primitives() const
+{
+    return records<primitive>(section::primitives);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::object>
+engine::gpu::baked::objects() const
+{
+    return records<object>(section::objects);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::armature>
+engine::gpu::baked::armatures() const
+{
+    return records<armature>(section::armatures);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::bone>
+engine::gpu::baked::bones() const
+{
+    return records<bone>(section::bones);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::animation>
+engine::gpu::baked::animations() const
+{
+    return records<animation>(section::animations);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::sampler>
+engine::gpu::baked::samplers() const
+{
+    return records<sampler>(section::samplers);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::input>
+engine::gpu::baked::inputs() const
+{
+    return records<input>(section::inputs);
+}
+
+engine::gpu::baked::table<engine::gpu::baked::channel>
+engine::gpu::baked::channels() const
+{
+    return records<channel>(section::channels);
+}
+
+std::string_view engine::gpu::baked::name(const string &string) const
+{
+    if (string.offset == absent)
+        return std::string_view();
+
+    const range &names = header().sections[(size_t)section::names];
+    return std::string_view((const char *)data(names) + string.offset,
+                            string.length);
+}
+
+skel::armature engine::gpu::baked::load(const armature &armature) const
+{
+    std::vector<skel::armature_bone> loaded_bones;
+    loaded_bones.reserve(armature.bone_count);
+
+    for (uint32_t i = 0; i < armature.bone_count; i++)
+    {
+        const bone &bone = bones()[armature.first_bone + i];
+        loaded_bones.emplace_back(std::string(name(bone.name)),
+                                  bone.child,
+                                  bone.peer,
+                                  bone.parent);
+    }
+
+    const vec::transform3 *transforms =
+        (const vec::transform3 *)data(armature.default_transforms);
+    const vec::fmat4 *matrices =
+        (const vec::fmat4 *)data(armature.inverse_bind_matrices);
+
+    return skel::armature(
+        std::string(name(armature.root_name)),
+        std::move(loaded_bones),
+        std::vector<vec::transform3>(transforms,
+                                     transforms + armature.bone_count),
+        std::vector<vec::fmat4>(matrices, matrices + armature.bone_count));
+}
+
+skel::animation engine::gpu::baked::load(const animation &animation) const
+{
+    using vec::cubicspline;
+    using vec::fvec3;
+    using vec::fvec4;
+
+    std::vector<skel::animation_sampler> loaded_samplers;
+    loaded_samplers.reserve(animation.sampler_count);
+
+    for (uint32_t i = 0; i < animation.sampler_count; i++)
+    {
+        const sampler &sampler = samplers()[animation.first_sampler + i];
+
+        switch (sampler.kind)
+        {
+        case 0:
+            loaded_samplers.push_back(
+                load_sampler<skel::animation_sampler_step<fvec3>, fvec3>(
+                    *this, sampler));
+            break;
+        case 1:
+            loaded_samplers.push_back(
+                load_sampler<skel::animation_sampler_step<fvec4>, fvec4>(
+                    *this, sampler));
+            break;
+        case 2:
+            loaded_samplers.push_back(
+                load_sampler<skel::animation_sampler_linear<fvec3>, fvec3>(
+                    *this, sampler));
+            break;
+        case 3:
+            loaded_samplers.push_back(
+                load_sampler<skel::animation_sampler_linear<fvec4>, fvec4>(
+                    *this, sampler));
+            break;
+        case 4:
+            loaded_samplers.push_back(
+                load_sampler<skel::animation_sampler_cubicspline<fvec3>,
+                             cubicspline<fvec3>>(*this, sampler));
+            break;
+        default:
+            loaded_samplers.push_back(
+                load_sampler<skel::animation_sampler_cubicspline<fvec4>,
+                             cubicspline<fvec4>>(*this, sampler));
+            break;
+        }
+    }
+
+    skel::animation result(std::move(loaded_samplers));
+    result.times.reserve(animation.input_count);
+
+    for (uint32_t i = 0; i < animation.input_count; i++)
+    {
+        const input &input = inputs()[animation.first_input + i];
+        const float *times = (const float *)data(input.times);
+        const size_t count = input.times.size / sizeof(float);
+
+        result.times.emplace_back(std::vector<float>(times, times + count));
+
+        for (uint32_t j = 0; j < input.channel_count; j++)
+        {
+            const channel &channel = channels()[input.first_channel + j];
+            result.add_channel(i,
+                               std::string(name(channel.bone)),
+                               channel.path,
+                               channel.sampler);
+        }
+    }
+
+    return result;
+}
+
+bool engine::gpu::baked::self_contained(const gltf::gltf &gltf)
+{
+    for (const gltf::buffer &buffer : gltf.buffers)
+        if (!buffer.uri.empty())
+            return false;
+
+    for (const gltf::image &image : gltf.images)
+        if (!image.uri.empty())
+            return false;
+
+    return true;
+}
+
+void engine::gpu::baked::write(const std::string &output,
+                               const std::string &source,
+                               const gltf::gltf &gltf,
+                               enum attributes::arrangement arrangement)
+{
+    if (!self_contained(gltf))
+        throw engine::gpu::exception::base(
+            "Cannot bake an asset that refers to other files: " + source);
+
+    builder builder;
+
+    for (const gltf::texture &in : gltf.textures)
+    {
+        const engine::image::rgba32 &image = in.source.contents;
+
+        texture record = {};
+        record.name = builder.name(in.name);
+        record.width = image.width;
+        record.height = image.height;
+        record.pixels =
+            builder.append(image.data(),
+                           (size_t)image.width * image.height *
+                               sizeof(engine::image::rgba32::pixel));
+        record.min_filter = in.sampler.min_filter;
+        record.mag_filter = in.sampler.mag_filter;
+        record.wrap_s = in.sampler.wrap_s;
+        record.wrap_t = in.sampler.wrap_t;
+        builder.add(section::textures, record);
+    }
+
+    for (const gltf::material &in : gltf.materials)
+    {
+        if (in.name.empty())
+            continue;
+
+        material record = {};
+        record.name = builder.name(in.name);
+        record.normal_texture = texture_name(builder, in.normal_texture);
+        record.occlusion_texture = texture_name(builder, in.occlusion_texture);
+        record.emissive_texture = texture_name(builder, in.emissive_texture);
+        record.base_color_texture = {absent, 0};
+        record.metallic_roughness_texture = {absent, 0};
+        record.base_color_factor = vec::fvec4(1, 1, 1, 1);
+        record.metallic = 1;
+        record.roughness = 1;
+
+        if (in.pbr_metallic_roughness)
+        {
+            const gltf::pbr_metallic_roughness &pbr =
+                *in.pbr_metallic_roughness;
+            record.base_color_texture =
+                texture_name(builder, pbr.base_color_texture);
+            record.metallic_roughness_texture =
+                texture_name(builder, pbr.metallic_roughness_texture);
+            record.base_color_factor = pbr.base_color_factor;
+            record.metallic = pbr.metallic_factor;
+            record.roughness = pbr.roughness_factor;
+        }
+
+        record.emissive_factor = in.emissive_factor;
+        record.alpha_cutoff = in.alpha_cutoff;
+        record.double_sided = in.double_sided;
+        builder.add(section::materials, record);
+    }
+
+    for (const gltf::skin &in : gltf.skins)
+        if (!in.name.empty())
+            bake_armature(builder, in.name, skel::armature(in, gltf));
+
+    for (const gltf::animation &in : gltf.animations)
+        if (!in.name.empty())
+            bake_animation(builder, in.name, skel::animation(in, gltf));
+
+    for (const gltf::mesh &in : gltf.meshes)
+    {
+        if (in.name.empty())
+            continue;
+
+        mesh record = {};
+        record.name = builder.name(in.name);
+        record.first_primitive = builder.size<primitive>(section::primitives);
+
+        for (const gltf::mesh_primitive &in_primitive : in.primitives)
+        {
+            if (!in_primitive.material || in_primitive.material->name.empty())
+                continue;
+
+            const engine::gpu::vertices vertices(in_primitive, arrangement);
+            primitive primitive_record = vertices.layout;
+            primitive_record.material =
+                builder.name(in_primitive.material->name);
+            primitive_record.vertices =
+                builder.append(vertices.data.data(), vertices.data.size());
+            primitive_record.indices = builder.append(
+                vertices.indices.data(), vertices.indices.size());
+            builder.add(section::primitives, primitive_record);
+            record.primitive_count++;
+        }
+
+        builder.add(section::meshes, record);
+    }
+
+    for (const gltf::node &in : gltf.nodes)
+    {
+        if (in.name.empty() || !in.mesh)
+            continue;
+
+        object record = {};
+        record.name = builder.name(in.name);
+        record.mesh = builder.name(in.mesh->name);
+        record.skin = in.skin ? builder.name(in.skin->name) : string{absent, 0};
+        builder.add(section::objects, record);
+    }
+
+    struct header header = {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.arrangement = arrangement;
+    header.source_size = std::filesystem::file_size(source);
+    header.source_mtime =
+        std::filesystem::last_write_time(source).time_since_epoch().count();
+    header.source_hash = hash(filesystem::mapping(source));
+
+    builder.write(output, header);
+}
+
+// FNV-1a
+uint64_t engine::gpu::baked::hash(engine::memory::const_view bytes)
+{
+    uint64_t result = 0xcbf29ce484222325;
+
+    for (auto byte = bytes.begin; byte != bytes.end; ++byte)
+        result = (result ^ *byte) * 0x100000001b3;
+
+    return result;
+}
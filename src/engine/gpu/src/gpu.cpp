@@ -1,4 +1,5 @@
 #include "engine/memory.hpp"
+#include <algorithm>
 #include <array>
 #include <engine/vec.hpp>
 // #include <cmath>
@@ -16,6 +17,10 @@
 #define UNIFORM_NAME_NORMAL_MAT3 "u_normal"
 #define UNIFORM_NAME_MVP_MAT4 "u_mvp"
 #define UNIFORM_NAME_MATERIAL_ALBEDO_TEX "u_tex_color"
+#define UNIFORM_NAME_POSITION_OFFSET "u_position_offset"
+#define UNIFORM_NAME_POSITION_SCALE "u_position_scale"
+#define UNIFORM_NAME_TEXCOORD_OFFSET "u_texcoord_offset"
+#define UNIFORM_NAME_TEXCOORD_SCALE "u_texcoord_scale"
 
 #define POSE_TEXTURE_UNIT 0
 #define COLOR_TEXTURE_UNIT 1
@@ -42,7 +47,20 @@
         }                                                                      \
     }
 
-engine::gpu::asset::asset(const gltf::gltf &in)
+engine::gpu::asset::asset(const gltf::gltf &in,
+                          enum attributes::arrangement _arrangement)
+    : arrangement(_arrangement)
+{
+    load(in);
+}
+
+engine::gpu::asset::asset(const baked &in)
+    : arrangement(in.header().arrangement)
+{
+    load(in);
+}
+
+void engine::gpu::asset::load(const gltf::gltf &in)
 {
     for (const gltf::texture &in_tex : in.textures)
         textures.emplace(in_tex.name, in_tex);
@@ -71,6 +89,31 @@ engine::gpu::asset::asset(const gltf::gltf &in)
             objects.emplace(in_node.name, object(*this, in_node));
 }
 
+void engine::gpu::asset::load(const baked &in)
+{
+    for (const baked::texture &in_tex : in.textures())
+        textures.try_emplace(std::string(in.name(in_tex.name)), in, in_tex);
+
+    for (const baked::material &in_material : in.materials())
+        materials.emplace(
+            in.name(in_material.name),
+            engine::gpu::asset::material(*this, in, in_material));
+
+    for (const baked::armature &in_armature : in.armatures())
+        armatures.emplace(in.name(in_armature.name), in.load(in_armature));
+
+    for (const baked::animation &in_animation : in.animations())
+        animations.emplace(in.name(in_animation.name), in.load(in_animation));
+
+    for (const baked::mesh &in_mesh : in.meshes())
+        meshes.emplace(in.name(in_mesh.name),
+                       engine::gpu::asset::mesh(*this, in, in_mesh));
+
+    for (const baked::object &in_object : in.objects())
+        objects.emplace(in.name(in_object.name),
+                        object(*this, in, in_object));
+}
+
 engine::gpu::asset::object::object(const asset &parent, const gltf::node &in)
     : mesh(parent.meshes.at(in.mesh->name))
 {
@@ -81,6 +124,18 @@ engine::gpu::asset::object::object(const asset &parent, const gltf::node &in)
     }
 }
 
+engine::gpu::asset::object::object(const asset &parent,
+                                   const baked &baked,
+                                   const baked::object &in)
+    : mesh(parent.meshes.at(std::string(baked.name(in.mesh))))
+{
+    if (in.skin.offset != baked::absent)
+    {
+        skin_name = baked.name(in.skin);
+        skin = &parent.armatures.at(skin_name);
+    }
+}
+
 void engine::gpu::asset::object::draw(
     engine::gpu::shader::program &program) const
 {
@@ -92,6 +147,45 @@ engine::gpu::asset::asset(const std::string &path, gltf::gltf_cache &cache)
 {
 }
 
+engine::gpu::asset::asset(const std::string &path,
+                          gltf::gltf_cache &cache,
+                          const std::string &source,
+                          const std::string &baked_path,
+                          enum attributes::arrangement _arrangement)
+    : arrangement(_arrangement)
+{
+    if (!baked_path.empty())
+    {
+        std::optional<baked> current = baked::open(baked_path, source);
+        if (current && current->header().arrangement == arrangement)
+        {
+            load(*current);
+            return;
+        }
+    }
+
+    gltf::gltf_cache::reference in = cache[path];
+    load(*in);
+
+    if (baked_path.empty() || !baked::self_contained(*in))
+        return;
+
+    // The asset is loaded either way, so a bake that fails only costs the
+    // next start its time
+    try
+    {
+        baked::write(baked_path, source, *in, arrangement);
+    }
+    catch (const engine::exception &e)
+    {
+        std::cerr << "Could not bake " << path << ": " << e.message << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Could not bake " << path << ": " << e.what() << "\n";
+    }
+}
+
 void engine::gpu::asset::draw(const std::string &mesh_name,
                               engine::gpu::shader::program &program) const
 {
@@ -150,6 +244,34 @@ engine::gpu::asset::material::material(const engine::gpu::asset &parent,
     alpha_cutoff = in.alpha_cutoff;
 }
 
+engine::gpu::asset::material::material(const engine::gpu::asset &parent,
+                                       const baked &baked,
+                                       const baked::material &in)
+{
+#define lookup_tex(tname)                                                      \
+    if (in.tname.offset != baked::absent)                                      \
+    {                                                                          \
+        auto it = parent.textures.find(std::string(baked.name(in.tname)));     \
+        if (it != parent.textures.end())                                       \
+            tname = &it->second;                                               \
+    }
+
+    lookup_tex(normal_texture);
+    lookup_tex(occlusion_texture);
+    lookup_tex(emissive_texture);
+    lookup_tex(base_color_texture);
+    lookup_tex(metallic_roughness_texture);
+
+#undef lookup_tex
+
+    base_color_factor = in.base_color_factor;
+    metallic = in.metallic;
+    roughness = in.roughness;
+    emissive_factor = in.emissive_factor;
+    double_sided = in.double_sided;
+    alpha_cutoff = in.alpha_cutoff;
+}
+
 void engine::gpu::asset::material::use(
     engine::gpu::shader::program &program) const
 {
@@ -159,151 +281,98 @@ void engine::gpu::asset::material::use(
 
 engine::gpu::asset::primitive::primitive(
     const gpu::asset::material &_material,
-    const class gltf::mesh_primitive &input)
+    const class gltf::mesh_primitive &input,
+    enum attributes::arrangement arrangement)
     : material(_material)
 {
-    gl_check_error();
+    const engine::gpu::vertices vertices(input, arrangement);
+    upload(vertices.layout, vertices.data.data(), vertices.indices.data());
+}
 
-    struct vertex_attribute
-    {
-        const gltf::accessor *accessor;
-        uint32_t index;
-        bool normalized;
-        gltf::component_type component_type;
-        gltf::attribute_type attribute_type;
-    };
-
-    std::array<vertex_attribute, 6> attributes = {
-        {{.accessor = input.attributes.position,
-          .index = 0,
-          .normalized = false,
-          .component_type = gltf::component_type::FLOAT,
-          .attribute_type = gltf::attribute_type::VEC3},
-         {.accessor = input.attributes.normal,
-          .index = 1,
-          .normalized = true,
-          .component_type = gltf::component_type::SHORT,
-          .attribute_type = gltf::attribute_type::VEC3},
-         {.accessor = input.attributes.tangent,
-          .index = 2,
-          .normalized = true,
-          .component_type = gltf::component_type::SHORT,
-          .attribute_type = gltf::attribute_type::VEC4},
-         {.accessor = input.attributes.texcoord_0,
-          .index = 3,
-          .normalized = true,
-          .component_type = gltf::component_type::FLOAT,
-          .attribute_type = gltf::attribute_type::VEC2},
-         {.accessor = input.attributes.joints,
-          .index = 4,
-          .normalized = false,
-          .component_type = gltf::component_type::UBYTE,
-          .attribute_type = gltf::attribute_type::VEC4},
-         {.accessor = input.attributes.weights,
-          .index = 5,
-          .normalized = true,
-          .component_type = gltf::component_type::UBYTE,
-          .attribute_type = gltf::attribute_type::VEC4}}};
+engine::gpu::asset::primitive::primitive(
+    const gpu::asset::material &_material,
+    const baked &baked,
+    const baked::primitive &input)
+    : material(_material)
+{
+    upload(input, baked.data(input.vertices), baked.data(input.indices));
+}
+
+void engine::gpu::asset::primitive::upload(const baked::primitive &layout,
+                                           const uint8_t *vertices,
+                                           const uint8_t *indices)
+{
+    gl_check_error();
 
     gl_call(glGenBuffers, 1, &vbo);
     gl_call(glGenVertexArrays, 1, &vao);
     gl_call(glBindVertexArray, vao);
 
-    if (input.indices)
+    if (layout.indices.size)
     {
         gl_call(glGenBuffers, 1, &ibo);
         gl_call(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, ibo);
-
-        if (input.indices->count < std::numeric_limits<uint16_t>::max())
-        {
-            std::vector<uint16_t> indices = *input.indices;
-            gl_call(glBufferData,
-                    GL_ELEMENT_ARRAY_BUFFER,
-                    indices.size() * sizeof(uint16_t),
-                    indices.data(),
-                    GL_STATIC_DRAW);
-            short_indices = true;
-        }
-        else
-        {
-            std::vector<uint32_t> indices = *input.indices;
-            gl_call(glBufferData,
-                    GL_ELEMENT_ARRAY_BUFFER,
-                    indices.size() * sizeof(uint32_t),
-                    indices.data(),
-                    GL_STATIC_DRAW);
-            short_indices = false;
-        }
-        count = input.indices->count;
-    }
-    else
-    {
-        if (!input.attributes.position)
-            throw engine::gpu::exception::base(
-                "Cannot create GPU primitive without position accessor or "
-                "indices");
-        count = input.attributes.position->count;
+        gl_call(glBufferData,
+                GL_ELEMENT_ARRAY_BUFFER,
+                layout.indices.size,
+                indices,
+                GL_STATIC_DRAW);
     }
+    count = layout.count;
+    short_indices = layout.short_indices;
+    std::copy(layout.lods, layout.lods + baked::lod_count, lods);
+    quantization = layout.quantization;
 
     gl_call(glBindBuffer, GL_ARRAY_BUFFER, vbo);
 
-    std::vector<uint8_t> vertex_data;
-
-    for (const vertex_attribute &attribute : attributes)
+    for (size_t index = 0; index < attributes::count; index++)
     {
-        if (!attribute.accessor)
+        const attributes::layout &attribute = attributes::layouts[index];
+        const uint32_t offset = layout.offsets[index];
+
+        if (offset == baked::absent)
             continue;
 
-        if (attribute.accessor->component_type == gltf::component_type::FLOAT ||
-            attribute.normalized)
+        if (layout.integer_mask & (1 << index))
         {
-            gl_call(glVertexAttribPointer,
-                    attribute.index,
+            gl_call(glVertexAttribIPointer,
+                    index,
                     (GLint)attribute.attribute_type,
                     (GLenum)attribute.component_type,
-                    attribute.normalized,
-                    0,
-                    (void *)vertex_data.size());
-            gl_call(glEnableVertexAttribArray, attribute.index);
+                    layout.stride,
+                    (void *)(size_t)offset);
         }
         else
         {
-            gl_call(glVertexAttribIPointer,
-                    attribute.index,
+            gl_call(glVertexAttribPointer,
+                    index,
                     (GLint)attribute.attribute_type,
                     (GLenum)attribute.component_type,
-                    0,
-                    (void *)vertex_data.size());
-            gl_call(glEnableVertexAttribArray, attribute.index);
+                    attribute.normalized,
+                    layout.stride,
+                    (void *)(size_t)offset);
         }
-        attribute.accessor->dump(vertex_data,
-                                 attribute.component_type,
-                                 attribute.attribute_type);
+        gl_call(glEnableVertexAttribArray, index);
     }
 
-    gl_call(glBindBuffer, GL_ARRAY_BUFFER, vbo);
     gl_call(glBufferData,
             GL_ARRAY_BUFFER,
-            vertex_data.size(),
-            vertex_data.data(),
+            layout.vertices.size,
+            vertices,
             GL_STATIC_DRAW);
 
     gl_call(glBindVertexArray, 0);
     gl_call(glBindBuffer, GL_ARRAY_BUFFER, 0);
 
-    for (const vec::fvec3 &position :
-         (std::vector<vec::fvec3>)(*input.attributes.position))
-    {
-        float length = vec::length(position);
-        if (radius < length)
-            radius = length;
-    }
+    radius = layout.radius;
 }
 
 engine::gpu::asset::primitive::primitive(primitive &&other) noexcept
     : vao(other.vao), vbo(other.vbo), ibo(other.ibo), count(other.count),
-      short_indices(other.short_indices), material(other.material)
+      short_indices(other.short_indices), material(other.material),
+      radius(other.radius), quantization(other.quantization)
 {
+    std::copy(other.lods, other.lods + baked::lod_count, lods);
     other.vao = 0;
     other.vbo = 0;
     other.ibo = 0;
@@ -328,25 +397,26 @@ void engine::gpu::asset::primitive::bind() const
         gl_call(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, ibo);
 }
 
-void engine::gpu::asset::primitive::draw() const
+void engine::gpu::asset::primitive::draw(size_t lod) const
 {
     if (ibo)
     {
+        const baked::lod &range = lods[lod];
         if (short_indices)
         {
             gl_call(glDrawElements,
                     GL_TRIANGLES,
-                    count,
+                    range.count,
                     GL_UNSIGNED_SHORT,
-                    nullptr);
+                    (void *)(range.first * sizeof(uint16_t)));
         }
         else
         {
             gl_call(glDrawElements,
                     GL_TRIANGLES,
-                    count,
+                    range.count,
                     GL_UNSIGNED_INT,
-                    nullptr);
+                    (void *)(range.first * sizeof(uint32_t)));
         }
     }
     else
@@ -369,7 +439,7 @@ engine::gpu::asset::mesh::mesh(const engine::gpu::asset &parent,
         auto it = parent.materials.find(in_name);
         if (it == parent.materials.end())
             continue;
-        primitives.emplace_back(it->second, in_primitive);
+        primitives.emplace_back(it->second, in_primitive, parent.arrangement);
     }
     for (const engine::gpu::asset::primitive &primitive : primitives)
         if (radius < primitive.radius)
@@ -381,18 +451,85 @@ engine::gpu::asset::mesh::mesh(mesh &&other) noexcept
     radius = other.radius;
     primitives = std::move(other.primitives);
 }
-void engine::gpu::asset::mesh::draw(
-    engine::gpu::shader::program &in_shader) const
+engine::gpu::asset::mesh::mesh(const engine::gpu::asset &parent,
+                               const baked &baked,
+                               const baked::mesh &in_mesh)
+    : radius(0)
+{
+    for (uint32_t i = 0; i < in_mesh.primitive_count; i++)
+    {
+        const baked::primitive &in_primitive =
+            baked.primitives()[in_mesh.first_primitive + i];
+        const std::string material_name(baked.name(in_primitive.material));
+        auto it = parent.materials.find(material_name);
+        if (it == parent.materials.end())
+            continue;
+        primitives.emplace_back(it->second, baked, in_primitive);
+    }
+    for (const engine::gpu::asset::primitive &primitive : primitives)
+        if (radius < primitive.radius)
+            radius = primitive.radius;
+}
+
+void engine::gpu::asset::mesh::draw(engine::gpu::shader::program &in_shader,
+                                     size_t lod) const
 {
     for (const engine::gpu::asset::primitive &prim : primitives)
     {
         prim.material.use(in_shader);
+        in_shader.set_quantization(prim.quantization);
         prim.bind();
-        prim.draw();
+        prim.draw(lod);
     }
 }
 
+size_t engine::gpu::asset::mesh::lod(float error) const
+{
+    size_t lod = baked::lod_count - 1;
+    for (; lod > 0; lod--)
+    {
+        bool close = true;
+        for (const engine::gpu::asset::primitive &primitive : primitives)
+            if (primitive.error(lod) > error)
+                close = false;
+        if (close)
+            break;
+    }
+    return lod;
+}
+
 engine::gpu::asset::texture::texture(const gltf::texture &texture)
+{
+    const engine::image::rgba32 &image = texture.source.contents;
+
+    upload(image.width,
+           image.height,
+           image.data(),
+           texture.sampler.min_filter,
+           texture.sampler.mag_filter,
+           texture.sampler.wrap_s,
+           texture.sampler.wrap_t);
+}
+
+engine::gpu::asset::texture::texture(const baked &baked,
+                                     const baked::texture &texture)
+{
+    upload(texture.width,
+           texture.height,
+           baked.data(texture.pixels),
+           texture.min_filter,
+           texture.mag_filter,
+           texture.wrap_s,
+           texture.wrap_t);
+}
+
+void engine::gpu::asset::texture::upload(uint32_t width,
+                                         uint32_t height,
+                                         const void *pixels,
+                                         enum gltf::min_filter min_filter,
+                                         enum gltf::mag_filter mag_filter,
+                                         enum gltf::wrap_mode wrap_s,
+                                         enum gltf::wrap_mode wrap_t)
 {
     gl_check_error();
 
@@ -404,32 +541,24 @@ engine::gpu::asset::texture::texture(const gltf::texture &texture)
     gl_call(glTexParameteri,
             GL_TEXTURE_2D,
             GL_TEXTURE_MIN_FILTER,
-            (GLint)texture.sampler.min_filter);
+            (GLint)min_filter);
     gl_call(glTexParameteri,
             GL_TEXTURE_2D,
             GL_TEXTURE_MAG_FILTER,
-            (GLint)texture.sampler.mag_filter);
-    gl_call(glTexParameteri,
-            GL_TEXTURE_2D,
-            GL_TEXTURE_WRAP_S,
-            (GLint)texture.sampler.wrap_s);
-    gl_call(glTexParameteri,
-            GL_TEXTURE_2D,
-            GL_TEXTURE_WRAP_T,
-            (GLint)texture.sampler.wrap_t);
-
-    const engine::image::rgba32 &image = texture.source.contents;
+            (GLint)mag_filter);
+    gl_call(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (GLint)wrap_s);
+    gl_call(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (GLint)wrap_t);
 
     gl_call(glTexImage2D,
             GL_TEXTURE_2D,
             0,
             GL_RGBA,
-            (GLsizei)image.width,
-            (GLsizei)image.height,
+            (GLsizei)width,
+            (GLsizei)height,
             0,
             GL_RGBA,
             GL_UNSIGNED_BYTE,
-            image.data());
+            pixels);
 
     gl_call(glGenerateMipmap, GL_TEXTURE_2D);
 
@@ -771,16 +900,17 @@ engine::gpu::shader::vertex::vertex::vertex(const std::string &source)
 }
 
 engine::gpu::shader::vertex::vertex::vertex(
-    const engine::memory::allocation &source)
+    engine::memory::const_view source)
     : engine::gpu::shader::vertex::vertex(
-          std::string((const char *)source.data(), source.size()))
+          std::string((const char *)&source.begin[0], source.size()))
 {
 }
 
 engine::gpu::shader::vertex::vertex::vertex(
     engine::filesystem::cache_binary &fs,
     const std::string &path)
-    : engine::gpu::shader::vertex(*fs[path])
+    : engine::gpu::shader::vertex(
+          (const engine::filesystem::mapping &)*fs[path])
 {
 }
 
@@ -790,16 +920,17 @@ engine::gpu::shader::fragment::fragment::fragment(std::string source)
 }
 
 engine::gpu::shader::fragment::fragment::fragment(
-    const engine::memory::allocation &source)
+    engine::memory::const_view source)
     : engine::gpu::shader::fragment::fragment(
-          std::string((const char *)source.data(), source.size()))
+          std::string((const char *)&source.begin[0], source.size()))
 {
 }
 
 engine::gpu::shader::fragment::fragment::fragment(
     engine::filesystem::cache_binary &fs,
     const std::string &path)
-    : engine::gpu::shader::fragment(*fs[path])
+    : engine::gpu::shader::fragment(
+          (const engine::filesystem::mapping &)*fs[path])
 {
 }
 
@@ -855,6 +986,18 @@ engine::gpu::shader::program::program(const vertex *vertex_shader,
     if ((u_albedo_tex =
              glGetUniformLocation(id, UNIFORM_NAME_MATERIAL_ALBEDO_TEX)) < 0)
         std::cerr << "No albedo texture uniform\n";
+
+    if ((u_position_offset =
+             glGetUniformLocation(id, UNIFORM_NAME_POSITION_OFFSET)) < 0)
+        std::cerr << "No position offset uniform\n";
+
+    if ((u_position_scale =
+             glGetUniformLocation(id, UNIFORM_NAME_POSITION_SCALE)) < 0)
+        std::cerr << "No position scale uniform\n";
+
+    // Programs that only write depth have no use for texture coordinates
+    u_texcoord_offset = glGetUniformLocation(id, UNIFORM_NAME_TEXCOORD_OFFSET);
+    u_texcoord_scale = glGetUniformLocation(id, UNIFORM_NAME_TEXCOORD_SCALE);
 }
 
 engine::gpu::shader::program::program(program &&other) noexcept
@@ -862,6 +1005,10 @@ engine::gpu::shader::program::program(program &&other) noexcept
       u_model(other.u_model), u_view(other.u_view),
       u_projection(other.u_projection), u_normal(other.u_normal),
       u_mvp(other.u_mvp), u_albedo_tex(other.u_albedo_tex),
+      u_position_offset(other.u_position_offset),
+      u_position_scale(other.u_position_scale),
+      u_texcoord_offset(other.u_texcoord_offset),
+      u_texcoord_scale(other.u_texcoord_scale),
       skin_bone_count(other.skin_bone_count), model(other.model),
       view(other.view), projection(other.projection),
       view_projection(other.view_projection)
@@ -909,6 +1056,31 @@ void engine::gpu::shader::program::set_albedo_texture(
     }
 }
 
+void engine::gpu::shader::program::set_quantization(
+    const attributes::quantization &quantization) const
+{
+    if (u_position_offset != -1)
+        gl_call(glUniform3fv,
+                u_position_offset,
+                1,
+                (const GLfloat *)&quantization.position_offset);
+    if (u_position_scale != -1)
+        gl_call(glUniform3fv,
+                u_position_scale,
+                1,
+                (const GLfloat *)&quantization.position_scale);
+    if (u_texcoord_offset != -1)
+        gl_call(glUniform2fv,
+                u_texcoord_offset,
+                1,
+                (const GLfloat *)&quantization.texcoord_offset);
+    if (u_texcoord_scale != -1)
+        gl_call(glUniform2fv,
+                u_texcoord_scale,
+                1,
+                (const GLfloat *)&quantization.texcoord_scale);
+}
+
 void engine::gpu::shader::program::set_no_skin()
 {
     if (u_skin_count != -1)
@@ -1059,7 +1231,7 @@ engine::gpu::frame::light_point::light_point(const vec::fvec3 &position,
 }
 
 std::filesystem::file_time_type
-engine::gpu::cache::asset::get_mtime(const std::string &path)
+engine::gpu::cache::asset_base::get_mtime(const std::string &path)
 {
     return std::filesystem::last_write_time(path);
 }
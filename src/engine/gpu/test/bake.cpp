@@ -0,0 +1,325 @@
+#include <assert.h>
+#include <chrono>
+#include <engine/gltf.hpp>
+#include <engine/gpu.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <glb.hpp>
+#include <string.h>
+
+// Bakes each asset given, checks the baked file holds what loading the source
+// produces and is rebaked only when the source changes, then compares how
+// long it takes to get an asset ready to upload from each.
+
+using engine::gpu::baked;
+
+struct loaded
+{
+    size_t bones = 0;
+    size_t channels = 0;
+};
+
+// Everything gpu::asset does from the source, short of the GL calls
+static loaded load_source(const std::string &directory,
+                          const std::string &name)
+{
+    engine::filesystem::whitelist wl(directory);
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+    const gltf::gltf gltf(name, fs_bin, fs_img);
+    loaded result;
+
+    for (const gltf::skin &skin : gltf.skins)
+        result.bones += skel::armature(skin, gltf).bones.size();
+
+    for (const gltf::animation &animation : gltf.animations)
+        for (const skel::animation_times &times :
+             skel::animation(animation, gltf).times)
+            result.channels += times.bones.size();
+
+    for (const gltf::mesh &mesh : gltf.meshes)
+        for (const gltf::mesh_primitive &primitive : mesh.primitives)
+            engine::gpu::vertices vertices(primitive);
+
+    return result;
+}
+
+// The same from the baked file, touching the data an upload would read
+static loaded load_baked(const std::string &path)
+{
+    const baked baked(path);
+    loaded result;
+    volatile uint8_t touched = 0;
+
+    for (const baked::texture &texture : baked.textures())
+        if (texture.pixels.size)
+            touched = baked.data(texture.pixels)[texture.pixels.size - 1];
+
+    for (const baked::armature &armature : baked.armatures())
+        result.bones += baked.load(armature).bones.size();
+
+    for (const baked::animation &animation : baked.animations())
+        for (const skel::animation_times &times : baked.load(animation).times)
+            result.channels += times.bones.size();
+
+    for (const baked::primitive &primitive : baked.primitives())
+        if (primitive.vertices.size)
+            touched = baked.data(
+                primitive.vertices)[primitive.vertices.size - 1];
+
+    (void)touched;
+    return result;
+}
+
+static void check(const std::string &directory, const std::string &name)
+{
+    engine::filesystem::whitelist wl(directory);
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+    const gltf::gltf gltf(name, fs_bin, fs_img);
+
+    const std::string source = directory + "/" + name;
+    const std::string path = directory + "/baked/" + name + ".baked";
+
+    assert(!baked::open(path, source));
+    baked::write(path, source, gltf);
+    std::optional<baked> opened = baked::open(path, source);
+    assert(opened);
+    const baked &baked = *opened;
+
+    size_t primitive = 0;
+    for (const gltf::mesh &mesh : gltf.meshes)
+        for (const gltf::mesh_primitive &in : mesh.primitives)
+        {
+            if (mesh.name.empty() || !in.material || in.material->name.empty())
+                continue;
+
+            const engine::gpu::vertices vertices(in);
+            const baked::primitive &record = baked.primitives()[primitive++];
+            assert(baked.name(record.material) == in.material->name);
+            assert(record.count == vertices.layout.count);
+            assert(record.vertices.size == vertices.data.size());
+            assert(memcmp(baked.data(record.vertices),
+                          vertices.data.data(),
+                          vertices.data.size()) == 0);
+            assert(record.indices.size == vertices.indices.size());
+            assert(memcmp(baked.data(record.indices),
+                          vertices.indices.data(),
+                          vertices.indices.size()) == 0);
+            for (size_t i = 0; i < engine::gpu::attributes::count; i++)
+                assert(record.offsets[i] == vertices.layout.offsets[i]);
+            assert(memcmp(&record.quantization,
+                          &vertices.layout.quantization,
+                          sizeof(record.quantization)) == 0);
+            for (size_t i = 0; i < baked::lod_count; i++)
+            {
+                const baked::lod &lod = record.lods[i];
+                assert(lod.first == vertices.layout.lods[i].first);
+                assert(lod.count == vertices.layout.lods[i].count);
+                assert(lod.error == vertices.layout.lods[i].error);
+                assert(lod.first + lod.count <= record.count);
+            }
+        }
+    assert(primitive == baked.primitives().size());
+
+    assert(baked.textures().size() == gltf.textures.size());
+    for (size_t i = 0; i < gltf.textures.size(); i++)
+    {
+        const engine::image::rgba32 &image = gltf.textures[i].source.contents;
+        const baked::texture &texture = baked.textures()[i];
+        assert(texture.width == image.width);
+        assert(memcmp(baked.data(texture.pixels),
+                      image.data(),
+                      texture.pixels.size) == 0);
+    }
+
+    size_t armature = 0;
+    for (const gltf::skin &skin : gltf.skins)
+    {
+        if (skin.name.empty())
+            continue;
+        const skel::armature expected(skin, gltf);
+        const skel::armature read = baked.load(baked.armatures()[armature++]);
+        assert(read.root_name == expected.root_name);
+        assert(read.bones_names == expected.bones_names);
+        assert(read.bones.size() == expected.bones.size());
+        for (size_t i = 0; i < read.bones.size(); i++)
+        {
+            assert(read.bones[i].child == expected.bones[i].child);
+            assert(read.bones[i].peer == expected.bones[i].peer);
+            assert(read.bones[i].parent == expected.bones[i].parent);
+        }
+    }
+
+    size_t animation = 0;
+    for (const gltf::animation &in : gltf.animations)
+    {
+        if (in.name.empty())
+            continue;
+        const skel::animation expected(in, gltf);
+        const skel::animation read =
+            baked.load(baked.animations()[animation++]);
+        assert(read.times.size() == expected.times.size());
+        for (size_t i = 0; i < read.times.size(); i++)
+        {
+            assert(read.times[i].input == expected.times[i].input);
+            assert(read.times[i].bones.size() ==
+                   expected.times[i].bones.size());
+        }
+
+        // Poses sampled from either animation are the same
+        for (const baked::armature &record : baked.armatures())
+        {
+            const skel::armature armature = baked.load(record);
+            skel::pose expected_pose;
+            skel::pose read_pose;
+            expected_pose.start(armature);
+            read_pose.start(armature);
+            expected_pose.accumulate(expected, 0.3, 1);
+            read_pose.accumulate(read, 0.3, 1);
+
+            std::vector<vec::fmat4> expected_matrices;
+            std::vector<vec::fmat4> read_matrices;
+            expected_pose.append_matrices(expected_matrices);
+            read_pose.append_matrices(read_matrices);
+            assert(memcmp(expected_matrices.data(),
+                          read_matrices.data(),
+                          read_matrices.size() * sizeof(vec::fmat4)) == 0);
+        }
+    }
+
+    // A new time alone keeps the baked file, through its hash
+    std::filesystem::last_write_time(
+        source,
+        std::filesystem::last_write_time(source) + std::chrono::seconds(5));
+    assert(baked::open(path, source));
+
+    // without writing to it, since it may be mapped
+    const auto baked_time = std::filesystem::last_write_time(path);
+    assert(engine::gpu::baked(path).header().source_mtime !=
+           std::filesystem::last_write_time(source).time_since_epoch().count());
+    assert(baked::open(path, source));
+    assert(std::filesystem::last_write_time(path) == baked_time);
+
+    // Changed contents do not, even of the same size
+    {
+        std::fstream stream(source,
+                            std::ios::binary | std::ios::in | std::ios::out);
+        stream.seekg(-1, std::ios::end);
+        const char last = stream.get();
+        stream.seekp(-1, std::ios::end);
+        stream.put(last ^ 1);
+    }
+    assert(!baked::open(path, source));
+
+    // Nor does a file that is not a baked asset
+    std::ofstream(path, std::ios::trunc) << "not baked";
+    assert(!baked::open(path, source));
+}
+
+// A source with an image in a file of its own is not baked, as changes to the
+// image would not make the baked file stale
+static void check_external(const std::string &directory,
+                           const std::string &image)
+{
+    std::filesystem::copy_file(image, directory + "/external.png");
+    ::glb glb;
+    glb.write(directory + "/external.glb",
+              ",\"images\":[{\"uri\":\"external.png\"}]");
+
+    engine::filesystem::whitelist wl(directory);
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+    const gltf::gltf gltf("external.glb", fs_bin, fs_img);
+    assert(gltf.images.size() == 1 && gltf.images[0].contents.width);
+    assert(!baked::self_contained(gltf));
+
+    const std::string path = directory + "/baked/external.glb.baked";
+    bool thrown = false;
+    try
+    {
+        baked::write(path, directory + "/external.glb", gltf);
+    }
+    catch (const engine::exception &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(!std::filesystem::exists(path));
+}
+
+static void bench(const std::string &directory, const std::string &name)
+{
+    const std::string source = directory + "/" + name;
+    const std::string path = directory + "/baked/" + name + ".baked";
+
+    {
+        engine::filesystem::whitelist wl(directory);
+        engine::filesystem::cache_binary fs_bin(wl);
+        engine::image::cache::rgba32 fs_img(wl);
+        baked::write(path, source, gltf::gltf(name, fs_bin, fs_img));
+    }
+
+    const size_t repeat = 200;
+
+    auto start = std::chrono::steady_clock::now();
+    loaded from_source;
+    for (size_t n = 0; n < repeat; n++)
+        from_source = load_source(directory, name);
+    const std::chrono::duration<double, std::micro> source_time =
+        std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    loaded from_baked;
+    for (size_t n = 0; n < repeat; n++)
+    {
+        assert(baked::open(path, source));
+        from_baked = load_baked(path);
+    }
+    const std::chrono::duration<double, std::micro> baked_time =
+        std::chrono::steady_clock::now() - start;
+
+    assert(from_baked.bones == from_source.bones);
+    assert(from_baked.channels == from_source.channels);
+
+    std::cout << name << ": source " << source_time.count() / repeat
+              << " us, baked " << baked_time.count() / repeat << " us ("
+              << source_time.count() / baked_time.count() << "x), "
+              << std::filesystem::file_size(path) << " bytes baked\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <scratch directory> <image.png> <asset.glb>...\n";
+        return 1;
+    }
+
+    const std::string directory =
+        (std::filesystem::path(argv[1]) / "gpu.bake").string();
+
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    check_external(directory, argv[2]);
+
+    for (int i = 3; i < argc; i++)
+    {
+        const std::string name = std::filesystem::path(argv[i]).filename();
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::filesystem::copy_file(argv[i], directory + "/" + name);
+        bench(directory, name);
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::filesystem::copy_file(argv[i], directory + "/" + name);
+        check(directory, name);
+    }
+
+    std::cout << "Success\n";
+    return 0;
+}
@@ -0,0 +1,246 @@
+#include "glb.hpp"
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <engine/gltf.hpp>
+#include <engine/gpu.hpp>
+#include <engine/platform.hpp>
+#include <filesystem>
+#include <glad/glad.h>
+#include <iostream>
+#include <string.h>
+
+// Writes a dense grid mesh, checks that interleaving its vertices moves every
+// attribute without changing it, then compares how long building each
+// arrangement takes and, given shaders, how fast the gpu fetches each.
+
+using engine::gpu::attributes::arrangement;
+
+static const size_t side = 1024;
+static const size_t vertex_count = side * side;
+
+static void write_glb(const std::filesystem::path &path)
+{
+    glb glb;
+
+    glb.add(5126, "VEC3", false, vertex_count, [&](size_t i) {
+        glb.append((float)(i % side) / side - 0.5f);
+        glb.append((float)(i / side) / side - 0.5f);
+        glb.append((float)((i * 7) % 13) / 256.0f);
+    });
+    glb.add(5126, "VEC3", false, vertex_count, [&](size_t) {
+        glb.append(0.0f);
+        glb.append(0.0f);
+        glb.append(1.0f);
+    });
+    glb.add(5126, "VEC4", false, vertex_count, [&](size_t) {
+        glb.append(1.0f);
+        glb.append(0.0f);
+        glb.append(0.0f);
+        glb.append(1.0f);
+    });
+    glb.add(5126, "VEC2", false, vertex_count, [&](size_t i) {
+        glb.append((float)(i % side) / side);
+        glb.append((float)(i / side) / side);
+    });
+    glb.add(5121, "VEC4", false, vertex_count, [&](size_t i) {
+        for (size_t c = 0; c < 4; c++)
+            glb.append((uint8_t)((i + c) % 4));
+    });
+    glb.add(5121, "VEC4", true, vertex_count, [&](size_t) {
+        glb.append((uint8_t)255);
+        for (size_t c = 1; c < 4; c++)
+            glb.append((uint8_t)0);
+    });
+
+    // Two triangles for each square of the grid
+    const size_t squares = (side - 1) * (side - 1);
+    glb.add(5125, "SCALAR", false, squares * 6, [&](size_t i) {
+        const size_t square = i / 6;
+        const uint32_t corner =
+            square % (side - 1) + square / (side - 1) * side;
+        const uint32_t offsets[6] = {0, 1, side, 1, side + 1, side};
+        glb.append(corner + offsets[i % 6]);
+    });
+
+    glb.write(path,
+              ",\"materials\":[{\"name\":\"grid\"}],\"meshes\":[{\"name\":"
+              "\"grid\",\"primitives\":[{\"attributes\":{\"POSITION\":0,"
+              "\"NORMAL\":1,\"TANGENT\":2,\"TEXCOORD_0\":3,\"JOINTS_0\":4,"
+              "\"WEIGHTS_0\":5},\"indices\":6,\"material\":0}]}],\"nodes\":"
+              "[{\"name\":\"grid\",\"mesh\":0}]");
+}
+
+static const char *name(enum arrangement which)
+{
+    return which == arrangement::separate ? "separate" : "interleaved";
+}
+
+static void check(const gltf::mesh_primitive &primitive)
+{
+    const engine::gpu::vertices separate(primitive, arrangement::separate);
+    const engine::gpu::vertices interleaved(primitive,
+                                            arrangement::interleaved);
+
+    assert(separate.layout.stride == 0);
+    assert(interleaved.layout.stride % 4 == 0);
+    assert(interleaved.data.size() ==
+           interleaved.layout.stride * vertex_count);
+    assert(interleaved.layout.count == separate.layout.count);
+    assert(interleaved.layout.radius == separate.layout.radius);
+    assert(interleaved.layout.integer_mask == separate.layout.integer_mask);
+    assert(interleaved.indices == separate.indices);
+
+    // The grid is flat, so each level of detail simplifies the one before
+    for (size_t lod = 0; lod < engine::gpu::baked::lod_count; lod++)
+    {
+        const engine::gpu::baked::lod &a = separate.layout.lods[lod];
+        const engine::gpu::baked::lod &b = interleaved.layout.lods[lod];
+        assert(a.first == b.first && a.count == b.count && a.error == b.error);
+        assert(lod == 0 || a.count < separate.layout.lods[lod - 1].count);
+    }
+
+    // Quantized positions and texture coordinates read back nearer to their
+    // own place on the grid than to any other
+    const engine::gpu::attributes::quantization &quantization =
+        interleaved.layout.quantization;
+    const auto near = [](float value, float step)
+    { return std::fabs(value - std::round(value / step) * step) < step / 8; };
+
+    for (size_t v = 0; v < vertex_count; v += 101)
+    {
+        const uint8_t *vertex =
+            interleaved.data.data() + v * interleaved.layout.stride;
+        engine::gpu::attributes::position position;
+        engine::gpu::attributes::texcoord texcoord;
+        memcpy((void *)&position,
+               vertex + interleaved.layout.offsets[0],
+               sizeof(position));
+        memcpy((void *)&texcoord,
+               vertex + interleaved.layout.offsets[3],
+               sizeof(texcoord));
+
+        const vec::fvec3 p = quantization.dequantize(position);
+        const vec::fvec2 t = quantization.dequantize(texcoord);
+        assert(near(p.x + 0.5f, 1.0f / side) && near(p.y + 0.5f, 1.0f / side));
+        assert(near(p.z, 1.0f / 256));
+        assert(near(t.x, 1.0f / side) && near(t.y, 1.0f / side));
+    }
+
+    for (size_t index = 0; index < engine::gpu::attributes::count; index++)
+    {
+        const size_t size = engine::gpu::attributes::layouts[index].size();
+        const uint32_t from = separate.layout.offsets[index];
+        const uint32_t to = interleaved.layout.offsets[index];
+
+        assert(from != engine::gpu::baked::absent);
+        assert(to + size <= interleaved.layout.stride);
+
+        for (size_t v = 0; v < vertex_count; v += 101)
+            assert(memcmp(separate.data.data() + from + v * size,
+                          interleaved.data.data() + to +
+                              v * interleaved.layout.stride,
+                          size) == 0);
+    }
+}
+
+static void bench_build(const gltf::mesh_primitive &primitive)
+{
+    const size_t repeat = 1;
+
+    for (enum arrangement which :
+         {arrangement::separate, arrangement::interleaved})
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < repeat; n++)
+            engine::gpu::vertices vertices(primitive, which);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << name(which) << " build: "
+                  << vertex_count * repeat / elapsed.count() / 1e6
+                  << " M vertices/s\n";
+    }
+}
+
+static void bench_fetch(const gltf::gltf &gltf,
+                        const std::string &vs_path,
+                        const std::string &fs_path)
+{
+    engine::filesystem::allocation vs_alloc(vs_path);
+    engine::filesystem::allocation fs_alloc(fs_path);
+
+    platform::window window("gpu interleave");
+
+    engine::gpu::shader::vertex vertex_shader(
+        std::string(vs_alloc.begin(), vs_alloc.end()));
+    engine::gpu::shader::fragment fragment_shader(
+        std::string(fs_alloc.begin(), fs_alloc.end()));
+    engine::gpu::shader::program program(&vertex_shader, &fragment_shader);
+
+    // Far enough away that the grid covers a few pixels, leaving the time
+    // spent fetching and shading vertices
+    const vec::perspective perspective(3.14159 / 2, 1);
+    const vec::transform3 camera(vec::fvec3(0, 0, 10000),
+                                 vec::fvec4(vec::fvec3(0, 0, 0), vec::up));
+    const size_t draws = 50;
+
+    for (enum arrangement which :
+         {arrangement::separate, arrangement::interleaved})
+    {
+        const engine::gpu::asset asset(gltf, which);
+
+        program.bind();
+        program.set_no_skin();
+        program.set_view_perspective(camera, perspective);
+        program.set_model_transform(vec::transform3());
+
+        // Uploads finish before the first draw does
+        asset.draw("grid", program);
+        glFinish();
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < draws; n++)
+            asset.draw("grid", program);
+        glFinish();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        window.get_frame();
+
+        // Indices drawn, of which the post-transform cache shades fewer
+        std::cout << name(which) << " fetch: "
+                  << gltf.accessors[6].count * draws / elapsed.count() / 1e6
+                  << " M indices/s\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <scratch directory> [<vertex shader> <fragment "
+                     "shader>]\n";
+        return 1;
+    }
+
+    const std::filesystem::path directory =
+        std::filesystem::path(argv[1]) / "gpu.interleave";
+    std::filesystem::create_directories(directory);
+    write_glb(directory / "grid.glb");
+
+    engine::filesystem::whitelist wl(directory.string());
+    engine::filesystem::cache_binary fs_bin(wl);
+    engine::image::cache::rgba32 fs_img(wl);
+    const gltf::gltf gltf("grid.glb", fs_bin, fs_img);
+    const gltf::mesh_primitive &primitive = gltf.meshes[0].primitives[0];
+
+    check(primitive);
+    bench_build(primitive);
+
+    if (argc == 4)
+        bench_fetch(gltf, argv[2], argv[3]);
+
+    std::cout << "Success\n";
+    return 0;
+}
@@ -28,10 +28,13 @@ class rgba32
     std::vector<pixel> contents;
 
   public:
-    uint16_t width;
-    uint16_t height;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    // An empty image, to be decoded into later
+    rgba32() {}
     rgba32(const engine::memory::const_view input);
     rgba32(const std::string &path);
+    rgba32(const std::string &path, const filesystem::whitelist &wl);
     const pixel *data() const
     {
         return contents.data();
@@ -66,7 +69,8 @@ class rgb24
 
 namespace engine::image::cache
 {
-class rgba32 : public filesystem::cache<image::rgba32>
+class rgba32_base
+    : public filesystem::cache<image::rgba32, const filesystem::whitelist &>
 {
   protected:
     reference load(const std::string &path_rel,
@@ -76,14 +80,21 @@ class rgba32 : public filesystem::cache<image::rgba32>
     {
         return std::filesystem::last_write_time(path);
     }
+    size_t measure(const image::rgba32 &contents) override
+    {
+        return (size_t)contents.width * contents.height *
+               sizeof(image::rgba32::pixel);
+    }
 
   public:
-    rgba32(class filesystem::whitelist &wl)
-        : filesystem::cache<image::rgba32>(wl)
+    rgba32_base(class filesystem::whitelist &wl)
+        : filesystem::cache<image::rgba32, const filesystem::whitelist &>(wl)
     {
     }
 };
+using rgba32 = filesystem::drained<rgba32_base>;
 
 } // namespace engine::image::cache
 
-extern template class engine::filesystem::cache<engine::image::rgba32>;
+extern template class engine::filesystem::
+    cache<engine::image::rgba32, const engine::filesystem::whitelist &>;
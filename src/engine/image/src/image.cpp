@@ -86,24 +86,28 @@ rgba32::rgba32(const engine::memory::const_view input)
 
 #endif // USE_LIBPNG
 
-rgba32::rgba32(const std::string &path)
-    : rgba32(filesystem::allocation(path)) {};
+rgba32::rgba32(const std::string &path) : rgba32(filesystem::mapping(path)) {};
 
-rgb24::rgb24(const std::string &path) : rgb24(filesystem::allocation(path)) {};
+rgba32::rgba32(const std::string &path, const filesystem::whitelist &wl)
+    : rgba32(filesystem::mapping(path, wl))
+{
+}
+
+rgb24::rgb24(const std::string &path) : rgb24(filesystem::mapping(path)) {};
 
 } // namespace engine::image
 
 namespace engine::image::cache
 {
 
-cache::rgba32::reference
-cache::rgba32::load(const std::string &path_rel,
-                    const std::string &path_abs,
-                    std::filesystem::file_time_type mtime)
+cache::rgba32_base::reference
+cache::rgba32_base::load(const std::string &path_rel,
+                         const std::string &path_abs,
+                         std::filesystem::file_time_type mtime)
 {
-    return std::make_shared<engine::image::cache::rgba32::file>(path_abs,
-                                                                mtime);
+    return std::make_shared<file>(path_rel, mtime, whitelist);
 }
 } // namespace engine::image::cache
 
-template class engine::filesystem::cache<engine::image::rgba32>;
+template class engine::filesystem::
+    cache<engine::image::rgba32, const engine::filesystem::whitelist &>;
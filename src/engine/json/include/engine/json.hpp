@@ -1,8 +1,10 @@
 #pragma once
 #include <engine/exception.hpp>
 #include <engine/memory.hpp>
+#include <memory_resource>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -62,7 +64,8 @@ class exception : engine::exception
     }
 };
 
-using string = std::string;
+// Containers allocate from the memory resource the document was parsed with
+using string = std::pmr::string;
 
 class number
 {
@@ -118,6 +121,11 @@ class number
             return std::get<number_int>(this->contents);
     }
 
+    bool is_int() const
+    {
+        return std::holds_alternative<number_int>(this->contents);
+    }
+
     number_int as_int() const
     {
 
@@ -152,14 +160,18 @@ class number
     }
 };
 
-using object = std::unordered_map<std::string, value>;
+using object = std::pmr::unordered_map<string, value>;
 
-using array = std::vector<value>;
+using array = std::pmr::vector<value>;
+
+class writer;
 
 class value
 {
     std::variant<array, number, object, string, bool, null> contents = null();
 
+    friend class writer;
+
   public:
     json::location location;
 
@@ -171,57 +183,66 @@ class value
         return false;
     }
 
-    value operator=(const array &&other)
+    value &operator=(array &&other)
     {
         this->contents = std::move(other);
         return *this;
     };
 
-    value operator=(const array &other)
+    value &operator=(const array &other)
     {
         this->contents = other;
         return *this;
     };
 
-    value operator=(const number &other)
+    value &operator=(const number &other)
     {
         this->contents = other;
         return *this;
     };
-    value operator=(const object &other)
+    value &operator=(const object &other)
     {
         this->contents = other;
         return *this;
     };
-    value operator=(const string &other)
+    value &operator=(const string &other)
     {
         this->contents = other;
         return *this;
     };
-
-    value operator=(const null &other)
+    value &operator=(object &&other)
     {
-        this->contents = other;
+        this->contents = std::move(other);
+        return *this;
+    };
+    value &operator=(string &&other)
+    {
+        this->contents = std::move(other);
         return *this;
     };
 
-    value operator=(const value &other)
+    value &operator=(const null &other)
     {
-        if (this != &other)
-            *this = other;
+        this->contents = other;
         return *this;
     };
+
+    value &operator=(const value &other) = default;
+    value &operator=(value &&other) = default;
+    value(const value &other) = default;
+    value(value &&other) = default;
     value() {}
-    value(const array &&other) : contents(std::move(other)) {}
-    value(const string &&other) : contents(std::move(other)) {}
-    value(const object &&other) : contents(std::move(other)) {}
+    // Moving keeps the memory resource the contents were allocated from
+    value(array &&other) : contents(std::move(other)) {}
+    value(string &&other) : contents(std::move(other)) {}
+    value(object &&other) : contents(std::move(other)) {}
     value(const array &other) : contents(other) {}
     value(const string &other) : contents(other) {}
     value(const object &other) : contents(other) {}
     value(const number &other) : contents(other) {}
     value(const null &other) : contents(other) {}
     value(const bool &other) : contents(other) {}
-    value operator[](const std::string &index)
+    value operator[](const string &index)
     {
         if (std::holds_alternative<object>(this->contents))
             return std::get<object>(this->contents)[index];
@@ -300,8 +321,565 @@ class value
     }
 };
 
-value parse(const std::string &name, const std::string &text);
-value parse_memory(const std::string &name, engine::memory::const_view input);
-value parse_file(const std::string &name);
+// Forward-only tokenizer over JSON text. Whitespace and string contents are
+// skipped a word at a time, strings without escapes come back as views into
+// the input and only positions are tracked, with the line and column worked
+// out when an error is reported.
+class scanner
+{
+  public:
+    enum class token
+    {
+        end,
+        object_begin,
+        object_end,
+        array_begin,
+        array_end,
+        colon,
+        comma,
+        string,
+        number,
+        true_value,
+        false_value,
+        null_value,
+    };
+
+  private:
+    std::string_view name;
+    const char *begin;
+    const char *point;
+    const char *end;
+    const char *token_begin;
+    uint32_t first_line = 1;
+    uint32_t first_col = 1;
+    bool partial = false;
+    std::string_view token_text;
+    // Holds the contents of the last string that had escapes in it
+    std::string unescaped;
+
+    // Each returns false when the token runs into the end of partial text
+    bool scan_string();
+    bool scan_number();
+    bool scan_word(const char *word, size_t length);
+
+  public:
+    // name is only referred to, and must outlive the scanner
+    scanner(std::string_view name, const char *begin, const char *end);
+
+    token next();
+    // Steps over the rest of a value that started with current, without
+    // checking what is inside it
+    void skip(token current);
+    // Carries on scanning from position, somewhere in the text
+    void seek(const char *position)
+    {
+        point = position;
+    }
+    const char *position() const
+    {
+        return point;
+    }
+    // When the text is only the start of what is to come, a token that runs
+    // into its end is not scanned. next() returns token::end and position()
+    // is where the token starts, to scan again once there is more text.
+    void set_partial(bool _partial)
+    {
+        partial = _partial;
+    }
+    // Where the text starts in a larger document, for error locations
+    void starts_at(uint32_t line, uint32_t col)
+    {
+        first_line = line;
+        first_col = col;
+    }
+
+    // Contents of the last string token, or the text of the last number.
+    // Only valid until the next call to next().
+    std::string_view text() const
+    {
+        return token_text;
+    }
+    size_t offset() const
+    {
+        return token_begin - begin;
+    }
+
+    json::location location(size_t offset) const;
+    json::exception error(const std::string &message) const;
+};
+
+class cursor;
+
+// A whole document flattened into one array of elements in document order.
+// Containers record where their contents end so they can be stepped over,
+// object members are a key element followed by the value, and strings are
+// offsets into the parsed text or, when they had escapes, into a buffer of
+// the tape's own. The text must outlive the tape.
+class tape
+{
+  public:
+    enum class type : uint8_t
+    {
+        null,
+        boolean,
+        integer,
+        real,
+        string,
+        array,
+        object,
+    };
+
+    struct element
+    {
+        enum type type;
+        bool boolean;
+        // Strings: the contents are in the tape's buffer, not the text
+        bool unescaped;
+        // Index just past this element and everything inside it
+        uint32_t next;
+        union
+        {
+            number_int integer;
+            number_float real;
+            struct
+            {
+                uint32_t offset;
+                uint32_t length;
+            } text;
+            // Elements of an array or members of an object
+            uint32_t count;
+        };
+    };
+
+  private:
+    std::string name;
+    const char *begin;
+    const char *end;
+    std::pmr::vector<element> elements;
+    // Where each element starts in the text, to report errors against
+    std::pmr::vector<uint32_t> offsets;
+    std::pmr::string unescaped;
+
+    void build(json::scanner &scanner, scanner::token current);
+
+  public:
+    tape(const std::string &name,
+         const char *begin,
+         const char *end,
+         std::pmr::memory_resource *resource =
+             std::pmr::get_default_resource());
+    tape(const std::string &name,
+         engine::memory::const_view input,
+         std::pmr::memory_resource *resource =
+             std::pmr::get_default_resource())
+        : tape(name,
+               (const char *)input.data(),
+               (const char *)input.data() + input.size(),
+               resource)
+    {
+    }
+    tape(const tape &) = delete;
+    tape &operator=(const tape &) = delete;
+
+    cursor root() const;
+
+    const element &operator[](uint32_t index) const
+    {
+        return elements[index];
+    }
+    size_t size() const
+    {
+        return elements.size();
+    }
+    std::string_view text(const element &string) const
+    {
+        return std::string_view(
+            (string.unescaped ? unescaped.data() : begin) + string.text.offset,
+            string.text.length);
+    }
+    json::location location(uint32_t index) const;
+};
+
+// Read-only position in a tape, cheap to copy. A default constructed cursor,
+// which find() returns for a missing key, tests false.
+class cursor
+{
+    const json::tape *document = nullptr;
+    uint32_t index = 0;
+
+    const tape::element &get() const
+    {
+        return (*document)[index];
+    }
+    const tape::element &get(enum tape::type type, const char *message) const
+    {
+        const tape::element &result = get();
+        if (result.type != type)
+            throw error(message);
+        return result;
+    }
+
+  public:
+    class iterator
+    {
+        const json::tape *document;
+        uint32_t index;
+        bool members;
+
+      public:
+        iterator(const json::tape *_document,
+                 uint32_t _index,
+                 bool _members)
+            : document(_document), index(_index), members(_members)
+        {
+        }
+        cursor operator*() const
+        {
+            return cursor(document, members ? index + 1 : index);
+        }
+        // Key of the member, when iterating over an object
+        std::string_view key() const
+        {
+            return document->text((*document)[index]);
+        }
+        iterator &operator++()
+        {
+            index = (*document)[members ? index + 1 : index].next;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const
+        {
+            return index != other.index;
+        }
+        bool operator==(const iterator &other) const
+        {
+            return index == other.index;
+        }
+    };
+
+    cursor() {}
+    cursor(const json::tape *_document, uint32_t _index)
+        : document(_document), index(_index)
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return document;
+    }
+    enum tape::type type() const
+    {
+        return get().type;
+    }
+
+    // Arrays iterate over their elements and objects over member values
+    iterator begin() const;
+    iterator end() const;
+    size_t size() const;
+
+    cursor find(std::string_view key) const;
+    cursor at(std::string_view key) const;
+    cursor operator[](size_t position) const;
+
+    bool as_bool() const
+    {
+        return get(tape::type::boolean, "Expected a bool").boolean;
+    }
+    std::string_view as_string() const
+    {
+        return document->text(get(tape::type::string, "Expected a string"));
+    }
+    number_int as_int() const;
+    number_float as_float() const;
+    number_int strict_int() const;
+    number_float strict_float() const;
+
+    json::exception error(const std::string &message) const
+    {
+        return json::exception(document->location(index), message);
+    }
+};
+
+// A value that is read straight from the text when it is asked for, with
+// nothing built beforehand. Lookups scan the object they are called on and
+// step over the values in between without checking them, so an error in a
+// value is only found if that value is read. Suits documents that are read
+// once, such as glTF headers. Values are valid as long as their document.
+class lazy
+{
+  public:
+    class document
+    {
+        std::string name;
+        const char *begin;
+        const char *end;
+
+        friend class lazy;
+
+      public:
+        // The text must outlive the document
+        document(const std::string &name, const char *begin, const char *end)
+            : name(name), begin(begin), end(end)
+        {
+        }
+        document(const std::string &name, engine::memory::const_view input)
+            : document(name,
+                       (const char *)input.data(),
+                       (const char *)input.data() + input.size())
+        {
+        }
+
+        lazy root() const
+        {
+            return lazy(this, begin);
+        }
+    };
+
+    class iterator
+    {
+        const document *source;
+        json::scanner scanner;
+        scanner::token current;
+        const char *element;
+        bool members;
+        std::string_view member_key;
+        std::string key_buffer;
+
+        void read_element(scanner::token first);
+
+      public:
+        // An end iterator
+        iterator(const document *source);
+        // Iterates over the array or object that starts at value
+        iterator(const document *source, const char *value);
+
+        lazy operator*() const
+        {
+            return lazy(source, element);
+        }
+        // Key of the member, when iterating over an object. Only valid
+        // until the iterator moves.
+        std::string_view key() const
+        {
+            return member_key;
+        }
+        iterator &operator++();
+        bool operator!=(const iterator &other) const
+        {
+            return element != other.element;
+        }
+        bool operator==(const iterator &other) const
+        {
+            return element == other.element;
+        }
+    };
+
+  private:
+    const document *source = nullptr;
+    const char *point = nullptr;
+
+    json::scanner scan(scanner::token &first) const;
+
+  public:
+    lazy() {}
+    lazy(const document *_source, const char *_point)
+        : source(_source), point(_point)
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return source;
+    }
+    enum tape::type type() const;
+
+    // Arrays iterate over their elements and objects over member values
+    iterator begin() const
+    {
+        return iterator(source, point);
+    }
+    iterator end() const
+    {
+        return iterator(source);
+    }
+    // Scans the whole array or object to count it
+    size_t size() const;
+
+    lazy find(std::string_view key) const;
+    lazy at(std::string_view key) const;
+    lazy operator[](size_t position) const;
+
+    bool as_bool() const;
+    std::string as_string() const;
+    number_int as_int() const;
+    number_float as_float() const;
+    number_int strict_int() const;
+    number_float strict_float() const;
+
+    json::exception error(const std::string &message) const;
+};
+
+// Receives the contents of a document in order from a stream. Each call
+// returns whether to carry on, so reading can stop early. Strings and keys
+// are only valid during the call.
+class handler
+{
+  public:
+    virtual ~handler() {}
+
+    virtual bool start_object()
+    {
+        return true;
+    }
+    virtual bool key(std::string_view key)
+    {
+        return true;
+    }
+    virtual bool end_object()
+    {
+        return true;
+    }
+    virtual bool start_array()
+    {
+        return true;
+    }
+    virtual bool end_array()
+    {
+        return true;
+    }
+    virtual bool string(std::string_view string)
+    {
+        return true;
+    }
+    virtual bool number(const json::number &number)
+    {
+        return true;
+    }
+    virtual bool boolean(bool boolean)
+    {
+        return true;
+    }
+    virtual bool null()
+    {
+        return true;
+    }
+};
+
+// Reads a document given in pieces of any size and passes what it finds to
+// a handler, without building anything. Only the unfinished token at the
+// end of a piece and the nesting of the containers are kept, so memory is
+// bounded however large the document is.
+class stream
+{
+    enum class expect : uint8_t
+    {
+        value,
+        value_or_end,
+        key,
+        key_or_end,
+        colon,
+        comma_or_end,
+        done,
+    };
+
+    std::string name;
+    json::handler &handler;
+    std::string pending;
+    // True for each object and false for each array that is open
+    std::vector<bool> containers;
+    expect state = expect::value;
+    bool stopped = false;
+    uint32_t line = 1;
+    uint32_t col = 1;
+
+    const char *read(const char *begin, const char *end, bool last);
+    bool dispatch(json::scanner &scanner, scanner::token current);
+    bool close(json::scanner &scanner, scanner::token current);
+    bool value(json::scanner &scanner, scanner::token current);
+
+  public:
+    stream(const std::string &name, json::handler &handler);
+
+    // Returns false once the handler has stopped the stream
+    bool feed(const char *begin, const char *end);
+    bool feed(engine::memory::const_view piece)
+    {
+        return feed((const char *)piece.data(),
+                    (const char *)piece.data() + piece.size());
+    }
+    // Reads what is left and throws if the document is unfinished, unless
+    // the handler stopped it
+    void finish();
+};
+
+// Appends JSON text to a string, which keeps its capacity for the next
+// document when it is reused. Floats are written as the shortest text that
+// reads back as the same double, and keep a '.' so they read back as
+// floats. Being a handler, a stream can be written out as it is read.
+class writer final : public handler
+{
+  public:
+    enum class style
+    {
+        compact,
+        // Four space indents and a member or element per line
+        pretty,
+    };
+
+  private:
+    std::string &out;
+    enum style layout;
+    size_t depth = 0;
+    // No element has been written in the innermost container yet
+    bool first = true;
+    bool after_key = false;
+
+    void separate();
+    void newline();
+    void write_string(std::string_view string);
+
+  public:
+    writer(std::string &out, enum style style = style::compact);
+
+    void write(const json::value &value);
+
+    bool start_object() override;
+    bool key(std::string_view key) override;
+    bool end_object() override;
+    bool start_array() override;
+    bool end_array() override;
+    bool string(std::string_view string) override;
+    bool number(const json::number &number) override;
+    bool boolean(bool boolean) override;
+    bool null() override;
+};
+
+std::string write(const value &value,
+                  enum writer::style style = writer::style::compact);
+
+// scan is the scanner based parser, step the original one that reads a
+// character at a time, kept to compare against
+enum class mode
+{
+    scan,
+    step,
+};
+
+// Arrays, objects and strings of the result are allocated from resource,
+// which must outlive the result
+value parse(const std::string &name,
+            const std::string &text,
+            std::pmr::memory_resource *resource =
+                std::pmr::get_default_resource(),
+            enum mode mode = mode::scan);
+value parse_memory(const std::string &name,
+                   engine::memory::const_view input,
+                   std::pmr::memory_resource *resource =
+                       std::pmr::get_default_resource(),
+                   enum mode mode = mode::scan);
+value parse_file(const std::string &name,
+                 std::pmr::memory_resource *resource =
+                     std::pmr::get_default_resource(),
+                 enum mode mode = mode::scan);
 
 }; // namespace json
\ No newline at end of file
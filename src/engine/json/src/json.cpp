@@ -1,18 +1,26 @@
+#include <algorithm>
 #include <assert.h>
+#include <charconv>
 #include <ctype.h>
+#include <engine/filesystem.hpp>
 #include <engine/json.hpp>
-#include <fstream>
+#include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <string>
 
 class state
 {
   public:
-    std::string::const_iterator point;
-    const std::string::const_iterator end;
+    const char *point;
+    const char *const end;
     json::location location;
-    state(const std::string &_filename, const std::string &input)
-        : point(input.begin()), end(input.end()), location(_filename)
+    std::pmr::memory_resource *resource;
+    state(const std::string &_filename,
+          const char *begin,
+          const char *_end,
+          std::pmr::memory_resource *_resource)
+        : point(begin), end(_end), location(_filename), resource(_resource)
     {
     }
     bool skip_whitespace()
@@ -93,7 +101,7 @@ static json::string parse_string(state &state)
     if (state.next() != '"')
         throw state.get_exception("Expected a string");
 
-    json::string result;
+    json::string result(state.resource);
 
     bool escape = false;
 
@@ -187,85 +195,147 @@ json::number_int parse_digits(state &state)
     return result;
 }
 
-double parse_fraction(state &state)
+static inline bool is_digit(char c)
 {
-    std::string::const_iterator digits_begin = state.point;
-    uint64_t numerator = parse_digits(state);
-    std::string::const_iterator digits_end = state.point;
+    return c >= '0' && c <= '9';
+}
+
+// Powers of ten that doubles hold exactly
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Reads the text of a number. Integers without a fraction or a negative
+// exponent stay integers when they fit, everything else becomes the
+// nearest double.
+static json::number number_from_text(std::string_view text)
+{
+    const char *point = text.data();
+    const char *end = point + text.size();
+
+    const bool is_negative = point < end && *point == '-';
+    if (is_negative)
+        point++;
 
-    uint64_t denominator = 1;
+    // Up to 19 significant digits fit in the mantissa
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    int64_t exponent = 0;
+    bool is_float = false;
+
+    for (; point < end && is_digit(*point); point++)
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*point - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            digits++;
+            exponent++;
+        }
 
-    while (digits_begin < digits_end)
+    if (point < end && *point == '.')
     {
-        denominator *= 10;
-        digits_begin++;
-    }
+        is_float = true;
 
-    assert(numerator < denominator);
+        for (point++; point < end && is_digit(*point); point++)
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*point - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else
+                digits++;
+    }
 
-    return (double)numerator / (double)denominator;
-}
+    if (point < end && (*point == 'e' || *point == 'E'))
+    {
+        point++;
 
-static json::number parse_number(state &state)
-{
-    bool is_negative = state.peek() == '-';
+        const bool exponent_is_negative = point < end && *point == '-';
+        if (point < end && (*point == '-' || *point == '+'))
+            point++;
 
-    if (is_negative)
-        state.next();
+        int64_t written = 0;
+        for (; point < end && is_digit(*point); point++)
+            if (written < 100000)
+                written = written * 10 + (*point - '0');
 
-    json::number result = parse_digits(state);
+        exponent += exponent_is_negative ? -written : written;
+        is_float = is_float || exponent_is_negative;
+    }
 
-    int64_t exponent = 0;
+    const bool is_exact = digits <= 19;
 
-    if (state.point < state.end)
+    if (!is_float && is_exact && exponent >= 0 && exponent <= 18)
     {
-        char c = state.peek();
+        uint64_t result = mantissa;
+        bool fits = true;
 
-        if (c == '.')
+        for (int64_t i = 0; i < exponent && fits; i++)
         {
-            state.next();
-            json::number_float float_part = parse_fraction(state);
-            result = (json::number_float)result + float_part;
+            fits = result <= INT64_MAX / 10;
+            result *= 10;
         }
+
+        if (fits && result <= INT64_MAX)
+            return is_negative ? -(json::number_int)result
+                               : (json::number_int)result;
     }
 
-    if (state.point < state.end)
+    // Both the mantissa and the power are exact, so the one operation
+    // rounds correctly
+    if (is_exact && mantissa <= (uint64_t)1 << 53 && exponent >= -22 &&
+        exponent <= 22)
     {
-        char c = state.peek();
-        if (c == 'e' || c == 'E')
-        {
-            state.next();
-            char sign = state.peek();
-            if (sign == '-' || sign == '+')
-                state.next();
-            exponent = parse_digits(state);
-            if (sign == '-')
-            {
-                double result_f = static_cast<json::number_float>(result);
+        double result = mantissa;
 
-                while (exponent > 0)
-                {
-                    result_f /= 10;
-                    exponent--;
-                }
+        if (exponent < 0)
+            result /= exact_powers_of_ten[-exponent];
+        else
+            result *= exact_powers_of_ten[exponent];
 
-                result = result_f;
-            }
-            else
-            {
-                while (exponent > 0)
-                {
-                    result = result * 10;
-                    exponent--;
-                }
-            }
-        }
+        return is_negative ? -result : result;
     }
 
-    if (is_negative)
-        result = -result;
+    double result = 0;
+    const std::from_chars_result read =
+        std::from_chars(text.data(), end, result);
 
-    return result;
+    if (read.ec == std::errc::result_out_of_range)
+        result = exponent > 0 ? HUGE_VAL : 0;
+
+    return is_negative && read.ec != std::errc() ? -result : result;
+}
+
+static json::number parse_number(state &state)
+{
+    const char *begin = state.point;
+
+    if (state.peek() == '-')
+        state.next();
+
+    parse_digits(state);
+
+    if (state.point < state.end && state.peek() == '.')
+    {
+        state.next();
+        parse_digits(state);
+    }
+
+    if (state.point < state.end && (state.peek() == 'e' || state.peek() == 'E'))
+    {
+        state.next();
+        if (state.point < state.end &&
+            (state.peek() == '-' || state.peek() == '+'))
+            state.next();
+        parse_digits(state);
+    }
+
+    return number_from_text(std::string_view(begin, state.point - begin));
 }
 
 static json::value parse_bool(state &state)
@@ -297,7 +367,7 @@ static json::array parse_array(state &state)
     if (state.next() != '[')
         throw state.get_exception("Expected a JSON array");
 
-    json::array result;
+    json::array result(state.resource);
 
     bool expect_value = true;
 
@@ -345,19 +415,19 @@ static json::object parse_object(state &state)
     if (state.next() != '{')
         throw state.get_exception("Expected a JSON object");
 
-    json::object result;
+    json::object result(state.resource);
     state.skip_whitespace();
     if (state.peek() == '}')
         return result;
 
     while (state.skip_whitespace())
     {
-        std::string key = parse_string(state);
+        json::string key = parse_string(state);
 
         if (!state.skip_whitespace() || state.next() != ':')
             throw state.get_exception("Expected a ':' here");
 
-        result.emplace(key, parse_value(state));
+        result.emplace(std::move(key), parse_value(state));
 
         if (!state.skip_whitespace())
             throw state.get_exception(
@@ -399,38 +469,1497 @@ static json::value parse_value(state &state)
     throw state.get_exception("Empty input");
 }
 
-json::value json::parse(const std::string &name, const std::string &input)
+static const uint64_t all_ones = 0x0101010101010101ull;
+static const uint64_t all_highs = 0x8080808080808080ull;
+
+static inline uint64_t has_zero_byte(uint64_t word)
 {
-    state state(name, input);
+    return (word - all_ones) & ~word & all_highs;
+}
 
-    return parse_value(state);
+static inline uint64_t has_byte(uint64_t word, char c)
+{
+    return has_zero_byte(word ^ (all_ones * (uint8_t)c));
 }
 
-static std::string file_string(const std::string &file_path)
+static inline bool is_space(char c)
 {
-    std::ifstream stream(file_path);
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
 
-    if (stream)
+// Returns the first quote or backslash at or after point, or end
+static const char *skip_plain(const char *point, const char *end)
+{
+    while (end - point >= 8)
     {
-        std::string result;
-        stream.seekg(0, stream.end);
-        result.resize(stream.tellg());
-        stream.seekg(0, stream.beg);
-        stream.read(&result[0], result.size());
-        return result;
+        uint64_t word;
+        memcpy(&word, point, sizeof(word));
+        if (has_byte(word, '"') | has_byte(word, '\\'))
+            break;
+        point += 8;
     }
 
-    throw(errno);
+    while (point < end && *point != '"' && *point != '\\')
+        point++;
+
+    return point;
 }
 
-json::value json::parse_file(const std::string &name)
+static int hex_digit(char c)
 {
-    return parse(name, file_string(name));
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return 10 + c - 'a';
+    if (c >= 'A' && c <= 'F')
+        return 10 + c - 'A';
+    return -1;
 }
 
-json::value json::parse_memory(const std::string &name,
-                               engine::memory::const_view input)
+static void append_utf8(std::string &out, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        out.push_back(code);
+    }
+    else if (code < 0x800)
+    {
+        out.push_back(0xC0 | (code >> 6));
+        out.push_back(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+        out.push_back(0xE0 | (code >> 12));
+        out.push_back(0x80 | ((code >> 6) & 0x3F));
+        out.push_back(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        out.push_back(0xF0 | (code >> 18));
+        out.push_back(0x80 | ((code >> 12) & 0x3F));
+        out.push_back(0x80 | ((code >> 6) & 0x3F));
+        out.push_back(0x80 | (code & 0x3F));
+    }
+}
+
+json::scanner::scanner(std::string_view _name,
+                       const char *_begin,
+                       const char *_end)
+    : name(_name), begin(_begin), point(_begin), end(_end), token_begin(_begin)
+{
+}
+
+json::location json::scanner::location(size_t offset) const
+{
+    json::location result{std::string(name)};
+    const char *at = begin + std::min(offset, (size_t)(end - begin));
+    const char *line_begin = begin;
+
+    for (const char *it = begin; it < at; it++)
+        if (*it == '\n')
+        {
+            result.line++;
+            line_begin = it + 1;
+        }
+
+    result.col = at - line_begin + 1;
+
+    if (result.line == 1)
+        result.col += first_col - 1;
+    result.line += first_line - 1;
+
+    return result;
+}
+
+json::exception json::scanner::error(const std::string &message) const
+{
+    return json::exception(location(offset()), message);
+}
+
+json::scanner::token json::scanner::next()
+{
+    // Indentation comes in runs of spaces
+    while (end - point >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, point, sizeof(word));
+        if (word != all_ones * ' ')
+            break;
+        point += 8;
+    }
+
+    while (point < end && is_space(*point))
+        point++;
+
+    token_begin = point;
+
+    if (point == end)
+        return token::end;
+
+    switch (*point)
+    {
+    case '{':
+        point++;
+        return token::object_begin;
+    case '}':
+        point++;
+        return token::object_end;
+    case '[':
+        point++;
+        return token::array_begin;
+    case ']':
+        point++;
+        return token::array_end;
+    case ':':
+        point++;
+        return token::colon;
+    case ',':
+        point++;
+        return token::comma;
+    case '"':
+        if (scan_string())
+            return token::string;
+        break;
+    case 't':
+        if (scan_word("true", 4))
+            return token::true_value;
+        break;
+    case 'f':
+        if (scan_word("false", 5))
+            return token::false_value;
+        break;
+    case 'n':
+        if (scan_word("null", 4))
+            return token::null_value;
+        break;
+    default:
+        if (*point == '-' || is_digit(*point))
+        {
+            if (scan_number())
+                return token::number;
+            break;
+        }
+        throw error("Unexpected character");
+    }
+
+    // Cut off by the end of partial text
+    point = token_begin;
+    return token::end;
+}
+
+void json::scanner::skip(token current)
+{
+    if (current != token::object_begin && current != token::array_begin)
+        return;
+
+    size_t depth = 1;
+
+    while (point < end)
+    {
+        switch (*point++)
+        {
+        case '"':
+            while ((point = skip_plain(point, end)) < end && *point == '\\')
+                point += std::min<ptrdiff_t>(2, end - point);
+            if (point < end)
+                point++;
+            break;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0)
+                return;
+            break;
+        }
+    }
+
+    throw json::exception(location(point - begin),
+                          "Input ended while skipping a value");
+}
+
+bool json::scanner::scan_word(const char *word, size_t length)
+{
+    const size_t remaining = end - point;
+
+    if (partial && remaining < length && memcmp(point, word, remaining) == 0)
+        return false;
+    if (remaining < length || memcmp(point, word, length) != 0)
+        throw error(std::string("Invalid token, expected '") + word + "'");
+
+    point += length;
+    return true;
+}
+
+bool json::scanner::scan_string()
+{
+    const char *start = ++point;
+
+    point = skip_plain(point, end);
+
+    if (point < end && *point == '"')
+    {
+        token_text = std::string_view(start, point - start);
+        point++;
+        return true;
+    }
+
+    unescaped.assign(start, point);
+
+    while (point < end)
+    {
+        if (*point == '"')
+        {
+            point++;
+            token_text = unescaped;
+            return true;
+        }
+
+        if (*point != '\\')
+        {
+            const char *run = skip_plain(point, end);
+            unescaped.append(point, run);
+            point = run;
+            continue;
+        }
+
+        if (end - point < 2)
+            break;
+
+        point++;
+        switch (*point++)
+        {
+        case '"':
+            unescaped.push_back('"');
+            break;
+        case '\\':
+            unescaped.push_back('\\');
+            break;
+        case '/':
+            unescaped.push_back('/');
+            break;
+        case 'b':
+            unescaped.push_back('\b');
+            break;
+        case 'f':
+            unescaped.push_back('\f');
+            break;
+        case 'n':
+            unescaped.push_back('\n');
+            break;
+        case 'r':
+            unescaped.push_back('\r');
+            break;
+        case 't':
+            unescaped.push_back('\t');
+            break;
+        case 'u':
+        {
+            uint32_t code = 0;
+
+            for (size_t units = 0; units < 2; units++)
+            {
+                if (partial && end - point < 4)
+                    return false;
+                if (end - point < 4)
+                    throw json::exception(
+                        location(point - begin),
+                        "Started a unicode sequence with fewer than four "
+                        "characters remaining");
+
+                uint32_t unit = 0;
+
+                for (size_t i = 0; i < 4; i++)
+                {
+                    int digit = hex_digit(*point++);
+                    if (digit < 0)
+                        throw json::exception(
+                            location(point - begin - 1),
+                            "Attempted to interpret non-hex characters as "
+                            "hex");
+                    unit = unit * 16 + digit;
+                }
+
+                if (units == 1)
+                {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (unit - 0xDC00);
+                    break;
+                }
+
+                code = unit;
+
+                // The low surrogate may still be on its way
+                if (partial && unit >= 0xD800 && unit <= 0xDBFF &&
+                    end - point < 6)
+                    return false;
+
+                // A high surrogate is only whole with the low one after it
+                if (unit < 0xD800 || unit > 0xDBFF || end - point < 6 ||
+                    point[0] != '\\' || point[1] != 'u' ||
+                    hex_digit(point[2]) != 0xD ||
+                    hex_digit(point[3]) < 0xC)
+                    break;
+
+                point += 2;
+            }
+
+            append_utf8(unescaped, code);
+            break;
+        }
+        default:
+            throw json::exception(location(point - begin - 1),
+                                  "Invalid escape character");
+        }
+    }
+
+    if (partial)
+        return false;
+
+    throw json::exception(location(point - begin),
+                          "Input ended while parsing string");
+}
+
+bool json::scanner::scan_number()
+{
+    const char *start = point;
+
+    if (*point == '-')
+        point++;
+
+    const char *digits = point;
+    while (point < end && is_digit(*point))
+        point++;
+
+    // More digits could follow in partial text
+    if (partial && point == end)
+        return false;
+
+    if (point == digits)
+        throw json::exception(location(point - begin), "Expected a digit");
+
+    if (point < end && *point == '.')
+    {
+        digits = ++point;
+        while (point < end && is_digit(*point))
+            point++;
+
+        if (partial && point == end)
+            return false;
+        if (point == digits)
+            throw json::exception(location(point - begin),
+                                  "Expected a digit after '.'");
+    }
+
+    if (point < end && (*point == 'e' || *point == 'E'))
+    {
+        point++;
+        if (point < end && (*point == '-' || *point == '+'))
+            point++;
+
+        digits = point;
+        while (point < end && is_digit(*point))
+            point++;
+
+        if (partial && point == end)
+            return false;
+        if (point == digits)
+            throw json::exception(location(point - begin),
+                                  "Expected a digit in the exponent");
+    }
+
+    token_text = std::string_view(start, point - start);
+    return true;
+}
+
+using token = json::scanner::token;
+
+// Values are scanned into the slot that holds them, so the tree is built
+// without moving each value into place
+static void scan_value(json::value &out,
+                       json::scanner &scanner,
+                       token current,
+                       std::pmr::memory_resource *resource);
+
+static void scan_array(json::value &out,
+                       json::scanner &scanner,
+                       std::pmr::memory_resource *resource)
+{
+    json::array result(resource);
+
+    token current = scanner.next();
+
+    while (current != token::array_end)
+    {
+        scan_value(result.emplace_back(), scanner, current, resource);
+
+        current = scanner.next();
+        if (current == token::array_end)
+            break;
+        if (current != token::comma)
+            throw scanner.error("Expected ',' or ']' in array");
+
+        current = scanner.next();
+        if (current == token::array_end)
+            throw scanner.error("Dangling ',' at the end of the array");
+    }
+
+    out = std::move(result);
+}
+
+static void scan_object(json::value &out,
+                        json::scanner &scanner,
+                        std::pmr::memory_resource *resource)
+{
+    json::object result(resource);
+
+    token current = scanner.next();
+
+    while (current != token::object_end)
+    {
+        if (current != token::string)
+            throw scanner.error("Expected a string");
+
+        auto slot = result.try_emplace(json::string(scanner.text(), resource));
+
+        if (scanner.next() != token::colon)
+            throw scanner.error("Expected a ':' here");
+
+        // The first of repeated keys is kept
+        if (slot.second)
+            scan_value(slot.first->second, scanner, scanner.next(), resource);
+        else
+        {
+            json::value ignored;
+            scan_value(ignored, scanner, scanner.next(), resource);
+        }
+
+        current = scanner.next();
+        if (current == token::object_end)
+            break;
+        if (current != token::comma)
+            throw scanner.error("Unexpected character in object");
+
+        current = scanner.next();
+        if (current == token::object_end)
+            throw scanner.error("Dangling ',' at the end of the object");
+    }
+
+    out = std::move(result);
+}
+
+static void scan_value(json::value &out,
+                       json::scanner &scanner,
+                       token current,
+                       std::pmr::memory_resource *resource)
+{
+    switch (current)
+    {
+    case token::object_begin:
+        scan_object(out, scanner, resource);
+        break;
+    case token::array_begin:
+        scan_array(out, scanner, resource);
+        break;
+    case token::string:
+        out = json::string(scanner.text(), resource);
+        break;
+    case token::number:
+        out = number_from_text(scanner.text());
+        break;
+    case token::true_value:
+        out = json::value(true);
+        break;
+    case token::false_value:
+        out = json::value(false);
+        break;
+    case token::null_value:
+        break;
+    case token::end:
+        throw scanner.error("Input ended while reading a value");
+    default:
+        throw scanner.error("Unexpected character");
+    }
+}
+
+// Reads the text where it is, without copying it
+static json::value parse_range(const std::string &name,
+                               const char *begin,
+                               const char *end,
+                               std::pmr::memory_resource *resource,
+                               enum json::mode mode)
 {
-    std::string text((const char *)&input.begin[0], input.end - input.begin);
-    return json::parse(name, text);
-}
\ No newline at end of file
+    if (mode == json::mode::step)
+    {
+        state state(name, begin, end, resource);
+
+        return parse_value(state);
+    }
+
+    json::scanner scanner(name, begin, end);
+    json::value result;
+    scan_value(result, scanner, scanner.next(), resource);
+
+    if (scanner.next() != token::end)
+        throw scanner.error("Unexpected data after the document");
+
+    return result;
+}
+
+json::value json::parse(const std::string &name,
+                        const std::string &input,
+                        std::pmr::memory_resource *resource,
+                        enum mode mode)
+{
+    return parse_range(name,
+                       input.data(),
+                       input.data() + input.size(),
+                       resource,
+                       mode);
+}
+
+json::value json::parse_file(const std::string &name,
+                             std::pmr::memory_resource *resource,
+                             enum mode mode)
+{
+    // The mapping only has to last until the tree is built, since strings
+    // are copied into resource
+    const engine::filesystem::mapping file(name);
+    return parse_memory(name, file, resource, mode);
+}
+
+json::value json::parse_memory(const std::string &name,
+                               engine::memory::const_view input,
+                               std::pmr::memory_resource *resource,
+                               enum mode mode)
+{
+    return parse_range(name,
+                       (const char *)input.data(),
+                       (const char *)input.data() + input.size(),
+                       resource,
+                       mode);
+}
+
+json::tape::tape(const std::string &_name,
+                 const char *_begin,
+                 const char *_end,
+                 std::pmr::memory_resource *resource)
+    : name(_name), begin(_begin), end(_end), elements(resource),
+      offsets(resource), unescaped(resource)
+{
+    if ((size_t)(end - begin) > UINT32_MAX)
+        throw json::exception(location(0), "Too large for a tape");
+
+    // Compact glTF JSON has about one element per eight bytes
+    elements.reserve((end - begin) / 8 + 1);
+    offsets.reserve((end - begin) / 8 + 1);
+
+    json::scanner scanner(name, begin, end);
+    build(scanner, scanner.next());
+
+    if (scanner.next() != token::end)
+        throw scanner.error("Unexpected data after the document");
+}
+
+void json::tape::build(json::scanner &scanner, scanner::token current)
+{
+    const uint32_t index = elements.size();
+    elements.emplace_back();
+    offsets.push_back(scanner.offset());
+
+    element &added = elements.back();
+
+    switch (current)
+    {
+    case token::object_begin:
+    case token::array_begin:
+    {
+        const bool is_object = current == token::object_begin;
+        const token close = is_object ? token::object_end : token::array_end;
+        uint32_t count = 0;
+
+        added.type = is_object ? type::object : type::array;
+        current = scanner.next();
+
+        while (current != close)
+        {
+            if (is_object)
+            {
+                if (current != token::string)
+                    throw scanner.error("Expected a string");
+
+                build(scanner, current);
+
+                if (scanner.next() != token::colon)
+                    throw scanner.error("Expected a ':' here");
+
+                current = scanner.next();
+            }
+
+            build(scanner, current);
+            count++;
+
+            current = scanner.next();
+            if (current == close)
+                break;
+            if (current != token::comma)
+                throw scanner.error(is_object ? "Unexpected character in object"
+                                              : "Expected ',' or ']' in array");
+
+            current = scanner.next();
+            if (current == close)
+                throw scanner.error("Dangling ',' at the end of a container");
+        }
+
+        // Building the contents may have moved the elements
+        elements[index].count = count;
+        break;
+    }
+    case token::string:
+    {
+        const std::string_view text = scanner.text();
+
+        added.type = type::string;
+        added.text.length = text.size();
+
+        if (text.data() >= begin && text.data() <= end)
+        {
+            added.text.offset = text.data() - begin;
+        }
+        else
+        {
+            added.unescaped = true;
+            added.text.offset = unescaped.size();
+            unescaped.append(text);
+        }
+        break;
+    }
+    case token::number:
+    {
+        const json::number number = number_from_text(scanner.text());
+
+        if (number.is_int())
+        {
+            added.type = type::integer;
+            added.integer = number.as_int();
+        }
+        else
+        {
+            added.type = type::real;
+            added.real = number.as_float();
+        }
+        break;
+    }
+    case token::true_value:
+    case token::false_value:
+        added.type = type::boolean;
+        added.boolean = current == token::true_value;
+        break;
+    case token::null_value:
+        added.type = type::null;
+        break;
+    case token::end:
+        throw scanner.error("Input ended while reading a value");
+    default:
+        throw scanner.error("Unexpected character");
+    }
+
+    elements[index].next = elements.size();
+}
+
+json::cursor json::tape::root() const
+{
+    return cursor(this, 0);
+}
+
+json::location json::tape::location(uint32_t index) const
+{
+    json::scanner scanner(name, begin, end);
+    return scanner.location(index < offsets.size() ? offsets[index] : 0);
+}
+
+json::cursor::iterator json::cursor::begin() const
+{
+    const tape::element &element = get();
+
+    if (element.type != tape::type::array && element.type != tape::type::object)
+        throw error("Expected an array or an object");
+
+    return iterator(document, index + 1, element.type == tape::type::object);
+}
+
+json::cursor::iterator json::cursor::end() const
+{
+    const tape::element &element = get();
+    return iterator(document, element.next, element.type == tape::type::object);
+}
+
+size_t json::cursor::size() const
+{
+    const tape::element &element = get();
+
+    if (element.type != tape::type::array && element.type != tape::type::object)
+        throw error("Expected an array or an object");
+
+    return element.count;
+}
+
+json::cursor json::cursor::find(std::string_view key) const
+{
+    const tape::element &object = get(tape::type::object, "Expected an object");
+
+    for (uint32_t member = index + 1; member < object.next;
+         member = (*document)[member + 1].next)
+        if (document->text((*document)[member]) == key)
+            return cursor(document, member + 1);
+
+    return cursor();
+}
+
+json::cursor json::cursor::at(std::string_view key) const
+{
+    const cursor result = find(key);
+
+    if (!result)
+        throw error("Missing key '" + std::string(key) + "'");
+
+    return result;
+}
+
+json::cursor json::cursor::operator[](size_t position) const
+{
+    const tape::element &array = get(tape::type::array, "Expected an array");
+
+    if (position >= array.count)
+        throw error("Array index out of range");
+
+    uint32_t element = index + 1;
+    while (position--)
+        element = (*document)[element].next;
+
+    return cursor(document, element);
+}
+
+json::number_int json::cursor::as_int() const
+{
+    const tape::element &element = get();
+
+    if (element.type == tape::type::integer)
+        return element.integer;
+    if (element.type == tape::type::real)
+        return element.real;
+
+    throw error("Expected a number");
+}
+
+json::number_float json::cursor::as_float() const
+{
+    const tape::element &element = get();
+
+    if (element.type == tape::type::real)
+        return element.real;
+    if (element.type == tape::type::integer)
+        return element.integer;
+
+    throw error("Expected a number");
+}
+
+json::number_int json::cursor::strict_int() const
+{
+    const tape::element &element = get();
+
+    if (element.type == tape::type::integer)
+        return element.integer;
+    if (element.type == tape::type::real)
+        throw error("Expected an int, not a float");
+
+    throw error("Expected a number");
+}
+
+json::number_float json::cursor::strict_float() const
+{
+    const tape::element &element = get();
+
+    if (element.type == tape::type::real)
+        return element.real;
+    if (element.type == tape::type::integer)
+        throw error("Expected a float, not an int");
+
+    throw error("Expected a number");
+}
+
+json::lazy::iterator::iterator(const document *_source)
+    : source(_source), scanner({}, nullptr, nullptr), current(token::end),
+      element(nullptr), members(false)
+{
+}
+
+json::lazy::iterator::iterator(const document *_source, const char *value)
+    : source(_source), scanner(source->name, source->begin, source->end),
+      current(token::end), element(nullptr), members(false)
+{
+    scanner.seek(value);
+
+    const token first = scanner.next();
+
+    if (first != token::object_begin && first != token::array_begin)
+        throw scanner.error("Expected an array or an object");
+
+    members = first == token::object_begin;
+    read_element(scanner.next());
+}
+
+void json::lazy::iterator::read_element(token first)
+{
+    if (first == (members ? token::object_end : token::array_end))
+    {
+        element = nullptr;
+        return;
+    }
+
+    if (members)
+    {
+        if (first != token::string)
+            throw scanner.error("Expected a string");
+
+        member_key = scanner.text();
+
+        // Scanning the value would overwrite a key that had escapes
+        if (member_key.data() < source->begin ||
+            member_key.data() > source->end)
+            member_key = key_buffer.assign(member_key);
+
+        if (scanner.next() != token::colon)
+            throw scanner.error("Expected a ':' here");
+
+        first = scanner.next();
+    }
+
+    if (first == token::end)
+        throw scanner.error("Input ended while reading a value");
+
+    current = first;
+    element = source->begin + scanner.offset();
+}
+
+json::lazy::iterator &json::lazy::iterator::operator++()
+{
+    scanner.skip(current);
+
+    const token next = scanner.next();
+
+    if (next == (members ? token::object_end : token::array_end))
+        element = nullptr;
+    else if (next == token::comma)
+        read_element(scanner.next());
+    else
+        throw scanner.error(members ? "Unexpected character in object"
+                                    : "Expected ',' or ']' in array");
+
+    return *this;
+}
+
+json::scanner json::lazy::scan(token &first) const
+{
+    if (!source)
+        throw json::exception(json::location(), "Value does not exist");
+
+    json::scanner scanner(source->name, source->begin, source->end);
+    scanner.seek(point);
+    first = scanner.next();
+    return scanner;
+}
+
+enum json::tape::type json::lazy::type() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+
+    switch (first)
+    {
+    case token::object_begin:
+        return tape::type::object;
+    case token::array_begin:
+        return tape::type::array;
+    case token::string:
+        return tape::type::string;
+    case token::number:
+    {
+        const std::string_view text = scanner.text();
+        return text.find_first_of(".eE") == std::string_view::npos
+                   ? tape::type::integer
+                   : tape::type::real;
+    }
+    case token::true_value:
+    case token::false_value:
+        return tape::type::boolean;
+    case token::null_value:
+        return tape::type::null;
+    default:
+        throw scanner.error("Expected a value");
+    }
+}
+
+size_t json::lazy::size() const
+{
+    size_t count = 0;
+
+    for (iterator it = begin(); it != end(); ++it)
+        count++;
+
+    return count;
+}
+
+json::lazy json::lazy::find(std::string_view key) const
+{
+    token current;
+    json::scanner scanner = scan(current);
+
+    if (current != token::object_begin)
+        throw scanner.error("Expected an object");
+
+    current = scanner.next();
+
+    while (current != token::object_end)
+    {
+        if (current != token::string)
+            throw scanner.error("Expected a string");
+
+        const bool match = scanner.text() == key;
+
+        if (scanner.next() != token::colon)
+            throw scanner.error("Expected a ':' here");
+
+        current = scanner.next();
+        if (current == token::end)
+            throw scanner.error("Input ended while reading a value");
+
+        if (match)
+            return lazy(source, source->begin + scanner.offset());
+
+        scanner.skip(current);
+
+        current = scanner.next();
+        if (current == token::object_end)
+            break;
+        if (current != token::comma)
+            throw scanner.error("Unexpected character in object");
+
+        current = scanner.next();
+        if (current == token::object_end)
+            throw scanner.error("Dangling ',' at the end of the object");
+    }
+
+    return lazy();
+}
+
+json::lazy json::lazy::at(std::string_view key) const
+{
+    const lazy result = find(key);
+
+    if (!result)
+        throw error("Missing key '" + std::string(key) + "'");
+
+    return result;
+}
+
+json::lazy json::lazy::operator[](size_t position) const
+{
+    token first;
+    json::scanner scanner = scan(first);
+
+    if (first != token::array_begin)
+        throw scanner.error("Expected an array");
+
+    iterator it = begin();
+
+    for (; it != end() && position; ++it)
+        position--;
+
+    if (it == end())
+        throw error("Array index out of range");
+
+    return *it;
+}
+
+bool json::lazy::as_bool() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+
+    if (first == token::true_value)
+        return true;
+    if (first == token::false_value)
+        return false;
+
+    throw scanner.error("Expected a bool");
+}
+
+std::string json::lazy::as_string() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+
+    if (first != token::string)
+        throw scanner.error("Expected a string");
+
+    return std::string(scanner.text());
+}
+
+// Reads the number at point, throwing if there is none
+static json::number lazy_number(json::scanner &scanner, token first)
+{
+    if (first != token::number)
+        throw scanner.error("Expected a number");
+
+    return number_from_text(scanner.text());
+}
+
+json::number_int json::lazy::as_int() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+
+    return lazy_number(scanner, first).as_int();
+}
+
+json::number_float json::lazy::as_float() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+
+    return lazy_number(scanner, first).as_float();
+}
+
+json::number_int json::lazy::strict_int() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+    const json::number number = lazy_number(scanner, first);
+
+    if (!number.is_int())
+        throw scanner.error("Expected an int, not a float");
+
+    return number.as_int();
+}
+
+json::number_float json::lazy::strict_float() const
+{
+    token first;
+    json::scanner scanner = scan(first);
+    const json::number number = lazy_number(scanner, first);
+
+    if (number.is_int())
+        throw scanner.error("Expected a float, not an int");
+
+    return number.as_float();
+}
+
+json::exception json::lazy::error(const std::string &message) const
+{
+    if (!source)
+        return json::exception(json::location(), message);
+
+    json::scanner scanner(source->name, source->begin, source->end);
+    return json::exception(scanner.location(point - source->begin), message);
+}
+
+json::stream::stream(const std::string &_name, json::handler &_handler)
+    : name(_name), handler(_handler)
+{
+}
+
+bool json::stream::feed(const char *begin, const char *end)
+{
+    if (stopped)
+        return false;
+
+    if (pending.empty())
+    {
+        pending.assign(read(begin, end, false), end);
+    }
+    else
+    {
+        pending.append(begin, end);
+        const char *rest =
+            read(pending.data(), pending.data() + pending.size(), false);
+        pending.erase(0, rest - pending.data());
+    }
+
+    return !stopped;
+}
+
+void json::stream::finish()
+{
+    if (stopped)
+        return;
+
+    read(pending.data(), pending.data() + pending.size(), true);
+    pending.clear();
+}
+
+const char *json::stream::read(const char *begin, const char *end, bool last)
+{
+    json::scanner scanner(name, begin, end);
+    scanner.starts_at(line, col);
+    scanner.set_partial(!last);
+
+    while (!stopped)
+    {
+        const token current = scanner.next();
+
+        if (current == token::end)
+        {
+            if (last && state != expect::done)
+                throw scanner.error("Input ended while reading a value");
+            break;
+        }
+
+        stopped = !dispatch(scanner, current);
+    }
+
+    const char *rest = scanner.position();
+    const char *line_begin = nullptr;
+
+    for (const char *it = begin;
+         (it = (const char *)memchr(it, '\n', rest - it));
+         it++)
+    {
+        line++;
+        line_begin = it + 1;
+    }
+
+    col = line_begin ? rest - line_begin + 1 : col + (rest - begin);
+
+    return rest;
+}
+
+bool json::stream::dispatch(json::scanner &scanner, token current)
+{
+    switch (state)
+    {
+    case expect::value_or_end:
+        if (current == token::array_end)
+            return close(scanner, current);
+        return value(scanner, current);
+    case expect::value:
+        return value(scanner, current);
+    case expect::key_or_end:
+        if (current == token::object_end)
+            return close(scanner, current);
+        [[fallthrough]];
+    case expect::key:
+        if (current != token::string)
+            throw scanner.error("Expected a string");
+        state = expect::colon;
+        return handler.key(scanner.text());
+    case expect::colon:
+        if (current != token::colon)
+            throw scanner.error("Expected a ':' here");
+        state = expect::value;
+        return true;
+    case expect::comma_or_end:
+        if (current == token::comma)
+        {
+            state = containers.back() ? expect::key : expect::value;
+            return true;
+        }
+        if (current == token::object_end || current == token::array_end)
+            return close(scanner, current);
+        throw scanner.error(containers.back() ? "Unexpected character in object"
+                                              : "Expected ',' or ']' in array");
+    case expect::done:
+        throw scanner.error("Unexpected data after the document");
+    }
+
+    return true;
+}
+
+bool json::stream::close(json::scanner &scanner, token current)
+{
+    const bool is_object = current == token::object_end;
+
+    if (containers.back() != is_object)
+        throw scanner.error(is_object ? "Expected ',' or ']' in array"
+                                      : "Unexpected character in object");
+
+    containers.pop_back();
+    state = containers.empty() ? expect::done : expect::comma_or_end;
+
+    return is_object ? handler.end_object() : handler.end_array();
+}
+
+bool json::stream::value(json::scanner &scanner, token current)
+{
+    state = containers.empty() ? expect::done : expect::comma_or_end;
+
+    switch (current)
+    {
+    case token::object_begin:
+        containers.push_back(true);
+        state = expect::key_or_end;
+        return handler.start_object();
+    case token::array_begin:
+        containers.push_back(false);
+        state = expect::value_or_end;
+        return handler.start_array();
+    case token::string:
+        return handler.string(scanner.text());
+    case token::number:
+        return handler.number(number_from_text(scanner.text()));
+    case token::true_value:
+    case token::false_value:
+        return handler.boolean(current == token::true_value);
+    case token::null_value:
+        return handler.null();
+    default:
+        throw scanner.error("Unexpected character");
+    }
+}
+
+json::writer::writer(std::string &_out, enum style _style)
+    : out(_out), layout(_style)
+{
+}
+
+void json::writer::newline()
+{
+    out.push_back('\n');
+    out.append(depth * 4, ' ');
+}
+
+void json::writer::separate()
+{
+    if (after_key)
+    {
+        after_key = false;
+        return;
+    }
+
+    if (!first)
+        out.push_back(',');
+    if (layout == style::pretty && depth > 0)
+        newline();
+
+    first = false;
+}
+
+// Sets the high bit of each byte that needs escaping
+static inline uint64_t needs_escape(uint64_t word)
+{
+    const uint64_t control = (word - all_ones * 0x20) & ~word & all_highs;
+    return control | has_byte(word, '"') | has_byte(word, '\\');
+}
+
+void json::writer::write_string(std::string_view string)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    const char *point = string.data();
+    const char *end = point + string.size();
+
+    out.push_back('"');
+
+    while (point < end)
+    {
+        const char *run = point;
+
+        while (end - run >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, run, sizeof(word));
+            if (needs_escape(word))
+                break;
+            run += 8;
+        }
+
+        while (run < end && (uint8_t)*run >= 0x20 && *run != '"' &&
+               *run != '\\')
+            run++;
+
+        out.append(point, run);
+        point = run;
+
+        if (point == end)
+            break;
+
+        const char c = *point++;
+
+        switch (c)
+        {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\b':
+            out.append("\\b");
+            break;
+        case '\f':
+            out.append("\\f");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+            out.append("\\u00");
+            out.push_back(hex[(uint8_t)c >> 4]);
+            out.push_back(hex[c & 0xF]);
+        }
+    }
+
+    out.push_back('"');
+}
+
+bool json::writer::start_object()
+{
+    separate();
+    out.push_back('{');
+    depth++;
+    first = true;
+    return true;
+}
+
+bool json::writer::key(std::string_view key)
+{
+    separate();
+    write_string(key);
+    out.append(layout == style::pretty ? ": " : ":");
+    after_key = true;
+    return true;
+}
+
+bool json::writer::end_object()
+{
+    depth--;
+    if (layout == style::pretty && !first)
+        newline();
+    out.push_back('}');
+    first = false;
+    return true;
+}
+
+bool json::writer::start_array()
+{
+    separate();
+    out.push_back('[');
+    depth++;
+    first = true;
+    return true;
+}
+
+bool json::writer::end_array()
+{
+    depth--;
+    if (layout == style::pretty && !first)
+        newline();
+    out.push_back(']');
+    first = false;
+    return true;
+}
+
+bool json::writer::string(std::string_view string)
+{
+    separate();
+    write_string(string);
+    return true;
+}
+
+bool json::writer::number(const json::number &number)
+{
+    separate();
+
+    char text[32];
+    char *text_end;
+
+    if (number.is_int())
+    {
+        text_end =
+            std::to_chars(text, text + sizeof(text), number.as_int()).ptr;
+        out.append(text, text_end);
+        return true;
+    }
+
+    const double value = number.as_float();
+
+    // JSON has no infinities or NaN
+    if (!std::isfinite(value))
+    {
+        out.append("null");
+        return true;
+    }
+
+    text_end = std::to_chars(text, text + sizeof(text), value).ptr;
+
+    char *exponent = std::find(text, text_end, 'e');
+    if (std::find(text, exponent, '.') == exponent)
+    {
+        out.append(text, exponent);
+        out.append(".0");
+        out.append(exponent, text_end);
+    }
+    else
+        out.append(text, text_end);
+
+    return true;
+}
+
+bool json::writer::boolean(bool boolean)
+{
+    separate();
+    out.append(boolean ? "true" : "false");
+    return true;
+}
+
+bool json::writer::null()
+{
+    separate();
+    out.append("null");
+    return true;
+}
+
+void json::writer::write(const json::value &value)
+{
+    const auto &contents = value.contents;
+
+    if (std::holds_alternative<json::object>(contents))
+    {
+        start_object();
+        for (const auto &[name, member] : std::get<json::object>(contents))
+        {
+            key(name);
+            write(member);
+        }
+        end_object();
+    }
+    else if (std::holds_alternative<json::array>(contents))
+    {
+        start_array();
+        for (const json::value &element : std::get<json::array>(contents))
+            write(element);
+        end_array();
+    }
+    else if (std::holds_alternative<json::string>(contents))
+        string(std::get<json::string>(contents));
+    else if (std::holds_alternative<json::number>(contents))
+        number(std::get<json::number>(contents));
+    else if (std::holds_alternative<bool>(contents))
+        boolean(std::get<bool>(contents));
+    else
+        null();
+}
+
+std::string json::write(const value &value, enum writer::style style)
+{
+    std::string result;
+    writer(result, style).write(value);
+    return result;
+}
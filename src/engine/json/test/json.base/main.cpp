@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <assert.h>
 #include <engine/json.hpp>
+#include <fstream>
 #include <iostream>
+#include <math.h>
 
-void test_json_1(const std::string &file_path)
+void test_json_1(const std::string &file_path, json::mode mode)
 {
-    json::value root = json::parse_file(file_path);
+    json::value root =
+        json::parse_file(file_path, std::pmr::get_default_resource(), mode);
 
     json::object key1 = root["key1"];
     json::number ababab = root["ababab"];
@@ -22,17 +26,413 @@ void test_json_1(const std::string &file_path)
     assert(nest1["nest4"] == "abc");
 }
 
-void test_json_2(const std::string &file_path)
+void test_json_2(const std::string &file_path, json::mode mode)
 {
-    json::value root = json::parse_file(file_path);
+    json::value root =
+        json::parse_file(file_path, std::pmr::get_default_resource(), mode);
+}
+
+// Only the viewed bytes are read, which need not end the buffer
+void test_memory()
+{
+    const std::string text = "{\"a\": [1, 23]}trailing";
+    const engine::memory::const_view view((const uint8_t *)text.data(),
+                                          text.find("trailing"));
+
+    for (json::mode mode : {json::mode::scan, json::mode::step})
+    {
+        json::value root = json::parse_memory(
+            "memory", view, std::pmr::get_default_resource(), mode);
+        json::array a = root["a"];
+        assert(a.size() == 2);
+        assert(a[1].strict_int() == 23);
+    }
+
+    const engine::memory::const_view number((const uint8_t *)text.data() + 10,
+                                            1);
+    json::value root = json::parse_memory("number", number);
+    assert(root.strict_int() == 2);
+}
+
+void test_escapes()
+{
+    json::value root = json::parse("escapes",
+                                   R"({"plain": "abc",
+                                       "quoted": "a\"b\\c\/",
+                                       "unicode": "\u00e9\ud83d\ude00"})");
+
+    assert(root["plain"] == "abc");
+    assert(root["quoted"] == "a\"b\\c/");
+    assert(root["unicode"] == "\xc3\xa9\xf0\x9f\x98\x80");
+
+    try
+    {
+        json::parse("broken", "{\n  \"a\": [1, 2,]\n}");
+        assert(false);
+    }
+    catch (json::exception &e)
+    {
+        assert(e.location.line == 2);
+        assert(e.location.col == 14);
+    }
+
+    for (json::mode mode : {json::mode::scan, json::mode::step})
+    {
+        bool threw = false;
+        try
+        {
+            json::parse("dangling",
+                        "{\"a\": 1,}",
+                        std::pmr::get_default_resource(),
+                        mode);
+        }
+        catch (json::exception &)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+}
+
+void test_tape(const std::string &file_path)
+{
+    std::ifstream stream(file_path);
+    const std::string text((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+
+    json::tape tape(file_path, text.data(), text.data() + text.size());
+    json::cursor root = tape.root();
+
+    assert(root.size() == 5);
+    assert(root.at("ababab").strict_int() == 10000);
+    assert(!root.find("missing"));
+
+    json::cursor asdf2 = root.at("asdf2");
+    assert(asdf2.size() == 3);
+    assert(asdf2[0].strict_int() == 5);
+    assert(asdf2[1].as_string() == "a2");
+    assert(asdf2[2].strict_int() == 9);
+
+    json::cursor nest1 = root.at("nest1");
+    assert(nest1.at("nest2").strict_float() == 3.14);
+    assert(nest1.at("nest3").as_string() == "aaa");
+
+    size_t sum = 0;
+    for (json::cursor number : root.at("key1").at("nestedkey1"))
+        sum += number.strict_int();
+    assert(sum == 10);
+
+    std::string keys;
+    for (json::cursor::iterator it = nest1.begin(); it != nest1.end(); ++it)
+        keys += it.key();
+    assert(keys == "nest2nest3nest4");
+
+    try
+    {
+        root.at("asdf").strict_int();
+        assert(false);
+    }
+    catch (json::exception &e)
+    {
+        assert(e.location.line == 11);
+    }
+
+    const std::string escaped = R"(["a\tb", "plain"])";
+    json::tape escapes("escapes",
+                       escaped.data(),
+                       escaped.data() + escaped.size());
+    assert(escapes.root()[0].as_string() == "a\tb");
+    assert(escapes.root()[1].as_string() == "plain");
+}
+
+void test_lazy(const std::string &file_path)
+{
+    std::ifstream stream(file_path);
+    const std::string text((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+
+    json::lazy::document document(file_path,
+                                  text.data(),
+                                  text.data() + text.size());
+    json::lazy root = document.root();
+
+    assert(root.size() == 5);
+    assert(root.type() == json::tape::type::object);
+    assert(root.at("ababab").strict_int() == 10000);
+    assert(!root.find("missing"));
+
+    json::lazy asdf2 = root.at("asdf2");
+    assert(asdf2.size() == 3);
+    assert(asdf2[0].strict_int() == 5);
+    assert(asdf2[1].as_string() == "a2");
+    assert(asdf2[2].strict_int() == 9);
+
+    json::lazy nest1 = root.at("nest1");
+    assert(nest1.at("nest2").type() == json::tape::type::real);
+    assert(nest1.at("nest2").strict_float() == 3.14);
+    assert(nest1.at("nest3").as_string() == "aaa");
+
+    size_t sum = 0;
+    for (json::lazy number : root.at("key1").at("nestedkey1"))
+        sum += number.strict_int();
+    assert(sum == 10);
+
+    std::string keys;
+    for (json::lazy::iterator it = nest1.begin(); it != nest1.end(); ++it)
+        keys += it.key();
+    assert(keys == "nest2nest3nest4");
+
+    try
+    {
+        root.at("asdf").strict_int();
+        assert(false);
+    }
+    catch (json::exception &e)
+    {
+        assert(e.location.line == 11);
+    }
+
+    // Skipped values are not checked, only the ones that are read
+    const std::string partial = R"({"a\tb": "x\"}\\", "bad": [1, }, "c": 2})";
+    json::lazy::document partial_document("partial",
+                                          partial.data(),
+                                          partial.data() + partial.size());
+    json::lazy partial_root = partial_document.root();
+    assert(partial_root.at("c").strict_int() == 2);
+    assert(partial_root.at("a\tb").as_string() == "x\"}\\");
+
+    std::string partial_keys;
+    for (json::lazy::iterator it = partial_root.begin();
+         it != partial_root.end();
+         ++it)
+        partial_keys += it.key();
+    assert(partial_keys == "a\tbbadc");
+
+    try
+    {
+        partial_root.at("bad")[1].as_int();
+        assert(false);
+    }
+    catch (json::exception &e)
+    {
+        assert(e.location.col == 31);
+    }
+
+    // Looking past the last member finds a trailing comma
+    const std::string dangling = R"({"a": 1,})";
+    json::lazy::document dangling_document(
+        "dangling", dangling.data(), dangling.data() + dangling.size());
+    try
+    {
+        dangling_document.root().find("b");
+        assert(false);
+    }
+    catch (json::exception &e)
+    {
+        assert(e.location.col == 9);
+    }
+}
+
+// Writes down everything it is given, and stops at stop_key if set
+class transcript : public json::handler
+{
+  public:
+    std::string text;
+    std::string stop_key;
+
+    bool start_object() override
+    {
+        text += "{";
+        return true;
+    }
+    bool key(std::string_view key) override
+    {
+        text += std::string(key) + ":";
+        return key != stop_key;
+    }
+    bool end_object() override
+    {
+        text += "}";
+        return true;
+    }
+    bool start_array() override
+    {
+        text += "[";
+        return true;
+    }
+    bool end_array() override
+    {
+        text += "]";
+        return true;
+    }
+    bool string(std::string_view string) override
+    {
+        text += "'" + std::string(string) + "' ";
+        return true;
+    }
+    bool number(const json::number &number) override
+    {
+        text += std::to_string(number.as_float()) + " ";
+        return true;
+    }
+    bool boolean(bool boolean) override
+    {
+        text += boolean ? "true " : "false ";
+        return true;
+    }
+    bool null() override
+    {
+        text += "null ";
+        return true;
+    }
+};
+
+static std::string stream_in_pieces(const std::string &text, size_t piece)
+{
+    transcript events;
+    json::stream stream("pieces", events);
+
+    for (size_t i = 0; i < text.size(); i += piece)
+    {
+        const size_t size = std::min(piece, text.size() - i);
+        assert(stream.feed(text.data() + i, text.data() + i + size));
+    }
+    stream.finish();
+
+    return events.text;
+}
+
+void test_stream(const std::string &file_path)
+{
+    std::ifstream stream(file_path);
+    const std::string text((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+
+    const std::string whole = stream_in_pieces(text, text.size());
+    assert(whole.find("nest1:{nest2:3.140000 nest3:'aaa' ") !=
+           std::string::npos);
+
+    for (size_t piece = 1; piece < 16; piece++)
+        assert(stream_in_pieces(text, piece) == whole);
+
+    const std::string escaped = R"(["a\tb", -1.5e1, true, null])";
+    for (size_t piece = 1; piece < escaped.size(); piece++)
+        assert(stream_in_pieces(escaped, piece) ==
+               "['a\tb' -15.000000 true null ]");
+
+    // A surrogate pair stays whole wherever the text is split
+    const std::string pair = R"(["\uD83D\uDE00"])";
+    for (size_t split = 1; split < pair.size(); split++)
+    {
+        transcript events;
+        json::stream stream("pair", events);
+        assert(stream.feed(pair.data(), pair.data() + split));
+        assert(stream.feed(pair.data() + split, pair.data() + pair.size()));
+        stream.finish();
+        assert(events.text == "['\xF0\x9F\x98\x80' ]");
+    }
+
+    transcript stopping;
+    stopping.stop_key = "asdf2";
+    json::stream stopped("stopped", stopping);
+    assert(!stopped.feed(text.data(), text.data() + text.size()));
+    assert(!stopped.feed(text.data(), text.data() + text.size()));
+    stopped.finish();
+    assert(stopping.text.size() < whole.size());
+    assert(stopping.text.substr(stopping.text.size() - 6) == "asdf2:");
+
+    const std::string broken = "{\n  \"a\": [1, 2,]\n}";
+    for (size_t piece : {(size_t)1, (size_t)5, broken.size()})
+        try
+        {
+            stream_in_pieces(broken, piece);
+            assert(false);
+        }
+        catch (json::exception &e)
+        {
+            assert(e.location.line == 2);
+            assert(e.location.col == 14);
+        }
+
+    try
+    {
+        stream_in_pieces("[1, [2]", 3);
+        assert(false);
+    }
+    catch (json::exception &e)
+    {
+        assert(e.location.col == 8);
+    }
+}
+
+void test_write(const std::string &file_path)
+{
+    std::ifstream file(file_path);
+    const std::string text((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Streaming into a writer keeps the order of the members
+    std::string pretty;
+    json::writer pretty_writer(pretty, json::writer::style::pretty);
+    json::stream pretty_stream("pretty", pretty_writer);
+    pretty_stream.feed(text.data(), text.data() + text.size());
+    pretty_stream.finish();
+    assert(pretty + "\n" == text || pretty == text);
+
+    std::string compact;
+    json::writer compact_writer(compact);
+    json::stream compact_stream("compact", compact_writer);
+    compact_stream.feed(text.data(), text.data() + text.size());
+    compact_stream.finish();
+    assert(compact == R"({"key1":{"nestedkey1":[1,2,3,4]},"ababab":10000,)"
+                      R"("asdf":12.34,"asdf2":[5,"a2",9],)"
+                      R"("nest1":{"nest2":3.14,"nest3":"aaa","nest4":"abc"}})");
+
+    const std::string rewritten = json::write(json::parse_file(file_path));
+    json::value root = json::parse("rewritten", rewritten);
+    json::array asdf2 = root["asdf2"];
+    assert(asdf2[1] == "a2");
+    assert(root["nest1"]["nest2"].strict_float() == 3.14);
+
+    json::array values(std::pmr::get_default_resource());
+    values.emplace_back(json::number(0.1));
+    values.emplace_back(json::number(3.0));
+    values.emplace_back(json::number(-0.0));
+    values.emplace_back(json::number(1e300));
+    values.emplace_back(json::number(HUGE_VAL));
+    values.emplace_back(json::number((json::number_int)-42));
+    values.emplace_back(true);
+    values.emplace_back(json::null());
+    values.emplace_back(json::string("q\"\\\n\x01\xc3\xa9"));
+    values.emplace_back(json::array());
+    values.emplace_back(json::object());
+    const std::string written = json::write(json::value(std::move(values)));
+    assert(written == R"([0.1,3.0,-0.0,1.0e+300,null,-42,true,null,)"
+                      R"("q\"\\\n\u0001)"
+                      "\xc3\xa9\",[],{}]");
+
+    json::array read_back = json::parse("read back", written);
+    assert(!((const json::number &)read_back[1]).is_int());
+    assert(read_back[3].strict_float() == 1e300);
+    assert(read_back[8] == "q\"\\\n\x01\xc3\xa9");
 }
 
 int main(int argc, char *argv[])
 {
     assert(argc == 3);
 
-    test_json_1(argv[1]);
-    test_json_2(argv[2]);
+    for (json::mode mode : {json::mode::scan, json::mode::step})
+    {
+        test_json_1(argv[1], mode);
+        test_json_2(argv[2], mode);
+    }
+
+    test_escapes();
+    test_memory();
+    test_tape(argv[1]);
+    test_lazy(argv[1]);
+    test_stream(argv[1]);
+    test_write(argv[1]);
 
     std::cout << "Success\n";
 }
\ No newline at end of file
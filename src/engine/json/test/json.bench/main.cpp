@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <chrono>
+#include <engine/json.hpp>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+// Parses a large document made of the JSON chunks of the given .glb files
+// repeated in one array, once per parser mode and into a tape, and reports
+// throughput. Also times reading a few fields of each header, from a tape
+// and with the lazy reader, streaming the document in pieces and writing it
+// back out.
+
+static std::string glb_json(const std::string &path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+
+    uint32_t length = 0;
+    if (contents.size() < 20 || contents.compare(0, 4, "glTF") != 0 ||
+        contents.compare(16, 4, "JSON") != 0)
+    {
+        std::cerr << path << " is not a GLB file\n";
+        std::exit(2);
+    }
+
+    memcpy(&length, &contents[12], sizeof(length));
+    return contents.substr(20, length);
+}
+
+static double run(const std::string &document, json::mode mode, size_t repeat)
+{
+    engine::memory::arena arena;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        json::parse("bench", document, &arena, mode);
+        arena.reset();
+    }
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return document.size() * repeat / elapsed.count() / (1024 * 1024);
+}
+
+static double run_tape(const std::string &document, size_t repeat)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < repeat; i++)
+        json::tape("bench", document.data(), document.data() + document.size());
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return document.size() * repeat / elapsed.count() / (1024 * 1024);
+}
+
+// Tokenizing alone, without building a tree
+static double run_scanner(const std::string &document, size_t repeat)
+{
+    const auto start = std::chrono::steady_clock::now();
+    size_t tokens = 0;
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        json::scanner scanner("bench",
+                              document.data(),
+                              document.data() + document.size());
+
+        while (scanner.next() != json::scanner::token::end)
+            tokens++;
+    }
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (tokens == 0)
+        std::exit(3);
+
+    return document.size() * repeat / elapsed.count() / (1024 * 1024);
+}
+
+// Reads only the accessor counts of each glTF header, the way the loader
+// pulls single fields, through a tape and straight from the text
+static size_t header_sum(const json::cursor &root)
+{
+    size_t sum = 0;
+
+    for (const json::cursor &chunk : root)
+        for (const json::cursor &accessor : chunk.at("accessors"))
+            sum += accessor.at("count").strict_int();
+
+    return sum;
+}
+
+static size_t header_sum(const json::lazy &root)
+{
+    size_t sum = 0;
+
+    for (const json::lazy &chunk : root)
+        for (const json::lazy &accessor : chunk.at("accessors"))
+            sum += accessor.at("count").strict_int();
+
+    return sum;
+}
+
+static double run_header_tape(const std::string &document, size_t repeat)
+{
+    const auto start = std::chrono::steady_clock::now();
+    size_t sum = 0;
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        const json::tape tape("bench",
+                              document.data(),
+                              document.data() + document.size());
+        sum += header_sum(tape.root());
+    }
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (sum == 0)
+        std::exit(3);
+
+    return document.size() * repeat / elapsed.count() / (1024 * 1024);
+}
+
+static double run_header_lazy(const std::string &document, size_t repeat)
+{
+    const auto start = std::chrono::steady_clock::now();
+    size_t sum = 0;
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        const json::lazy::document lazy("bench",
+                                        document.data(),
+                                        document.data() + document.size());
+        sum += header_sum(lazy.root());
+    }
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (sum == 0)
+        std::exit(3);
+
+    return document.size() * repeat / elapsed.count() / (1024 * 1024);
+}
+
+// Counts accessors, for reading the document as a stream of events
+class accessor_counter : public json::handler
+{
+  public:
+    size_t count = 0;
+
+    bool key(std::string_view key) override
+    {
+        count += key == "componentType";
+        return true;
+    }
+};
+
+// Feeds the document in pieces the size of a typical read() from disk
+static double run_stream(const std::string &document, size_t repeat)
+{
+    const size_t piece = 64 * 1024;
+    const auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        accessor_counter counter;
+        json::stream stream("bench", counter);
+
+        for (size_t at = 0; at < document.size(); at += piece)
+            stream.feed(document.data() + at,
+                        document.data() +
+                            std::min(at + piece, document.size()));
+        stream.finish();
+
+        count += counter.count;
+    }
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (count == 0)
+        std::exit(3);
+
+    return document.size() * repeat / elapsed.count() / (1024 * 1024);
+}
+
+// Writes a parsed document into a buffer reused from one run to the next,
+// and checks the text parses back into a document that writes the same
+static double run_write(const std::string &document,
+                        json::writer::style style,
+                        size_t repeat)
+{
+    const json::value parsed = json::parse("bench", document);
+    std::string out;
+    size_t written = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        out.clear();
+        json::writer(out, style).write(parsed);
+        written += out.size();
+    }
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const json::value read_back = json::parse("written", out);
+    std::string rewritten;
+    json::writer(rewritten, style).write(read_back);
+
+    // The members of objects come out in the order of the hash map, which
+    // matches for the same keys
+    if (rewritten.size() != out.size())
+    {
+        std::cerr << "Round trip changed the document\n";
+        std::exit(4);
+    }
+
+    return written / elapsed.count() / (1024 * 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <file.glb> ...\n";
+        return 1;
+    }
+
+    const size_t target_size = 16 * 1024 * 1024;
+    std::string document = "[";
+
+    while (document.size() < target_size)
+        for (int i = 1; i < argc; i++)
+        {
+            if (document.size() > 1)
+                document += ",\n";
+            document += glb_json(argv[i]);
+        }
+
+    document += "]";
+
+    std::cout << document.size() / 1024 << " KiB document\n";
+
+    const size_t repeat = 5;
+    const double step = run(document, json::mode::step, repeat);
+    const double scan = run(document, json::mode::scan, repeat);
+    const double tape = run_tape(document, repeat);
+    const double scanner = run_scanner(document, repeat);
+    const double header_tape = run_header_tape(document, repeat);
+    const double header_lazy = run_header_lazy(document, repeat);
+    const double stream = run_stream(document, repeat);
+    const double compact =
+        run_write(document, json::writer::style::compact, repeat);
+    const double pretty =
+        run_write(document, json::writer::style::pretty, repeat);
+
+    std::cout << "step: " << step << " MiB/s\n";
+    std::cout << "scan: " << scan << " MiB/s (" << scan / step << "x)\n";
+    std::cout << "tape: " << tape << " MiB/s (" << tape / step << "x)\n";
+    std::cout << "scanner alone: " << scanner << " MiB/s\n";
+    std::cout << "accessor counts, tape: " << header_tape << " MiB/s\n";
+    std::cout << "accessor counts, lazy: " << header_lazy << " MiB/s ("
+              << header_lazy / header_tape << "x)\n";
+    std::cout << "stream in 64 KiB pieces: " << stream << " MiB/s\n";
+    std::cout << "write compact: " << compact << " MiB/s written\n";
+    std::cout << "write pretty: " << pretty << " MiB/s written\n";
+
+    return 0;
+}
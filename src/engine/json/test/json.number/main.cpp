@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <chrono>
+#include <engine/json.hpp>
+#include <iostream>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Checks that numbers read back as the same doubles strtod gives, through
+// every way of reading JSON, then reports throughput on a number heavy
+// document shaped like glTF accessor bounds and matrices.
+
+static const char *const hard_cases[] = {
+    "0",
+    "-0.0",
+    "0.1",
+    "0.3",
+    "1e23",
+    "8.98846567431158e307",
+    "1.7976931348623157e308",
+    "2.2250738585072011e-308",
+    "2.2250738585072014e-308",
+    "4.9406564584124654e-324",
+    "1e-400",
+    "1e400",
+    "-1e400",
+    "9007199254740993",
+    "9007199254740993.0",
+    "9223372036854775807",
+    "9223372036854775808",
+    "123456789012345678901234567890",
+    "0.000000000000000000000000000001",
+    "3.14159265358979323846264338327950288",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "7.038531e-26",
+    "1448997445238699",
+    "1e22",
+    "1e-22",
+    "123e-20",
+    "5e-324",
+    "1E5",
+    "-12.5E+3",
+};
+
+static std::vector<std::string> numbers()
+{
+    std::vector<std::string> result(std::begin(hard_cases),
+                                    std::end(hard_cases));
+
+    std::mt19937_64 random(42);
+    char text[64];
+
+    for (size_t i = 0; i < 200000; i++)
+    {
+        uint64_t bits = random();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+
+        if (value != value || value - value != 0)
+            continue;
+
+        const char *formats[] = {"%.17g", "%.9g", "%g"};
+        snprintf(text, sizeof(text), formats[i % 3], value);
+        result.push_back(text);
+
+        // Most glTF numbers are floats of about unit size
+        const float unit = std::uniform_real_distribution<float>(-2, 2)(random);
+        snprintf(text, sizeof(text), "%.9g", unit);
+        result.push_back(text);
+    }
+
+    return result;
+}
+
+static std::string array_of(const std::vector<std::string> &numbers)
+{
+    std::string document = "[";
+
+    for (const std::string &number : numbers)
+    {
+        if (document.size() > 1)
+            document += ",";
+        document += number;
+    }
+
+    return document + "]";
+}
+
+static bool same(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void check(const std::string &text, double read, const char *how)
+{
+    const double expected = strtod(text.c_str(), nullptr);
+
+    if (!same(read, expected))
+    {
+        fprintf(stderr,
+                "%s read %s as %.17g, expected %.17g\n",
+                how,
+                text.c_str(),
+                read,
+                expected);
+        exit(1);
+    }
+}
+
+static json::number read_number(const std::string &text)
+{
+    return (const json::number &)json::parse("number", text);
+}
+
+static void test_correct(const std::vector<std::string> &numbers)
+{
+    const std::string document = array_of(numbers);
+
+    for (json::mode mode : {json::mode::scan, json::mode::step})
+    {
+        const json::value value = json::parse(
+            "numbers", document, std::pmr::get_default_resource(), mode);
+        const json::array &array = value;
+
+        assert(array.size() == numbers.size());
+        for (size_t i = 0; i < numbers.size(); i++)
+            check(numbers[i],
+                  array[i].as_float(),
+                  mode == json::mode::scan ? "scan" : "step");
+    }
+
+    const json::tape tape("numbers",
+                          document.data(),
+                          document.data() + document.size());
+    size_t i = 0;
+    for (const json::cursor &number : tape.root())
+        check(numbers[i++], number.as_float(), "tape");
+
+    const json::lazy::document lazy("numbers",
+                                    document.data(),
+                                    document.data() + document.size());
+    i = 0;
+    for (const json::lazy &number : lazy.root())
+        check(numbers[i++], number.as_float(), "lazy");
+
+    assert(tape.root()[0].type() == json::tape::type::integer);
+    assert(tape.root()[1].type() == json::tape::type::real);
+    assert(read_number("9223372036854775807").is_int());
+    assert(!read_number("9223372036854775808").is_int());
+    assert(read_number("12e3").strict_int() == 12000);
+    assert(read_number("-7").strict_int() == -7);
+    assert(read_number("-0").strict_int() == 0);
+    assert(!read_number("1.0").is_int());
+    assert(!read_number("1e-1").is_int());
+}
+
+static double mib_per_second(size_t bytes,
+                             std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return bytes / elapsed.count() / (1024 * 1024);
+}
+
+static void bench()
+{
+    std::vector<std::string> floats;
+    std::mt19937_64 random(7);
+    std::uniform_real_distribution<float> distribution(-100, 100);
+    char text[64];
+
+    for (size_t i = 0; i < 2000000; i++)
+    {
+        snprintf(text, sizeof(text), "%.9g", distribution(random));
+        floats.push_back(text);
+    }
+
+    const std::string document = array_of(floats);
+    const size_t repeat = 3;
+
+    std::cout << floats.size() << " floats, " << document.size() / 1024
+              << " KiB\n";
+
+    auto start = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (size_t n = 0; n < repeat; n++)
+        for (const std::string &number : floats)
+            sum += strtod(number.c_str(), nullptr);
+    std::cout << "strtod: " << mib_per_second(document.size() * repeat, start)
+              << " MiB/s\n";
+
+    start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < repeat; n++)
+    {
+        json::scanner scanner("bench",
+                              document.data(),
+                              document.data() + document.size());
+        json::scanner::token token;
+        while ((token = scanner.next()) != json::scanner::token::end)
+            sum += token == json::scanner::token::number;
+    }
+    std::cout << "scanner alone: "
+              << mib_per_second(document.size() * repeat, start) << " MiB/s\n";
+
+    start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < repeat; n++)
+    {
+        const json::tape tape("bench",
+                              document.data(),
+                              document.data() + document.size());
+        sum += tape.root()[0].as_float();
+    }
+    std::cout << "tape: " << mib_per_second(document.size() * repeat, start)
+              << " MiB/s\n";
+
+    engine::memory::arena arena;
+    for (json::mode mode : {json::mode::scan, json::mode::step})
+    {
+        start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < repeat; n++)
+        {
+            json::parse("bench", document, &arena, mode);
+            arena.reset();
+        }
+        std::cout << (mode == json::mode::scan ? "scan: " : "step: ")
+                  << mib_per_second(document.size() * repeat, start)
+                  << " MiB/s\n";
+    }
+
+    if (sum == 0)
+        exit(3);
+}
+
+int main()
+{
+    const std::vector<std::string> all = numbers();
+
+    test_correct(all);
+    std::cout << all.size() << " numbers read correctly\n";
+
+    bench();
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <engine/exception.hpp>
+#include <engine/vec.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Passes over indexed meshes that weld, reorder and simplify triangles and
+// vertices so the gpu stores, transforms, fetches and shades less to draw the
+// same mesh, or a simpler one where the difference would not show
+
+namespace engine::mesh::exception
+{
+class base : public engine::exception
+{
+  public:
+    base(const std::string &message) : engine::exception(message) {}
+};
+} // namespace engine::mesh::exception
+
+namespace engine::mesh
+{
+// Entries of the first-in first-out post-transform cache that analyze
+// simulates and optimize_overdraw keeps intact
+constexpr size_t cache_size = 16;
+
+class statistics
+{
+  public:
+    size_t triangles = 0;
+    // Vertices used by at least one triangle
+    size_t vertices = 0;
+    // Vertices transformed, one for each miss of the cache
+    size_t transforms = 0;
+
+    // Transforms per triangle, 3 at worst and around 0.5 at best
+    double acmr() const;
+    // Transforms per vertex, 1 at best
+    double atvr() const;
+};
+
+statistics analyze(const std::vector<uint32_t> &indices,
+                   size_t vertex_count,
+                   size_t cache = cache_size);
+
+// Reorders triangles so that those sharing vertices are drawn close together,
+// with Tipsify from Sander, Nehab and Barczak's "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"
+void optimize_cache(std::vector<uint32_t> &indices, size_t vertex_count);
+
+// Splits triangles where the cache starts over and draws the clusters that
+// face away from the centre of the mesh first, so they hide what is behind
+// them. Run after optimize_cache.
+void optimize_overdraw(std::vector<uint32_t> &indices,
+                       const std::vector<vec::fvec3> &positions);
+
+// Renumbers vertices in the order triangles first use them and returns the
+// old index of each new vertex, unused vertices last
+std::vector<uint32_t> optimize_fetch(std::vector<uint32_t> &indices,
+                                     size_t vertex_count);
+
+// Indices of a simpler version of a mesh, using the same vertices, and how
+// far it strays from the original in the units of its positions
+struct simplification
+{
+    std::vector<uint32_t> indices;
+    float error = 0;
+};
+
+// Collapses edges onto one of their own vertices, cheapest first by Garland
+// and Heckbert's quadric error, until at most target_count indices remain or
+// the next collapse would stray further than max_error. Vertices that share
+// a position with others, as along seams, stay put, and those on open borders
+// only move along them.
+simplification simplify(const std::vector<uint32_t> &indices,
+                        const std::vector<vec::fvec3> &positions,
+                        size_t target_count,
+                        float max_error);
+
+// Bytes of each vertex within an array of them
+struct stream
+{
+    const uint8_t *data;
+    size_t size;
+    size_t stride;
+};
+
+// Keeps one of each set of vertices whose bytes match in every stream,
+// pointing indices at the kept ones renumbered in order, and returns the old
+// index of each vertex kept
+std::vector<uint32_t> weld(std::vector<uint32_t> &indices,
+                           const std::vector<stream> &streams,
+                           size_t vertex_count);
+
+// Copies packed elements of size bytes each from in to out, element i of out
+// being element order[i] of in
+void gather(uint8_t *out,
+            const uint8_t *in,
+            size_t size,
+            const std::vector<uint32_t> &order);
+} // namespace engine::mesh
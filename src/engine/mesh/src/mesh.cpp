@@ -0,0 +1,753 @@
+#include <algorithm>
+#include <cmath>
+#include <engine/mesh.hpp>
+#include <limits>
+#include <string.h>
+
+namespace
+{
+const uint32_t none = std::numeric_limits<uint32_t>::max();
+const size_t never = std::numeric_limits<size_t>::max();
+
+void check_range(const std::vector<uint32_t> &indices, size_t vertex_count)
+{
+    for (uint32_t index : indices)
+        if (index >= vertex_count)
+            throw engine::mesh::exception::base(
+                "Index " + std::to_string(index) + " is out of range of " +
+                std::to_string(vertex_count) + " vertices");
+}
+
+void check(const std::vector<uint32_t> &indices, size_t vertex_count)
+{
+    if (indices.size() % 3 != 0)
+        throw engine::mesh::exception::base(
+            "Index count " + std::to_string(indices.size()) +
+            " is not a multiple of 3");
+
+    check_range(indices, vertex_count);
+}
+
+// One step of hashing vertex bytes, four at a time where there are four
+uint64_t mix(uint64_t hash, uint32_t word)
+{
+    return ((hash << 5 | hash >> 59) ^ word) * 0x9e3779b97f4a7c15;
+}
+
+// Lays out count values by key, those of key k from first[k] up to
+// first[k + 1], first having one more element than there are keys
+template <typename K, typename V>
+void group(size_t count,
+           K key,
+           V value,
+           std::vector<uint32_t> &first,
+           std::vector<uint32_t> &values)
+{
+    std::fill(first.begin(), first.end(), 0);
+    for (size_t i = 0; i < count; i++)
+        first[key(i) + 1]++;
+    for (size_t k = 1; k < first.size(); k++)
+        first[k] += first[k - 1];
+
+    // Each key's start moves to the next key's as its values are placed,
+    // then everything shifts back one
+    for (size_t i = 0; i < count; i++)
+        values[first[key(i)]++] = value(i);
+    for (size_t k = first.size() - 1; k > 0; k--)
+        first[k] = first[k - 1];
+    first[0] = 0;
+}
+
+// Sum of squared distances to a set of weighted planes, divided by the total
+// weight so that it reads as an average
+struct quadric
+{
+    double xx = 0, yy = 0, zz = 0, xy = 0, xz = 0, yz = 0;
+    double x = 0, y = 0, z = 0, c = 0, weight = 0;
+
+    // The plane where dot(normal, p) + d is 0, normal being unit length
+    void add(const vec::fvec3 &normal, double d, double w)
+    {
+        xx += w * normal.x * normal.x;
+        yy += w * normal.y * normal.y;
+        zz += w * normal.z * normal.z;
+        xy += w * normal.x * normal.y;
+        xz += w * normal.x * normal.z;
+        yz += w * normal.y * normal.z;
+        x += w * normal.x * d;
+        y += w * normal.y * d;
+        z += w * normal.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void operator+=(const quadric &other)
+    {
+        xx += other.xx;
+        yy += other.yy;
+        zz += other.zz;
+        xy += other.xy;
+        xz += other.xz;
+        yz += other.yz;
+        x += other.x;
+        y += other.y;
+        z += other.z;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    double error(const vec::fvec3 &p) const
+    {
+        if (weight <= 0)
+            return 0;
+
+        const double sum = xx * p.x * p.x + yy * p.y * p.y + zz * p.z * p.z +
+                           2 * (xy * p.x * p.y + xz * p.x * p.z +
+                                yz * p.y * p.z + x * p.x + y * p.y +
+                                z * p.z) +
+                           c;
+        return std::max(sum / weight, 0.0);
+    }
+};
+
+// Transforms the vertices of a triangle through a first-in first-out cache,
+// returning how many missed
+class fifo
+{
+    // Transform count when each vertex last entered the cache
+    std::vector<size_t> entered;
+    size_t size;
+
+  public:
+    size_t transforms = 0;
+
+    fifo(size_t vertex_count, size_t _size)
+        : entered(vertex_count, never), size(_size)
+    {
+    }
+
+    bool seen(uint32_t index) const { return entered[index] != never; }
+
+    size_t draw(const uint32_t *triangle)
+    {
+        size_t misses = 0;
+        for (size_t k = 0; k < 3; k++)
+        {
+            size_t &time = entered[triangle[k]];
+            if (time == never || transforms - time >= size)
+            {
+                time = transforms++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+} // namespace
+
+double engine::mesh::statistics::acmr() const
+{
+    return triangles ? (double)transforms / triangles : 0.0;
+}
+
+double engine::mesh::statistics::atvr() const
+{
+    return vertices ? (double)transforms / vertices : 0.0;
+}
+
+engine::mesh::statistics engine::mesh::analyze(
+    const std::vector<uint32_t> &indices, size_t vertex_count, size_t cache)
+{
+    check(indices, vertex_count);
+
+    statistics result;
+    result.triangles = indices.size() / 3;
+
+    fifo fifo(vertex_count, cache);
+    for (size_t t = 0; t < result.triangles; t++)
+    {
+        const uint32_t *triangle = indices.data() + t * 3;
+        for (size_t k = 0; k < 3; k++)
+            result.vertices += !fifo.seen(triangle[k]) &&
+                               std::find(triangle, triangle + k, triangle[k]) ==
+                                   triangle + k;
+        fifo.draw(triangle);
+    }
+
+    result.transforms = fifo.transforms;
+    return result;
+}
+
+void engine::mesh::optimize_cache(std::vector<uint32_t> &indices,
+                                  size_t vertex_count)
+{
+    check(indices, vertex_count);
+
+    const size_t triangle_count = indices.size() / 3;
+
+    // Triangles of each vertex, and how many of them are left to draw
+    std::vector<uint32_t> first(vertex_count + 1, 0);
+    for (uint32_t index : indices)
+        first[index + 1]++;
+    for (size_t v = 0; v < vertex_count; v++)
+        first[v + 1] += first[v];
+
+    std::vector<uint32_t> live(vertex_count, 0);
+    std::vector<uint32_t> adjacent(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        const uint32_t v = indices[i];
+        adjacent[first[v] + live[v]++] = i / 3;
+    }
+
+    // Time each vertex last entered the simulated cache, starting far enough
+    // ahead that none are in it
+    std::vector<size_t> entered(vertex_count, 0);
+    size_t time = cache_size + 1;
+
+    std::vector<uint8_t> drawn(triangle_count, 0);
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t fan = vertex_count ? 0 : none;
+    size_t cursor = 0;
+
+    while (fan != none)
+    {
+        // Draw every triangle left around the fanning vertex
+        candidates.clear();
+        for (size_t j = first[fan]; j < first[fan + 1]; j++)
+        {
+            const uint32_t t = adjacent[j];
+            if (drawn[t])
+                continue;
+            drawn[t] = 1;
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                const uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - entered[v] > cache_size)
+                    entered[v] = time++;
+            }
+        }
+
+        // Fan next around the oldest vertex that will still be in the cache
+        // once its triangles are drawn
+        fan = none;
+        size_t best = 0;
+        for (uint32_t v : candidates)
+        {
+            if (!live[v])
+                continue;
+
+            const size_t age = time - entered[v];
+            const size_t priority = age + 2 * live[v] <= cache_size ? age : 0;
+            if (fan == none || priority > best)
+            {
+                fan = v;
+                best = priority;
+            }
+        }
+
+        // Otherwise the most recently drawn vertex with triangles left, then
+        // the first such vertex
+        while (fan == none && !dead_ends.empty())
+        {
+            if (live[dead_ends.back()])
+                fan = dead_ends.back();
+            dead_ends.pop_back();
+        }
+
+        while (fan == none && cursor < vertex_count)
+        {
+            if (live[cursor])
+                fan = cursor;
+            cursor++;
+        }
+    }
+
+    indices.swap(output);
+}
+
+void engine::mesh::optimize_overdraw(std::vector<uint32_t> &indices,
+                                     const std::vector<vec::fvec3> &positions)
+{
+    check(indices, positions.size());
+
+    struct cluster
+    {
+        size_t first;
+        size_t count = 0;
+        vec::fvec3 normal = vec::fvec3(0, 0, 0);
+        vec::fvec3 centroid = vec::fvec3(0, 0, 0);
+        float area = 0.0f;
+        float facing = 0.0f;
+    };
+
+    const size_t triangle_count = indices.size() / 3;
+    std::vector<cluster> clusters;
+    fifo fifo(positions.size(), cache_size);
+
+    vec::fvec3 centre(0, 0, 0);
+    float area = 0.0f;
+
+    // Clusters start where every vertex misses, so moving them about costs
+    // the cache nothing
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        const uint32_t *triangle = indices.data() + t * 3;
+        if (fifo.draw(triangle) == 3 || clusters.empty())
+            clusters.push_back({t});
+
+        const vec::fvec3 &a = positions[triangle[0]];
+        const vec::fvec3 &b = positions[triangle[1]];
+        const vec::fvec3 &c = positions[triangle[2]];
+        const vec::fvec3 normal = vec::cross(b - a, c - a);
+        const float weight = vec::length(normal);
+        const vec::fvec3 middle = (a + b + c) * (1.0f / 3.0f);
+
+        cluster &cluster = clusters.back();
+        cluster.count++;
+        cluster.normal = cluster.normal + normal;
+        cluster.centroid = cluster.centroid + middle * weight;
+        cluster.area += weight;
+        centre = centre + middle * weight;
+        area += weight;
+    }
+
+    if (clusters.size() < 2 || area <= 0.0f)
+        return;
+
+    centre = centre * (1.0f / area);
+
+    for (cluster &cluster : clusters)
+    {
+        const float length = vec::length(cluster.normal);
+        if (cluster.area > 0.0f && length > 0.0f)
+            cluster.facing =
+                vec::dot(cluster.centroid * (1.0f / cluster.area) - centre,
+                         cluster.normal * (1.0f / length));
+    }
+
+    std::stable_sort(clusters.begin(),
+                     clusters.end(),
+                     [](const cluster &a, const cluster &b)
+                     { return a.facing > b.facing; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const cluster &cluster : clusters)
+        output.insert(output.end(),
+                      indices.begin() + cluster.first * 3,
+                      indices.begin() + (cluster.first + cluster.count) * 3);
+
+    indices.swap(output);
+}
+
+std::vector<uint32_t> engine::mesh::optimize_fetch(
+    std::vector<uint32_t> &indices, size_t vertex_count)
+{
+    check(indices, vertex_count);
+
+    std::vector<uint32_t> renumbered(vertex_count, none);
+    std::vector<uint32_t> order;
+    order.reserve(vertex_count);
+
+    for (uint32_t &index : indices)
+    {
+        if (renumbered[index] == none)
+        {
+            renumbered[index] = order.size();
+            order.push_back(index);
+        }
+        index = renumbered[index];
+    }
+
+    for (size_t v = 0; v < vertex_count; v++)
+        if (renumbered[v] == none)
+            order.push_back(v);
+
+    return order;
+}
+
+std::vector<uint32_t> engine::mesh::weld(std::vector<uint32_t> &indices,
+                                         const std::vector<stream> &streams,
+                                         size_t vertex_count)
+{
+    check_range(indices, vertex_count);
+
+    // Folds the high bits down so that buckets, which use the low bits,
+    // depend on all of them
+    const auto hash = [&](size_t v)
+    {
+        uint64_t hash = 0;
+        for (const stream &stream : streams)
+        {
+            const uint8_t *bytes = stream.data + v * stream.stride;
+            size_t i = 0;
+            for (; i + sizeof(uint32_t) <= stream.size; i += sizeof(uint32_t))
+            {
+                uint32_t word;
+                memcpy(&word, bytes + i, sizeof(word));
+                hash = mix(hash, word);
+            }
+            for (; i < stream.size; i++)
+                hash = mix(hash, bytes[i]);
+        }
+        return hash ^ hash >> 32;
+    };
+
+    const auto equal = [&](size_t a, size_t b)
+    {
+        for (const stream &stream : streams)
+            if (memcmp(stream.data + a * stream.stride,
+                       stream.data + b * stream.stride,
+                       stream.size) != 0)
+                return false;
+        return true;
+    };
+
+    // Open addressing, at most half full, holding the first vertex of each
+    // distinct record
+    size_t buckets = 1;
+    while (buckets < vertex_count * 2)
+        buckets *= 2;
+    std::vector<uint32_t> table(buckets, none);
+
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint32_t> kept;
+
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        size_t bucket = hash(v) & (buckets - 1);
+        while (table[bucket] != none && !equal(table[bucket], v))
+            bucket = (bucket + 1) & (buckets - 1);
+
+        if (table[bucket] == none)
+        {
+            table[bucket] = v;
+            remap[v] = kept.size();
+            kept.push_back(v);
+        }
+        else
+            remap[v] = remap[table[bucket]];
+    }
+
+    for (uint32_t &index : indices)
+        index = remap[index];
+
+    return kept;
+}
+
+engine::mesh::simplification engine::mesh::simplify(
+    const std::vector<uint32_t> &indices,
+    const std::vector<vec::fvec3> &positions,
+    size_t target_count,
+    float max_error)
+{
+    check(indices, positions.size());
+
+    // Open border edges weigh this much more than faces of the same size, so
+    // that borders keep their shape
+    const double border_weight = 10;
+
+    const size_t vertex_count = positions.size();
+    simplification result;
+    result.indices = indices;
+    std::vector<uint32_t> &current = result.indices;
+
+    // Vertices at the same position are one point of the surface
+    std::vector<uint32_t> point(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++)
+        point[v] = v;
+    const size_t point_count =
+        weld(point,
+             {{(const uint8_t *)positions.data(),
+               sizeof(vec::fvec3),
+               sizeof(vec::fvec3)}},
+             vertex_count)
+            .size();
+
+    std::vector<uint32_t> wedges(point_count, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+        wedges[point[v]]++;
+
+    // Edges leaving each point
+    std::vector<uint32_t> first(point_count + 1, 0);
+    std::vector<uint32_t> targets(current.size());
+    group(
+        current.size(),
+        [&](size_t i) { return point[current[i]]; },
+        [&](size_t i) { return point[current[i - i % 3 + (i + 1) % 3]]; },
+        first,
+        targets);
+
+    const auto has_edge = [&](uint32_t from, uint32_t to)
+    {
+        return std::find(targets.begin() + first[from],
+                         targets.begin() + first[from + 1],
+                         to) != targets.begin() + first[from + 1];
+    };
+
+    // Points inside the surface move anywhere, those with one open edge in
+    // and one out only along those, and the rest not at all
+    enum class kind : uint8_t
+    {
+        manifold,
+        border,
+        locked,
+    };
+    std::vector<kind> kinds(point_count, kind::manifold);
+    // The open edge out of and into each point, or locked_edge if several
+    const uint32_t locked_edge = none - 1;
+    std::vector<uint32_t> open_next(point_count, none);
+    std::vector<uint32_t> open_previous(point_count, none);
+    std::vector<quadric> quadrics(point_count);
+
+    for (size_t t = 0; t < current.size() / 3; t++)
+    {
+        const uint32_t *triangle = current.data() + t * 3;
+        const vec::fvec3 &a = positions[triangle[0]];
+        const vec::fvec3 normal =
+            vec::cross(positions[triangle[1]] - a, positions[triangle[2]] - a);
+        const float area = vec::length(normal);
+        if (area <= 0)
+            continue;
+        const vec::fvec3 unit = normal * (1.0f / area);
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            const uint32_t from = point[triangle[k]];
+            const uint32_t to = point[triangle[(k + 1) % 3]];
+            quadrics[from].add(unit, -vec::dot(unit, a), area / 2);
+
+            if (from == to || has_edge(to, from))
+                continue;
+
+            const vec::fvec3 &start = positions[triangle[k]];
+            const vec::fvec3 edge = positions[triangle[(k + 1) % 3]] - start;
+            const vec::fvec3 side = vec::cross(edge, unit);
+            const float length = vec::length(side);
+            if (length > 0)
+            {
+                const vec::fvec3 across = side * (1.0f / length);
+                const double weight =
+                    vec::dot(edge, edge) * border_weight;
+                quadrics[from].add(across, -vec::dot(across, start), weight);
+                quadrics[to].add(across, -vec::dot(across, start), weight);
+            }
+
+            open_next[from] = open_next[from] == none ? to : locked_edge;
+            open_previous[to] =
+                open_previous[to] == none ? from : locked_edge;
+        }
+    }
+
+    for (size_t p = 0; p < point_count; p++)
+    {
+        const bool open = open_next[p] != none || open_previous[p] != none;
+        if (wedges[p] > 1 || open_next[p] == locked_edge ||
+            open_previous[p] == locked_edge ||
+            (open && (open_next[p] == none || open_previous[p] == none)))
+            kinds[p] = kind::locked;
+        else if (open)
+            kinds[p] = kind::border;
+    }
+
+    const auto allowed = [&](uint32_t from, uint32_t to)
+    {
+        const uint32_t a = point[from];
+        const uint32_t b = point[to];
+        return a != b &&
+               (kinds[a] == kind::manifold ||
+                (kinds[a] == kind::border &&
+                 (open_next[a] == b || open_previous[a] == b)));
+    };
+
+    struct collapse
+    {
+        float cost;
+        uint32_t from;
+        uint32_t to;
+    };
+    std::vector<collapse> collapses;
+    // Collapses in order of cost, by the top bits of costs as floats, whose
+    // bits order as their values do while they are not negative
+    const size_t cost_keys = 1 << 16;
+    std::vector<uint32_t> cost_first(cost_keys + 1);
+    std::vector<uint32_t> order;
+    const auto cost_key = [&](size_t i)
+    {
+        uint32_t bits;
+        memcpy(&bits, &collapses[i].cost, sizeof(bits));
+        return bits >> 16;
+    };
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint8_t> touched(vertex_count);
+    std::vector<uint32_t> around_first(vertex_count + 1);
+    std::vector<uint32_t> around;
+
+    const size_t target = target_count / 3 * 3;
+    const float limit = max_error * max_error;
+    float worst = 0;
+
+    while (current.size() > target)
+    {
+        // Triangles around each vertex
+        around.resize(current.size());
+        group(
+            current.size(),
+            [&](size_t i) { return current[i]; },
+            [](size_t i) { return (uint32_t)(i / 3); },
+            around_first,
+            around);
+
+        // Each edge once, from the triangle where it runs up in index unless
+        // it is open and has no other, collapsing whichever way costs less
+        collapses.clear();
+        for (size_t i = 0; i < current.size(); i++)
+        {
+            const uint32_t a = current[i];
+            const uint32_t b = current[i - i % 3 + (i + 1) % 3];
+            if (a > b && open_next[point[a]] != point[b])
+                continue;
+
+            const bool forward = allowed(a, b);
+            const bool backward = allowed(b, a);
+            if (!forward && !backward)
+                continue;
+
+            quadric sum = quadrics[point[a]];
+            sum += quadrics[point[b]];
+            const float to_b = forward ? sum.error(positions[b]) : INFINITY;
+            const float to_a = backward ? sum.error(positions[a]) : INFINITY;
+            if (to_b <= to_a)
+                collapses.push_back({to_b, a, b});
+            else
+                collapses.push_back({to_a, b, a});
+        }
+        order.resize(collapses.size());
+        group(
+            collapses.size(),
+            cost_key,
+            [](size_t i) { return (uint32_t)i; },
+            cost_first,
+            order);
+
+        // Collapsing a vertex inside the surface removes two triangles
+        const size_t goal = (current.size() - target) / 3;
+        size_t removed = 0;
+        size_t collapsed = 0;
+
+        for (size_t v = 0; v < vertex_count; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        for (uint32_t c : order)
+        {
+            const collapse &collapse = collapses[c];
+            if (collapse.cost > limit || removed >= goal)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Triangles that would turn over, or nearly, rule it out
+            bool flips = false;
+            size_t lost = 0;
+            for (size_t j = around_first[collapse.from];
+                 j < around_first[collapse.from + 1] && !flips;
+                 j++)
+            {
+                const uint32_t *triangle = current.data() + around[j] * 3;
+                if (std::find(triangle, triangle + 3, collapse.to) !=
+                    triangle + 3)
+                {
+                    lost++;
+                    continue;
+                }
+
+                vec::fvec3 corners[3];
+                vec::fvec3 moved[3];
+                for (size_t k = 0; k < 3; k++)
+                {
+                    corners[k] = positions[triangle[k]];
+                    moved[k] = positions[triangle[k] == collapse.from
+                                             ? collapse.to
+                                             : triangle[k]];
+                }
+                const vec::fvec3 before = vec::cross(corners[1] - corners[0],
+                                                     corners[2] - corners[0]);
+                const vec::fvec3 after =
+                    vec::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = vec::dot(before, after) <
+                        0.25f * vec::length(before) * vec::length(after);
+            }
+            if (flips)
+                continue;
+
+            for (size_t j = around_first[collapse.from];
+                 j < around_first[collapse.from + 1];
+                 j++)
+                for (size_t k = 0; k < 3; k++)
+                    touched[current[around[j] * 3 + k]] = 1;
+
+            const uint32_t from = point[collapse.from];
+            const uint32_t to = point[collapse.to];
+            if (kinds[from] == kind::border)
+            {
+                // The border now runs straight past the collapsed point
+                if (open_next[from] == to)
+                {
+                    open_next[open_previous[from]] = to;
+                    open_previous[to] = open_previous[from];
+                }
+                else
+                {
+                    open_previous[open_next[from]] = to;
+                    open_next[to] = open_next[from];
+                }
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[to] += quadrics[from];
+            worst = std::max(worst, collapse.cost);
+            removed += lost;
+            collapsed++;
+        }
+
+        if (!collapsed)
+            break;
+
+        size_t kept = 0;
+        for (size_t t = 0; t < current.size() / 3; t++)
+        {
+            const uint32_t a = remap[current[t * 3]];
+            const uint32_t b = remap[current[t * 3 + 1]];
+            const uint32_t c = remap[current[t * 3 + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            current[kept++] = a;
+            current[kept++] = b;
+            current[kept++] = c;
+        }
+        current.resize(kept);
+    }
+
+    result.error = std::sqrt(worst);
+    return result;
+}
+
+void engine::mesh::gather(uint8_t *out,
+                          const uint8_t *in,
+                          size_t size,
+                          const std::vector<uint32_t> &order)
+{
+    for (size_t i = 0; i < order.size(); i++)
+        memcpy(out + i * size, in + (size_t)order[i] * size, size);
+}
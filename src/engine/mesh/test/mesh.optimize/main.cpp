@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <chrono>
+#include <engine/mesh.hpp>
+#include <iostream>
+#include <random>
+#include <string.h>
+#include <vector>
+
+// Shuffles the triangles of a grid, then checks that each pass keeps the same
+// triangles while improving what it is for, and times optimize_cache.
+
+static const uint32_t side = 256;
+static const size_t vertex_count = side * side;
+
+static std::vector<uint32_t> grid()
+{
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y + 1 < side; y++)
+    {
+        for (uint32_t x = 0; x + 1 < side; x++)
+        {
+            const uint32_t corner = x + y * side;
+            const uint32_t square[6] = {corner,
+                                        corner + 1,
+                                        corner + side,
+                                        corner + 1,
+                                        corner + side + 1,
+                                        corner + side};
+            indices.insert(indices.end(), square, square + 6);
+        }
+    }
+    return indices;
+}
+
+static void shuffle(std::vector<uint32_t> &indices)
+{
+    std::mt19937 random(1);
+    std::vector<size_t> order(indices.size() / 3);
+    for (size_t t = 0; t < order.size(); t++)
+        order[t] = t;
+    std::shuffle(order.begin(), order.end(), random);
+
+    std::vector<uint32_t> shuffled;
+    for (size_t t : order)
+    {
+        // Rotating a triangle keeps its winding
+        const size_t turn = random() % 3;
+        for (size_t k = 0; k < 3; k++)
+            shuffled.push_back(indices[t * 3 + (k + turn) % 3]);
+    }
+    indices.swap(shuffled);
+}
+
+// Triangles starting from their smallest index, sorted
+static std::vector<uint32_t> canonical(const std::vector<uint32_t> &indices)
+{
+    std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); t++)
+    {
+        const uint32_t *triangle = indices.data() + t * 3;
+        const size_t turn = std::min_element(triangle, triangle + 3) - triangle;
+        for (size_t k = 0; k < 3; k++)
+            triangles[t][k] = triangle[(k + turn) % 3];
+    }
+    std::sort(triangles.begin(), triangles.end());
+
+    std::vector<uint32_t> result;
+    for (const std::array<uint32_t, 3> &triangle : triangles)
+        result.insert(result.end(), triangle.begin(), triangle.end());
+    return result;
+}
+
+static std::vector<vec::fvec3> positions()
+{
+    std::vector<vec::fvec3> result(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++)
+        result[v] = vec::fvec3(v % side, v / side, 0);
+    return result;
+}
+
+static bool throws(const std::vector<uint32_t> &indices)
+{
+    try
+    {
+        std::vector<uint32_t> copy = indices;
+        engine::mesh::optimize_cache(copy, 3);
+    }
+    catch (const engine::mesh::exception::base &)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    std::vector<uint32_t> indices = grid();
+    const std::vector<uint32_t> triangles = canonical(indices);
+    const size_t triangle_count = indices.size() / 3;
+
+    shuffle(indices);
+    assert(canonical(indices) == triangles);
+
+    const engine::mesh::statistics shuffled =
+        engine::mesh::analyze(indices, vertex_count);
+    assert(shuffled.triangles == triangle_count);
+    assert(shuffled.vertices == vertex_count);
+    assert(shuffled.acmr() > 2.5);
+
+    const auto start = std::chrono::steady_clock::now();
+    engine::mesh::optimize_cache(indices, vertex_count);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const engine::mesh::statistics cached =
+        engine::mesh::analyze(indices, vertex_count);
+    assert(canonical(indices) == triangles);
+    assert(cached.acmr() < 0.7);
+    assert(cached.atvr() < 1.4);
+
+    std::cout << "acmr " << shuffled.acmr() << " -> " << cached.acmr()
+              << ", atvr " << shuffled.atvr() << " -> " << cached.atvr()
+              << "\noptimize_cache: " << triangle_count / elapsed.count() / 1e6
+              << " M triangles/s\n";
+
+    // Clusters move whole, so the cache hardly notices
+    const std::vector<vec::fvec3> grid_positions = positions();
+    engine::mesh::optimize_overdraw(indices, grid_positions);
+    const engine::mesh::statistics sorted =
+        engine::mesh::analyze(indices, vertex_count);
+    assert(canonical(indices) == triangles);
+    assert(sorted.acmr() < cached.acmr() * 1.05);
+
+    // Vertices come in the order triangles first use them
+    const std::vector<uint32_t> before = indices;
+    const std::vector<uint32_t> order =
+        engine::mesh::optimize_fetch(indices, vertex_count);
+    assert(order.size() == vertex_count);
+
+    std::vector<uint8_t> seen(vertex_count, 0);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        assert(order[indices[i]] == before[i]);
+        assert(indices[i] <= next);
+        next = std::max(next, indices[i] + 1);
+    }
+    for (uint32_t v : order)
+        seen[v]++;
+    assert(std::count(seen.begin(), seen.end(), 1) == (long)vertex_count);
+    assert(engine::mesh::analyze(indices, vertex_count).transforms ==
+           sorted.transforms);
+
+    // Moving vertex data to match keeps each triangle's corners
+    std::vector<vec::fvec3> moved(vertex_count);
+    engine::mesh::gather((uint8_t *)moved.data(),
+                         (const uint8_t *)grid_positions.data(),
+                         sizeof(vec::fvec3),
+                         order);
+    for (size_t i = 0; i < indices.size(); i += 97)
+    {
+        const vec::fvec3 &a = moved[indices[i]];
+        const vec::fvec3 &b = grid_positions[before[i]];
+        assert(a.x == b.x && a.y == b.y && a.z == b.z);
+    }
+
+    // Unused vertices follow the used ones
+    std::vector<uint32_t> sparse = {4, 2, 0};
+    const std::vector<uint32_t> sparse_order =
+        engine::mesh::optimize_fetch(sparse, 5);
+    assert((sparse == std::vector<uint32_t>{0, 1, 2}));
+    assert((sparse_order == std::vector<uint32_t>{4, 2, 0, 1, 3}));
+
+    assert(throws({0, 1, 3}));
+    assert(throws({0, 1}));
+
+    std::cout << "Success\n";
+    return 0;
+}
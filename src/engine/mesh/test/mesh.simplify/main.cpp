@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <engine/mesh.hpp>
+#include <iostream>
+#include <vector>
+
+// Simplifies a closed sphere, a flat grid with open borders and a grid split
+// along a seam, checking that each keeps its shape and what must not move
+// stays, and times the sphere.
+
+struct mesh
+{
+    std::vector<vec::fvec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+static mesh sphere(uint32_t rings, uint32_t segments)
+{
+    mesh result;
+    const float pi = 3.14159265f;
+
+    result.positions.push_back(vec::fvec3(0, 1, 0));
+    for (uint32_t r = 1; r < rings; r++)
+    {
+        const float polar = pi * r / rings;
+        for (uint32_t s = 0; s < segments; s++)
+        {
+            const float azimuth = 2 * pi * s / segments;
+            result.positions.push_back(
+                vec::fvec3(std::sin(polar) * std::cos(azimuth),
+                           std::cos(polar),
+                           std::sin(polar) * std::sin(azimuth)));
+        }
+    }
+    result.positions.push_back(vec::fvec3(0, -1, 0));
+
+    const uint32_t bottom = result.positions.size() - 1;
+    const auto ring = [&](uint32_t r, uint32_t s)
+    { return 1 + (r - 1) * segments + s % segments; };
+
+    for (uint32_t s = 0; s < segments; s++)
+    {
+        result.indices.insert(result.indices.end(),
+                              {0, ring(1, s + 1), ring(1, s)});
+        result.indices.insert(
+            result.indices.end(),
+            {bottom, ring(rings - 1, s), ring(rings - 1, s + 1)});
+        for (uint32_t r = 1; r + 1 < rings; r++)
+            result.indices.insert(result.indices.end(),
+                                  {ring(r, s),
+                                   ring(r, s + 1),
+                                   ring(r + 1, s),
+                                   ring(r, s + 1),
+                                   ring(r + 1, s + 1),
+                                   ring(r + 1, s)});
+    }
+    return result;
+}
+
+// side by side vertices on the plane z = 0, the column at seam repeated so
+// the halves either side of it use vertices of their own
+static mesh grid(uint32_t side, uint32_t seam)
+{
+    mesh result;
+    const uint32_t columns = seam ? side + 1 : side;
+
+    for (uint32_t y = 0; y < side; y++)
+        for (uint32_t c = 0; c < columns; c++)
+            result.positions.push_back(vec::fvec3(
+                seam && c > seam ? c - 1.0f : (float)c, (float)y, 0));
+
+    for (uint32_t y = 0; y + 1 < side; y++)
+    {
+        for (uint32_t x = 0; x + 1 < side; x++)
+        {
+            const uint32_t c = seam && x >= seam ? x + 1 : x;
+            const uint32_t corner = c + y * columns;
+            result.indices.insert(result.indices.end(),
+                                  {corner,
+                                   corner + 1,
+                                   corner + columns,
+                                   corner + 1,
+                                   corner + columns + 1,
+                                   corner + columns});
+        }
+    }
+    return result;
+}
+
+static float volume(const mesh &mesh, const std::vector<uint32_t> &indices)
+{
+    float sum = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        sum += vec::dot(mesh.positions[indices[i]],
+                        vec::cross(mesh.positions[indices[i + 1]],
+                                   mesh.positions[indices[i + 2]])) /
+               6;
+    return sum;
+}
+
+static float area(const mesh &mesh, const std::vector<uint32_t> &indices)
+{
+    float sum = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const vec::fvec3 &a = mesh.positions[indices[i]];
+        sum += vec::cross(mesh.positions[indices[i + 1]] - a,
+                          mesh.positions[indices[i + 2]] - a)
+                   .z /
+               2;
+    }
+    return sum;
+}
+
+static bool uses(const std::vector<uint32_t> &indices, uint32_t vertex)
+{
+    return std::find(indices.begin(), indices.end(), vertex) != indices.end();
+}
+
+static void check_sphere()
+{
+    const mesh ball = sphere(128, 256);
+    const float full = volume(ball, ball.indices);
+    const size_t target = ball.indices.size() / 4;
+
+    const auto start = std::chrono::steady_clock::now();
+    const engine::mesh::simplification quarter =
+        engine::mesh::simplify(ball.indices, ball.positions, target, 1);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    assert(quarter.indices.size() <= target);
+    assert(quarter.indices.size() > target * 0.9);
+    assert(quarter.error > 0 && quarter.error < 0.01);
+    assert(std::fabs(volume(ball, quarter.indices) - full) < full * 0.01);
+
+    // Halving again from the quarter, as a chain of levels does, keeps the
+    // shape too
+    const engine::mesh::simplification eighth = engine::mesh::simplify(
+        quarter.indices, ball.positions, target / 2, 1);
+    assert(eighth.indices.size() <= target / 2);
+    assert(eighth.error > 0 && eighth.error < 0.01);
+    assert(std::fabs(volume(ball, eighth.indices) - full) < full * 0.02);
+
+    // Nothing on a sphere collapses for free
+    const engine::mesh::simplification exact =
+        engine::mesh::simplify(ball.indices, ball.positions, 0, 0);
+    assert(exact.indices == ball.indices);
+
+    std::cout << "sphere: " << ball.indices.size() / 3 << " -> "
+              << quarter.indices.size() / 3 << " triangles, error "
+              << quarter.error << ", "
+              << ball.indices.size() / 3 / elapsed.count() / 1e6
+              << " M triangles/s\n";
+}
+
+static void check_grid()
+{
+    const uint32_t side = 64;
+    const mesh flat = grid(side, 0);
+    const engine::mesh::simplification simple =
+        engine::mesh::simplify(flat.indices, flat.positions, 0, 0.001f);
+
+    // A plane collapses to a handful of triangles with its border intact
+    assert(simple.indices.size() < flat.indices.size() / 20);
+    assert(simple.error < 0.001f);
+    assert(std::fabs(area(flat, simple.indices) - area(flat, flat.indices)) <
+           0.01f);
+    for (uint32_t corner :
+         {0u, side - 1, side * (side - 1), side * side - 1})
+        assert(uses(simple.indices, corner));
+
+    std::cout << "grid: " << flat.indices.size() / 3 << " -> "
+              << simple.indices.size() / 3 << " triangles\n";
+}
+
+static void check_seam()
+{
+    const uint32_t side = 32;
+    const uint32_t seam = 16;
+    const mesh split = grid(side, seam);
+    const engine::mesh::simplification simple =
+        engine::mesh::simplify(split.indices, split.positions, 0, 0.001f);
+
+    assert(simple.indices.size() < split.indices.size() / 4);
+    assert(std::fabs(area(split, simple.indices) -
+                     area(split, split.indices)) < 0.01f);
+    for (uint32_t y = 0; y < side; y++)
+    {
+        assert(uses(simple.indices, seam + y * (side + 1)));
+        assert(uses(simple.indices, seam + 1 + y * (side + 1)));
+    }
+}
+
+int main()
+{
+    check_sphere();
+    check_grid();
+    check_seam();
+
+    bool threw = false;
+    try
+    {
+        engine::mesh::simplify({0, 1, 2}, {vec::fvec3(0, 0, 0)}, 0, 1);
+    }
+    catch (const engine::mesh::exception::base &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Success\n";
+    return 0;
+}
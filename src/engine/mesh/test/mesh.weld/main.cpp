@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <engine/mesh.hpp>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+// Welds a grid drawn without indices, six vertices a square, whose halves
+// differ in one attribute along the column they share, and times it.
+
+static const uint32_t side = 256;
+static const uint32_t half = side / 2;
+static const size_t vertex_count = (side - 1) * (side - 1) * 6;
+
+struct vertex
+{
+    vec::fvec3 position;
+    uint32_t material;
+};
+
+static std::vector<vertex> grid()
+{
+    std::vector<vertex> vertices;
+    for (uint32_t y = 0; y + 1 < side; y++)
+    {
+        for (uint32_t x = 0; x + 1 < side; x++)
+        {
+            const uint32_t corners[6][2] = {
+                {x, y}, {x + 1, y}, {x, y + 1},
+                {x + 1, y}, {x + 1, y + 1}, {x, y + 1},
+            };
+            for (const uint32_t *corner : corners)
+                vertices.push_back(
+                    {vec::fvec3(corner[0], corner[1], 0), x >= half});
+        }
+    }
+    return vertices;
+}
+
+static bool same(const vertex &a, const vertex &b)
+{
+    return a.position.x == b.position.x && a.position.y == b.position.y &&
+           a.position.z == b.position.z && a.material == b.material;
+}
+
+int main()
+{
+    const std::vector<vertex> vertices = grid();
+    assert(vertices.size() == vertex_count);
+
+    // Each corner once for each half it is in
+    const size_t unique = side * (half + 1) + side * (side - half);
+
+    std::vector<uint32_t> indices(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++)
+        indices[i] = i;
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<uint32_t> kept = engine::mesh::weld(
+        indices,
+        {{(const uint8_t *)vertices.data(), sizeof(vertex), sizeof(vertex)}},
+        vertex_count);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    assert(kept.size() == unique);
+    assert(std::is_sorted(kept.begin(), kept.end()));
+    for (size_t i = 0; i < vertex_count; i++)
+        assert(same(vertices[kept[indices[i]]], vertices[i]));
+
+    // Attributes in arrays of their own weld the same way
+    std::vector<vec::fvec3> positions;
+    std::vector<uint32_t> materials;
+    for (const vertex &vertex : vertices)
+    {
+        positions.push_back(vertex.position);
+        materials.push_back(vertex.material);
+    }
+
+    std::vector<uint32_t> separate(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++)
+        separate[i] = i;
+    const std::vector<uint32_t> separate_kept = engine::mesh::weld(
+        separate,
+        {{(const uint8_t *)positions.data(),
+          sizeof(vec::fvec3),
+          sizeof(vec::fvec3)},
+         {(const uint8_t *)materials.data(),
+          sizeof(uint32_t),
+          sizeof(uint32_t)}},
+        vertex_count);
+    assert(separate_kept == kept);
+    assert(separate == indices);
+
+    // Gathering the kept vertices shrinks the data to them
+    std::vector<vertex> welded(kept.size());
+    engine::mesh::gather((uint8_t *)welded.data(),
+                         (const uint8_t *)vertices.data(),
+                         sizeof(vertex),
+                         kept);
+    for (size_t i = 0; i < vertex_count; i += 13)
+        assert(same(welded[indices[i]], vertices[i]));
+
+    std::cout << "Welded " << vertex_count << " vertices into " << unique
+              << ", " << vertex_count / elapsed.count() / 1e6
+              << " M vertices/s\n";
+
+    bool threw = false;
+    try
+    {
+        std::vector<uint32_t> outside = {0, 1, 2};
+        engine::mesh::weld(outside, {}, 2);
+    }
+    catch (const engine::mesh::exception::base &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Success\n";
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <engine/gltf.hpp>
+#include <engine/gpu.hpp>
+#include <engine/mesh.hpp>
+#include <iostream>
+#include <string.h>
+
+// Prints, for each primitive of some glTF files, how many vertices the gpu
+// keeps once repeated ones are welded and how well the post-transform cache
+// serves its triangles, before and after the passes run when loading it, and
+// the triangles and error of each level of detail.
+
+static std::vector<uint32_t> read_indices(const engine::gpu::vertices &vertices,
+                                          size_t lod)
+{
+    const engine::gpu::baked::lod &range = vertices.layout.lods[lod];
+    std::vector<uint32_t> indices(range.count);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (vertices.layout.short_indices)
+        {
+            uint16_t index;
+            memcpy(&index,
+                   vertices.indices.data() + (range.first + i) * sizeof(index),
+                   sizeof(index));
+            indices[i] = index;
+        }
+        else
+            memcpy(&indices[i],
+                   vertices.indices.data() +
+                       (range.first + i) * sizeof(uint32_t),
+                   sizeof(uint32_t));
+    }
+    return indices;
+}
+
+static void report(const std::string &name,
+                   const gltf::mesh_primitive &primitive,
+                   bool overdraw)
+{
+    if (!primitive.attributes.position ||
+        primitive.mode != gltf::mesh_primitive::mode::TRIANGLES)
+    {
+        std::cout << name << ": not triangles, skipped\n";
+        return;
+    }
+
+    const size_t vertex_count = primitive.attributes.position->count;
+    std::vector<uint32_t> indices;
+    if (primitive.indices)
+        indices = *primitive.indices;
+    else
+        for (size_t i = 0; i < vertex_count; i++)
+            indices.push_back(i);
+
+    const engine::mesh::statistics before =
+        engine::mesh::analyze(indices, vertex_count);
+
+    const engine::gpu::vertices vertices(
+        primitive, engine::gpu::attributes::arrangement::interleaved);
+    const size_t kept = vertices.data.size() / vertices.layout.stride;
+    indices = read_indices(vertices, 0);
+
+    if (overdraw)
+    {
+        std::vector<vec::fvec3> positions(kept);
+        for (size_t v = 0; v < kept; v++)
+        {
+            engine::gpu::attributes::position position;
+            memcpy((void *)&position,
+                   vertices.data.data() + v * vertices.layout.stride +
+                       vertices.layout.offsets[0],
+                   sizeof(position));
+            positions[v] = vertices.layout.quantization.dequantize(position);
+        }
+        engine::mesh::optimize_overdraw(indices, positions);
+    }
+
+    const engine::mesh::statistics after =
+        engine::mesh::analyze(indices, kept);
+
+    std::cout << name << ": " << before.triangles << " triangles, "
+              << vertex_count << " -> " << kept << " vertices, acmr "
+              << before.acmr() << " -> " << after.acmr() << ", atvr "
+              << before.atvr() << " -> " << after.atvr() << "\n";
+
+    for (size_t lod = 1; lod < engine::gpu::baked::lod_count; lod++)
+        std::cout << "  lod " << lod << ": "
+                  << vertices.layout.lods[lod].count / 3 << " triangles, error "
+                  << vertices.layout.lods[lod].error << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    bool overdraw = false;
+    int arg = 1;
+
+    if (argc > 1 && strcmp(argv[1], "-o") == 0)
+    {
+        overdraw = true;
+        arg++;
+    }
+
+    if (arg >= argc)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-o] <file.glb>...\n"
+                  << "  -o  also sort clusters of triangles to cut overdraw\n";
+        return 1;
+    }
+
+    try
+    {
+        for (; arg < argc; arg++)
+        {
+            const std::filesystem::path path(argv[arg]);
+            const std::string directory =
+                path.has_parent_path() ? path.parent_path().string() : ".";
+
+            engine::filesystem::whitelist wl(directory);
+            engine::filesystem::cache_binary fs_bin(wl);
+            engine::image::cache::rgba32 fs_img(wl);
+            const gltf::gltf gltf(path.filename().string(), fs_bin, fs_img);
+
+            for (const gltf::mesh &mesh : gltf.meshes)
+                for (size_t i = 0; i < mesh.primitives.size(); i++)
+                    report(path.filename().string() + " " + mesh.name + "[" +
+                               std::to_string(i) + "]",
+                           mesh.primitives[i],
+                           overdraw);
+        }
+    }
+    catch (const engine::exception &e)
+    {
+        std::cerr << e.message << "\n";
+        return 2;
+    }
+    catch (const std::filesystem::filesystem_error &e)
+    {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+
+    return 0;
+}
@@ -54,7 +54,15 @@ template <typename T> class animation_sampler_step
 
   public:
     animation_sampler_step(const gltf::animation_sampler &gltf_sampler);
+    animation_sampler_step(std::vector<T> &&_output)
+        : output(std::move(_output))
+    {
+    }
     T operator[](const interpolation_params &) const;
+    const std::vector<T> &get_output() const
+    {
+        return output;
+    }
 };
 
 template <typename T> class animation_sampler_linear
@@ -63,7 +71,15 @@ template <typename T> class animation_sampler_linear
 
   public:
     animation_sampler_linear(const gltf::animation_sampler &gltf_sampler);
+    animation_sampler_linear(std::vector<T> &&_output)
+        : output(std::move(_output))
+    {
+    }
     T operator[](const interpolation_params &) const;
+    const std::vector<T> &get_output() const
+    {
+        return output;
+    }
 };
 
 template <typename T> class animation_sampler_cubicspline
@@ -72,7 +88,15 @@ template <typename T> class animation_sampler_cubicspline
 
   public:
     animation_sampler_cubicspline(const gltf::animation_sampler &gltf_sampler);
+    animation_sampler_cubicspline(std::vector<vec::cubicspline<T>> &&_output)
+        : output(std::move(_output))
+    {
+    }
     T operator[](const interpolation_params &) const;
+    const std::vector<vec::cubicspline<T>> &get_output() const
+    {
+        return output;
+    }
 };
 
 using animation_sampler =
@@ -101,6 +125,7 @@ class animation_times
     std::vector<float> input;
     std::unordered_map<std::string, std::vector<animation_channel>> bones;
     animation_times(const gltf::accessor &input_accessor);
+    animation_times(std::vector<float> &&_input) : input(std::move(_input)) {}
 };
 
 class animation
@@ -114,6 +139,20 @@ class animation
   public:
     std::vector<animation_times> times;
     animation(const gltf::animation &gltf_animation, const gltf::gltf &gltf);
+    // Samplers already read from elsewhere, such as a baked asset. Times and
+    // channels are then added with add_channel.
+    animation(std::vector<animation_sampler> &&_samplers)
+        : samplers(std::move(_samplers))
+    {
+    }
+    void add_channel(size_t times_index,
+                     const std::string &bone,
+                     enum gltf::animation_channel_path path,
+                     size_t sampler_index);
+    const std::vector<animation_sampler> &get_samplers() const
+    {
+        return samplers;
+    }
 };
 
 class armature_bone
@@ -142,6 +181,10 @@ class armature
     std::vector<vec::fmat4> inverse_bind_matrices;
     std::vector<armature_bone> bones;
     armature(const gltf::skin &gltf_skin, const gltf::gltf &gltf);
+    armature(const std::string &_root_name,
+             std::vector<armature_bone> &&_bones,
+             std::vector<vec::transform3> &&_default_transforms,
+             std::vector<vec::fmat4> &&_inverse_bind_matrices);
 };
 
 // class frame
@@ -73,6 +73,23 @@ skel::armature::armature(const gltf::skin &gltf_skin, const gltf::gltf &gltf)
     root_name = find_skin_root_name(gltf_skin);
 }
 
+skel::armature::armature(const std::string &_root_name,
+                         std::vector<armature_bone> &&_bones,
+                         std::vector<vec::transform3> &&_default_transforms,
+                         std::vector<vec::fmat4> &&_inverse_bind_matrices)
+    : root_name(_root_name), default_transforms(std::move(_default_transforms)),
+      inverse_bind_matrices(std::move(_inverse_bind_matrices)),
+      bones(std::move(_bones))
+{
+    if (bones.size() != default_transforms.size() ||
+        bones.size() != inverse_bind_matrices.size())
+        throw skel::exception(
+            "Bone count does not match transform or matrix count");
+
+    for (size_t bone_index = 0; bone_index < bones.size(); bone_index++)
+        bones_names[bones[bone_index].name] = bone_index;
+}
+
 skel::animation_times::animation_times(const gltf::accessor &input_accessor)
     : input(input_accessor)
 {
@@ -97,10 +114,24 @@ void skel::animation::add_channel(size_t input_index,
         skel::animation_channel(input_channel.target.path, sampler));
 }
 
+void skel::animation::add_channel(size_t times_index,
+                                  const std::string &bone,
+                                  enum gltf::animation_channel_path path,
+                                  size_t sampler_index)
+{
+    std::vector<skel::animation_channel> &bone_channels =
+        times.at(times_index).bones[bone];
+
+    bone_channels.emplace_back(
+        skel::animation_channel(path, samplers.at(sampler_index)));
+}
+
 skel::animation::animation(const gltf::animation &gltf_animation,
                            const gltf::gltf &gltf)
 {
-    std::unordered_map<const gltf::accessor *, size_t> accessor_to_input_index;
+    engine::memory::arena arena(1024);
+    std::pmr::unordered_map<const gltf::accessor *, size_t>
+        accessor_to_input_index(&arena);
 
     for (const gltf::animation_sampler &gltf_sampler : gltf_animation.samplers)
     {
@@ -32,11 +32,20 @@ class forward
     std::unique_ptr<internal> internal;
 
   public:
-    forward(const std::string &root);
+    // Unless frozen, files under root are watched and reloaded when changed
+    forward(const std::string &root, bool frozen = false);
     ~forward();
     void operator+=(const object &other);
+    // Reload shaders and assets that changed on disk since they were loaded
+    void refresh();
     void draw(const vec::transform3 &camera_transform,
               const vec::perspective &camera_perspective);
+    // Heap allocations the task lists made for the last frame drawn, which
+    // drops to zero once they have grown to fit the scene
+    size_t frame_allocations() const;
+    // Skin matrices the last frame drawn posed but did not upload, because
+    // no node it drew used them
+    size_t frame_pose_matrices() const;
 };
 
 } // namespace pipeline
@@ -4,8 +4,13 @@
 #include <engine/filesystem.hpp>
 #include <engine/gpu.hpp>
 #include <engine/skel.hpp>
+#include <engine/memory.hpp>
 #include <engine/vec.hpp>
 #include <engine/view3.hpp>
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <string_view>
 #include <unordered_map>
 
 struct engine::view3::pipeline::forward::internal
@@ -16,6 +21,14 @@ struct engine::view3::pipeline::forward::internal
     image::cache::rgba32 fs_image;
     gltf::gltf_cache fs_gltf;
     engine::gpu::cache::asset fs_asset;
+    std::unique_ptr<engine::filesystem::watcher> watcher;
+    // Task lists grow from heap and keep their capacity between frames, while
+    // anything only needed until the frame is drawn comes from frame
+    engine::memory::counter heap;
+    engine::memory::arena frame;
+    size_t frame_allocations = 0;
+    size_t frame_pose_matrices = 0;
+    size_t heap_mark = 0;
     struct shader;
     std::unordered_map<std::string, shader> shaders;
 
@@ -32,6 +45,18 @@ struct engine::view3::pipeline::forward::internal
         bool is_on_gpu = false;
 
       public:
+        // Holds are reused from frame to frame, and a pose nothing drew
+        // still has the last frame's matrices
+        void clear()
+        {
+            mat.clear();
+            skel.reset();
+            is_on_gpu = false;
+        }
+        size_t matrices() const
+        {
+            return mat.size();
+        }
         void start(const skel::armature &arm)
         {
             is_on_gpu = false;
@@ -87,18 +112,21 @@ struct engine::view3::pipeline::forward::internal
             }
         };
 
+        using armature_slices =
+            std::pmr::unordered_map<std::string_view, skel::pose::slice>;
+
+        // Recycled from frame to frame by the pool in tasks, so the pose
+        // buffers are only allocated the first time they are needed
         struct hold
         {
             gpu::cache::asset::reference ref;
             vec::transform3 transform;
             internal::pose pose; // need to cache gpu textures from this
 
-            void
-            add_node(const std::string &node_name,
-                     const std::unordered_map<std::string, skel::pose::slice>
-                         &armatures,
-                     std::vector<static_node> &static_nodes,
-                     std::vector<pose_node> &pose_nodes)
+            void add_node(const std::string &node_name,
+                          const armature_slices &armatures,
+                          std::pmr::vector<static_node> &static_nodes,
+                          std::pmr::vector<pose_node> &pose_nodes)
             {
                 const gpu::asset &asset = *ref;
                 const auto node_it = asset.objects.find(node_name);
@@ -122,18 +150,20 @@ struct engine::view3::pipeline::forward::internal
                     static_nodes.emplace_back(asset_node.mesh, transform);
             }
 
-            hold(const struct object &obj,
-                 gpu::cache::asset &cache,
-                 std::vector<static_node> &static_nodes,
-                 std::vector<pose_node> &pose_nodes)
-                : transform(obj.transform)
+            void start(const struct object &obj,
+                       gpu::cache::asset &cache,
+                       std::pmr::memory_resource *frame,
+                       std::pmr::vector<static_node> &static_nodes,
+                       std::pmr::vector<pose_node> &pose_nodes)
             {
+                transform = obj.transform;
                 ref = cache[obj.asset];
 
-                std::unordered_map<std::string, skel::pose::slice> armatures;
+                armature_slices armatures(frame);
 
                 const gpu::asset &asset = *ref;
 
+                pose.clear();
                 for (const auto &[name, arm] : asset.armatures)
                 {
                     pose.start(arm);
@@ -163,18 +193,37 @@ struct engine::view3::pipeline::forward::internal
             }
         };
 
-        std::vector<hold> holds;
-        std::vector<static_node> static_nodes;
-        std::vector<pose_node> pose_nodes;
+        engine::memory::pool<hold> holds;
+        std::pmr::vector<static_node> static_nodes;
+        std::pmr::vector<pose_node> pose_nodes;
 
-        void add_node(const struct object &obj, gpu::cache::asset &cache)
+        tasks(std::pmr::memory_resource *heap)
+            : holds(heap), static_nodes(heap), pose_nodes(heap)
         {
-            holds.emplace_back(obj, cache, static_nodes, pose_nodes);
         }
 
+        void add_node(const struct object &obj,
+                      gpu::cache::asset &cache,
+                      std::pmr::memory_resource *frame)
+        {
+            holds.next().start(obj, cache, frame, static_nodes, pose_nodes);
+        }
+
+        // Matrices posed for this frame that no draw has uploaded
+        size_t pose_matrices()
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < holds.size(); i++)
+                count += holds[i].pose.matrices();
+            return count;
+        }
+
+        // Keeps every buffer for the next frame, only the assets are let go
         void clear()
         {
-            holds.clear();
+            for (size_t i = 0; i < holds.size(); i++)
+                holds[i].ref = nullptr;
+            holds.reset();
             static_nodes.clear();
             pose_nodes.clear();
         }
@@ -191,18 +240,22 @@ struct engine::view3::pipeline::forward::internal
 
         shader(const gpu::shader::vertex &static_vert,
                const gpu::shader::vertex &pose_vert,
-               const gpu::shader::fragment &frag)
-            : pose_depth_prepass(&pose_vert, nullptr),
+               const gpu::shader::fragment &frag,
+               std::pmr::memory_resource *heap)
+            : tasks(heap), pose_depth_prepass(&pose_vert, nullptr),
               pose_draw(&pose_vert, &frag),
               static_depth_prepass(&static_vert, nullptr),
               static_draw(&static_vert, &frag)
         {
         }
 
-        shader(const std::string &name, engine::filesystem::cache_binary &fs)
+        shader(const std::string &name,
+               engine::filesystem::cache_binary &fs,
+               std::pmr::memory_resource *heap)
             : shader(gpu::shader::vertex(fs, name + ".static.vert"),
                      gpu::shader::vertex(fs, name + ".pose.vert"),
-                     gpu::shader::fragment(fs, name + ".frag"))
+                     gpu::shader::fragment(fs, name + ".frag"),
+                     heap)
         {
         }
     };
@@ -214,25 +267,54 @@ struct engine::view3::pipeline::forward::internal
         if (shader_it == shaders.end())
         {
             const auto added_it =
-                shaders.emplace(obj.shader, shader(obj.shader, fs_bin));
-            added_it.first->second.tasks.add_node(obj, fs_asset);
+                shaders.try_emplace(obj.shader, obj.shader, fs_bin, &heap);
+            added_it.first->second.tasks.add_node(obj, fs_asset, &frame);
         }
         else
         {
-            shader_it->second.tasks.add_node(obj, fs_asset);
+            shader_it->second.tasks.add_node(obj, fs_asset, &frame);
         }
     }
 
     void load_shaders(const std::vector<std::string> &paths)
     {
         for (const std::string &path : paths)
-            shaders.emplace(path, shader(path, fs_bin));
+            shaders.try_emplace(path, path, fs_bin, &heap);
+    }
+
+    // Levels of detail stray from the full mesh by about a pixel at most, as
+    // if the screen were this many pixels high
+    static constexpr float lod_lines = 1080;
+
+    static size_t lod(const vec::transform3 &camera_transform,
+                      const vec::perspective &camera_perspective,
+                      const vec::transform3 &transform,
+                      const gpu::asset::mesh &mesh)
+    {
+        const float scale = std::max({std::fabs(transform.scale.x),
+                                      std::fabs(transform.scale.y),
+                                      std::fabs(transform.scale.z)});
+        if (scale <= 0)
+            return 0;
+
+        // From the nearest point of the sphere the mesh fits in
+        const float distance = std::max(
+            vec::length(transform.translation -
+                        camera_transform.translation) -
+                mesh.radius * scale,
+            camera_perspective.near);
+
+        // Height of a pixel there, in the units of the mesh
+        const float pixel = 2 * distance *
+                            std::tan(camera_perspective.fovy / 2) /
+                            lod_lines / scale;
+        return mesh.lod(pixel);
     }
 
     void draw_static(const vec::transform3 &camera_transform,
                      const vec::perspective &camera_perspective,
                      gpu::shader::program &program,
-                     const std::vector<tasks::static_node> &nodes)
+                     const std::pmr::vector<tasks::static_node> &nodes)
     {
         if (nodes.empty())
             return;
@@ -250,14 +332,18 @@ struct engine::view3::pipeline::forward::internal
                 program.set_model_transform(node.transform);
             }
 
-            node.mesh.draw(program);
+            node.mesh.draw(program,
+                           lod(camera_transform,
+                               camera_perspective,
+                               node.transform,
+                               node.mesh));
         }
     }
 
     void draw_pose(const vec::transform3 &camera_transform,
                    const vec::perspective &camera_perspective,
                    gpu::shader::program &program,
-                   const std::vector<tasks::pose_node> &nodes)
+                   const std::pmr::vector<tasks::pose_node> &nodes)
     {
         if (nodes.empty())
             return;
@@ -283,7 +369,11 @@ struct engine::view3::pipeline::forward::internal
             }
             program.set_skin_slice(node.slice);
 
-            node.mesh.draw(program);
+            node.mesh.draw(program,
+                           lod(camera_transform,
+                               camera_perspective,
+                               node.transform,
+                               node.mesh));
         }
     }
 
@@ -307,6 +397,7 @@ struct engine::view3::pipeline::forward::internal
 
         gpu::state::forward::start_draw_pass();
 
+        frame_pose_matrices = 0;
         for (auto &[name, shader] : shaders)
         {
             draw_static(camera_transform,
@@ -319,19 +410,40 @@ struct engine::view3::pipeline::forward::internal
                       shader.pose_draw,
                       shader.tasks.pose_nodes);
 
+            frame_pose_matrices += shader.tasks.pose_matrices();
             shader.tasks.clear();
         }
+
+        frame.reset();
+        frame_allocations = heap.allocations() - heap_mark;
+        heap_mark = heap.allocations();
     }
 
-    internal(const std::string &root)
+    // The forward shaders fetch every attribute of each vertex
+    internal(const std::string &root, bool frozen)
         : whitelist(root), fs_bin(whitelist), fs_image(whitelist),
-          fs_gltf(whitelist, fs_bin, fs_image), fs_asset(whitelist, fs_gltf)
+          fs_gltf(whitelist, fs_bin, fs_image),
+          fs_asset(whitelist,
+                   fs_gltf,
+                   "",
+                   engine::gpu::attributes::arrangement::interleaved),
+          frame(engine::memory::arena::default_chunk_size, &heap)
     {
+        if (frozen)
+            return;
+
+        // Dependencies first, so reloads see the reloaded files they load
+        watcher = std::make_unique<engine::filesystem::watcher>(whitelist);
+        fs_bin.watch(*watcher);
+        fs_image.watch(*watcher);
+        fs_gltf.watch(*watcher);
+        fs_asset.watch(*watcher);
     }
 };
 
-engine::view3::pipeline::forward::forward(const std::string &root)
-    : internal(std::make_unique<struct internal>(root))
+engine::view3::pipeline::forward::forward(const std::string &root,
+                                          bool frozen)
+    : internal(std::make_unique<struct internal>(root, frozen))
 {
 }
 
@@ -342,6 +454,24 @@ void engine::view3::pipeline::forward::operator+=(const object &other)
     internal->add_object(other);
 }
 
+void engine::view3::pipeline::forward::refresh()
+{
+    internal->fs_bin.refresh();
+    internal->fs_image.refresh();
+    internal->fs_gltf.refresh();
+    internal->fs_asset.refresh();
+}
+
+size_t engine::view3::pipeline::forward::frame_allocations() const
+{
+    return internal->frame_allocations;
+}
+
+size_t engine::view3::pipeline::forward::frame_pose_matrices() const
+{
+    return internal->frame_pose_matrices;
+}
+
 void engine::view3::pipeline::forward::draw(
     const vec::transform3 &camera_transform,
     const vec::perspective &camera_perspective)
@@ -0,0 +1,52 @@
+#include <assert.h>
+#include <engine/platform.hpp>
+#include <engine/view3.hpp>
+
+#define DEG2RAD (3.14159 / 180.0)
+
+// Poses an animated asset without drawing any of its nodes for several
+// frames, checking that the matrices left over do not pile up and that the
+// task lists stop allocating once the first frames have sized them
+int main(int argc, char *argv[])
+{
+    assert(argc == 4);
+    std::string root = argv[1];
+    std::string glb = argv[2];
+    std::string shader = argv[3];
+
+    platform::window window("view3 pose test");
+
+    engine::view3::pipeline::forward pipeline(root, true);
+
+    size_t first = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        platform::frame::state frame = window.get_frame();
+        if (frame.should_close)
+            break;
+        vec::perspective perspective(DEG2RAD * 120, frame.window.aspect_ratio);
+        vec::transform3 camera_transform(
+            vec::fvec3(0, 0, 5),
+            vec::fvec4(vec::fvec3(0, 0, 0), vec::up));
+
+        engine::view3::object obj = {
+            vec::transform3(),
+            shader,
+            glb,
+            {{1, (float)frame.time.now, "ArmatureAction"}},
+            std::vector<std::string>(),
+        };
+
+        pipeline += obj;
+
+        pipeline.draw(camera_transform, perspective);
+
+        if (i == 0)
+            first = pipeline.frame_pose_matrices();
+        assert(first > 0);
+        assert(pipeline.frame_pose_matrices() == first);
+        if (i >= 2)
+            assert(pipeline.frame_allocations() == 0);
+    }
+}